@@ -119,6 +119,377 @@ add_param_to_json_retobj(json_object *retobj, char const *key, json_object *addo
     }
 }
 
+/* Assign values to known args from argv and, if requested, their defaults.
+   Called only on processor 0. */
+static int
+assign_args(
+   MACSIO_KnownArgInfo_t *knownArgs,
+   MACSIO_CLARGS_ArgvFlags_t flags,
+   MACSIO_LOG_MsgSeverity_t msgSeverity,
+   int argi,
+   int argc,
+   char **argv,
+   json_object **retobj
+)
+{
+   int i;
+   int haveSeenSeparatorArg = 0;
+   json_object *ret_json_obj = 0;
+
+   /* And now, finally, we can process the arguments and assign them */
+   if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+       ret_json_obj = json_object_new_object();
+   i = argi;
+   while (i < argc && !haveSeenSeparatorArg)
+   {
+      int foundArg;
+      MACSIO_KnownArgInfo_t *p;
+      char argName[64] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+
+      /* search known arguments for this command line argument */
+      p = knownArgs;
+      foundArg = 0;
+      while (p && !foundArg)
+      {
+         if (!strncmp(argv[i], p->fmtStr, (unsigned int)(p->argNameLength) ))
+         {
+            strncpy(argName, argv[i], (unsigned int)(p->argNameLength));
+	    foundArg = 1;
+         }
+	 else
+	    p = p->next;
+      }
+      if (foundArg)
+      {
+	 int j;
+
+	 /* assign command-line arguments to caller supplied parameters */
+	 if (p->paramCount)
+	 {
+	    for (j = 0; j < p->paramCount; j++)
+	    {
+               if (i == argc - 1)
+               {
+                   MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity, ("too few arguments for command-line options"));
+                   break;
+               }
+	       switch (p->paramTypes[j])
+	       {
+	          case 'd':
+	          {
+                     int n = strlen(argv[++i])-1;
+                     int tmpInt;
+                     double tmpDbl, ndbl;
+                     ndbl = GetSizeFromModifierChar(argv[i][n]);
+		     tmpInt = strtol(argv[i], (char **)NULL, 10);
+                     tmpDbl = tmpInt * ndbl;
+                     if ((int)tmpDbl != tmpDbl)
+                     {
+                         MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity,
+                             ("integer overflow (%.0f) for arg \"%s\"",tmpDbl,argv[i-1]));
+                     }
+                     else
+                     {
+                         if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                         {
+		             int *pInt = (int *) (p->paramPtrs[j]);
+                             *pInt = (int) tmpDbl;
+                         }
+                         else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                             add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_int((int)tmpDbl));
+                         p->paramFlags[j] |= PARAM_ASSIGNED;
+                     }
+		     break;
+	          }
+	          case 's':
+	          {
+                     i++;
+                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                     {
+		         char **pChar = (char **) (p->paramPtrs[j]);
+                         if (*pChar == NULL)
+		             *pChar = (char*) malloc(strlen(argv[i])+1);
+		         strcpy(*pChar, argv[i]);
+                     }
+                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                         add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_string(argv[i]));
+                     p->paramFlags[j] |= PARAM_ASSIGNED;
+		     break;
+	          }
+	          case 'f':
+	          {
+                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                     {
+		         double *pDouble = (double *) (p->paramPtrs[j]);
+		         *pDouble = atof(argv[++i]);
+                     }
+                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                         add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_double(atof(argv[++i])));
+                     p->paramFlags[j] |= PARAM_ASSIGNED;
+		     break;
+	          }
+	          case 'n': /* special case to return arg index */
+	          {
+                     haveSeenSeparatorArg = 1;
+                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                     {
+		         int *pInt = (int *) (p->paramPtrs[j]);
+		         *pInt = i++;
+                     }
+                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                         add_param_to_json_retobj(ret_json_obj, "argi", json_object_new_int(i++));
+                     p->paramFlags[j] |= PARAM_ASSIGNED;
+		     break;
+	          }
+               }
+   	    }
+	 }
+	 else
+	 {
+            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+            {
+                int *pInt = (int *) (p->paramPtrs[0]);
+                *pInt = 1; 
+                p->paramFlags[0] |= PARAM_ASSIGNED;
+            }
+            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+            {
+                add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_boolean((json_bool)1));
+                p->paramFlags[0] |= PARAM_ASSIGNED;
+            }
+	 }
+      }
+      else
+      {
+	 char *p = strrchr(argv[0], '/');
+	 p = p ? p+1 : argv[0];
+         errno = EINVAL; /* if dieing, ensure executable returns useful error code */
+#ifdef HAVE_MPI
+         mpi_errno = MPI_SUCCESS;
+#endif
+         MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity,
+             ("%s: unknown argument %s. Type %s --help for help",p,argv[i],p));
+         if (ret_json_obj)
+            json_object_put(ret_json_obj);
+         return MACSIO_CLARGS_ERROR; 
+      }
+
+      /* move to next argument */
+      i++;
+   }
+
+   /* find any args for which defaults are specified but a value
+      wasn't assigned from arc/argv and assign the default value(s). */
+   if (flags.defaults_mode == MACSIO_CLARGS_ASSIGN_ON)
+   {
+       MACSIO_KnownArgInfo_t *pka = knownArgs;
+       while (pka)
+       {
+          if (pka->defStr)
+          {
+              if (pka->paramCount)
+              {
+                  int j;
+                  char *defStr, *defStrOrig;
+                  defStr = defStrOrig = strdup(pka->defStr);
+                  for (j = 0; j < pka->paramCount; j++)
+                  {
+                      char *defParam = strsep(&defStr, " ");
+
+                      if (pka->paramFlags[j] & PARAM_ASSIGNED) continue;
+
+                      MACSIO_LOG_MSGL(MACSIO_LOG_StdErr, Dbg2,
+                          ("Default value of \"%s\" assigned for param %d of arg \"%s\"",defParam,j,pka->argName));
+
+	              switch (pka->paramTypes[j])
+	              {
+	                 case 'd':
+	                 {
+                            int n = strlen(defParam)-1;
+                            int tmpInt;
+                            double tmpDbl, ndbl;
+                            ndbl = GetSizeFromModifierChar(defParam[n]);
+		            tmpInt = strtol(defParam, (char **)NULL, 10);
+                            tmpDbl = tmpInt * ndbl;
+                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                            {
+		                int *pInt = (int *) (pka->paramPtrs[j]);
+                                *pInt = (int) tmpDbl;
+                            }
+                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_int((int)tmpDbl));
+                            pka->paramFlags[j] |= PARAM_ASSIGNED;
+		            break;
+	                 }
+	                 case 's':
+	                 {
+                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                            {
+		                char **pChar = (char **) (pka->paramPtrs[j]);
+                                if (*pChar == NULL)
+		                    *pChar = (char*) malloc(strlen(defParam)+1);
+		                strcpy(*pChar, defParam);
+                            }
+                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                            {
+                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_string(defParam));
+                            }
+                            pka->paramFlags[j] |= PARAM_ASSIGNED;
+		            break;
+                         }
+	                 case 'f':
+	                 {
+                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                            {
+		                double *pDouble = (double *) (pka->paramPtrs[j]);
+		                *pDouble = atof(defParam);
+                            }
+                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_double(atof(defParam)));
+                            pka->paramFlags[j] |= PARAM_ASSIGNED;
+		            break;
+	                 }
+                      }
+                  }
+                  free(defStrOrig);
+              }
+              else /* boolean arg case */
+              {
+                  if (!(pka->paramFlags[0] & PARAM_ASSIGNED))
+                  {
+                      if (flags.route_mode == MACSIO_CLARGS_TOMEM)
+                      {
+                          int *pInt = (int *) (pka->paramPtrs[0]);
+                          *pInt = 0; 
+                      }
+                      else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+                          add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_boolean((json_bool)0));
+                      pka->paramFlags[0] |= PARAM_ASSIGNED;
+                  }
+              }
+          }
+          pka = pka->next;
+       }
+   }
+
+
+   *retobj = ret_json_obj;
+   return MACSIO_CLARGS_OK;
+}
+
+#ifdef HAVE_MPI
+/* Append n bytes to a growing buffer */
+static void
+pack_bytes(char **buf, int *len, int *cap, void const *p, int n)
+{
+   if (*len + n > *cap)
+   {
+      *cap = 2 * (*len + n);
+      *buf = (char *) realloc(*buf, *cap);
+   }
+   memcpy(*buf + *len, p, n);
+   *len += n;
+}
+
+/* Processor 0 broadcasts the values it assigned and the others assign them too.
+   JSON routed values are sent as a JSON string. Memory routed values are packed,
+   each preceded by whether it was assigned, in the order of the known args. */
+static void
+share_args(
+   MACSIO_KnownArgInfo_t *knownArgs,
+   MACSIO_CLARGS_ArgvFlags_t flags,
+   int rank,
+   json_object **retobj
+)
+{
+   MACSIO_KnownArgInfo_t *pka;
+   char *buf = 0, *p;
+   int len = 0, cap = 0;
+
+   if (rank == 0)
+   {
+      if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+      {
+         char const *str = *retobj ? json_object_to_json_string(*retobj) : 0;
+         if (!str) str = "";
+         pack_bytes(&buf, &len, &cap, str, strlen(str)+1);
+      }
+      else
+      {
+         for (pka = knownArgs; pka; pka = pka->next)
+         {
+            int j, n = pka->paramCount ? pka->paramCount : 1;
+            for (j = 0; j < n; j++)
+            {
+               char assigned = pka->paramFlags[j] & PARAM_ASSIGNED;
+               char type = pka->paramCount ? pka->paramTypes[j] : 'd'; /* bools are ints */
+
+               pack_bytes(&buf, &len, &cap, &assigned, 1);
+               if (!assigned) continue;
+               if (type == 'f')
+                  pack_bytes(&buf, &len, &cap, pka->paramPtrs[j], sizeof(double));
+               else if (type == 's')
+                  pack_bytes(&buf, &len, &cap, *(char **) pka->paramPtrs[j], strlen(*(char **) pka->paramPtrs[j])+1);
+               else
+                  pack_bytes(&buf, &len, &cap, pka->paramPtrs[j], sizeof(int));
+            }
+         }
+      }
+   }
+
+   MPI_Bcast(&len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (rank != 0)
+      buf = (char *) malloc(len);
+   MPI_Bcast(buf, len, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+   if (rank != 0)
+   {
+      if (flags.route_mode == MACSIO_CLARGS_TOJSON)
+      {
+         *retobj = json_tokener_parse(buf);
+      }
+      else
+      {
+         p = buf;
+         for (pka = knownArgs; pka; pka = pka->next)
+         {
+            int j, n = pka->paramCount ? pka->paramCount : 1;
+            for (j = 0; j < n; j++)
+            {
+               char type = pka->paramCount ? pka->paramTypes[j] : 'd';
+
+               if (!*p++) continue;
+               pka->paramFlags[j] |= PARAM_ASSIGNED;
+               if (type == 'f')
+               {
+                  memcpy(pka->paramPtrs[j], p, sizeof(double));
+                  p += sizeof(double);
+               }
+               else if (type == 's')
+               {
+                  char **pChar = (char **) (pka->paramPtrs[j]);
+                  if (*pChar == NULL)
+                     *pChar = (char*) malloc(strlen(p)+1);
+                  strcpy(*pChar, p);
+                  p += strlen(p)+1;
+               }
+               else
+               {
+                  memcpy(pka->paramPtrs[j], p, sizeof(int));
+                  p += sizeof(int);
+               }
+            }
+         }
+      }
+   }
+
+   free(buf);
+}
+#endif
+
 int
 MACSIO_CLARGS_ProcessCmdline(
    void **retobj,
@@ -130,14 +501,12 @@ MACSIO_CLARGS_ProcessCmdline(
 )
 {
    FILE *outFILE;
-   char *argvStr = NULL;
-   int i, rank = 0;
+   int i, rank = 0, status = MACSIO_CLARGS_OK;
    int helpWasRequested = 0;
    int strictIsDisabled = 0;
    int invalidArgTypeFound = 0;
    int firstArg;
    int terminalWidth = 120 - 10;
-   int haveSeenSeparatorArg = 0;
    MACSIO_KnownArgInfo_t *knownArgs, *newArg, *oldArg;
    va_list ap;
    json_object *ret_json_obj = 0;
@@ -349,7 +718,7 @@ MACSIO_CLARGS_ProcessCmdline(
 	 argNameLength = n;
 	 paramTypes = NULL;
 	 paramPtrs = (void **) malloc(sizeof(void*));
-         paramFlags = (char*) malloc(sizeof(char));
+         paramFlags = (char*) calloc(1, sizeof(char));
          if (flags.route_mode == MACSIO_CLARGS_TOMEM)
 	     paramPtrs[0] = va_arg(ap, int *);
       }
@@ -408,301 +777,20 @@ MACSIO_CLARGS_ProcessCmdline(
       return MACSIO_CLARGS_HELP;
    }
 
-   /* ok, now broadcast the whole argc, argv data */ 
-#ifdef HAVE_MPI
+   /* Processor 0 alone processes the arguments and shares the results so
+      the cost does not grow with the number of processors */
+   if (rank == 0)
    {
-      int argvLen;
-      char *p;
-
-      /* processor zero computes size of linearized argv and builds it */
-      if (rank == 0)
-      {
 //#warning MAKE THIS A CLARG
-	 if (getenv("MACSIO_CLARGS_IGNORE_UNKNOWN_ARGS"))
-	    flags.error_mode = MACSIO_CLARGS_WARN;
-
-         /* compute size of argv */
-         argvLen = 0;
-         for (i = 0; i < argc; i++)
-	    argvLen += (strlen(argv[i])) + 1;
-
-         /* allocate an array of chars to broadcast */
-         argvStr = (char *) malloc((unsigned int)argvLen);
-
-         /* now, fill argvStr */
-         p = argvStr;
-         for (i = 0; i < argc; i++)
-         {
-	    strcpy(p, argv[i]);
-	    p += (strlen(argv[i]) + 1);
-	    *(p-1) = '\0';
-         }
-      }
-
-      /* now broadcast the linearized argv */
-      MPI_Bcast(&flags, 1, MPI_INT, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&argc, 1, MPI_INT, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&argvLen, 1, MPI_INT, 0, MPI_COMM_WORLD);
-      if (rank != 0)
-         argvStr = (char *) malloc((unsigned int)argvLen);
-      MPI_Bcast(argvStr, argvLen, MPI_CHAR, 0, MPI_COMM_WORLD);
-
-      /* Issue: We're relying upon embedded nulls in argvStr */
-      /* now, put it back into the argv form */
-      if (rank != 0)
-      {
-	 argv = (char **) malloc(argc * sizeof(char*));
-	 p = argvStr;
-	 for (i = 0; i < argc; i++)
-	 {
-	    argv[i] = p;
-	    p += (strlen(p) + 1);
-	 }
-      }
+      if (getenv("MACSIO_CLARGS_IGNORE_UNKNOWN_ARGS"))
+         flags.error_mode = MACSIO_CLARGS_WARN;
+      status = assign_args(knownArgs, flags, msgSeverity, argi, argc, argv, &ret_json_obj);
    }
-#endif
-
-   /* And now, finally, we can process the arguments and assign them */
-   if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-       ret_json_obj = json_object_new_object();
-   i = argi;
-   while (i < argc && !haveSeenSeparatorArg)
-   {
-      int foundArg;
-      MACSIO_KnownArgInfo_t *p;
-      char argName[64] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-
-      /* search known arguments for this command line argument */
-      p = knownArgs;
-      foundArg = 0;
-      while (p && !foundArg)
-      {
-         if (!strncmp(argv[i], p->fmtStr, (unsigned int)(p->argNameLength) ))
-         {
-            strncpy(argName, argv[i], (unsigned int)(p->argNameLength));
-	    foundArg = 1;
-         }
-	 else
-	    p = p->next;
-      }
-      if (foundArg)
-      {
-	 int j;
-
-	 /* assign command-line arguments to caller supplied parameters */
-	 if (p->paramCount)
-	 {
-	    for (j = 0; j < p->paramCount; j++)
-	    {
-               if (i == argc - 1)
-               {
-                   MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity, ("too few arguments for command-line options"));
-                   break;
-               }
-	       switch (p->paramTypes[j])
-	       {
-	          case 'd':
-	          {
-                     int n = strlen(argv[++i])-1;
-                     int tmpInt;
-                     double tmpDbl, ndbl;
-                     ndbl = GetSizeFromModifierChar(argv[i][n]);
-		     tmpInt = strtol(argv[i], (char **)NULL, 10);
-                     tmpDbl = tmpInt * ndbl;
-                     if ((int)tmpDbl != tmpDbl)
-                     {
-                         MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity,
-                             ("integer overflow (%.0f) for arg \"%s\"",tmpDbl,argv[i-1]));
-                     }
-                     else
-                     {
-                         if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                         {
-		             int *pInt = (int *) (p->paramPtrs[j]);
-                             *pInt = (int) tmpDbl;
-                         }
-                         else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                             add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_int((int)tmpDbl));
-                         p->paramFlags[j] |= PARAM_ASSIGNED;
-                     }
-		     break;
-	          }
-	          case 's':
-	          {
-                     i++;
-                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                     {
-		         char **pChar = (char **) (p->paramPtrs[j]);
-                         if (*pChar == NULL)
-		             *pChar = (char*) malloc(strlen(argv[i])+1);
-		         strcpy(*pChar, argv[i]);
-                     }
-                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                         add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_string(argv[i]));
-                     p->paramFlags[j] |= PARAM_ASSIGNED;
-		     break;
-	          }
-	          case 'f':
-	          {
-                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                     {
-		         double *pDouble = (double *) (p->paramPtrs[j]);
-		         *pDouble = atof(argv[++i]);
-                     }
-                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                         add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_double(atof(argv[++i])));
-                     p->paramFlags[j] |= PARAM_ASSIGNED;
-		     break;
-	          }
-	          case 'n': /* special case to return arg index */
-	          {
-                     haveSeenSeparatorArg = 1;
-                     if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                     {
-		         int *pInt = (int *) (p->paramPtrs[j]);
-		         *pInt = i++;
-                     }
-                     else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                         add_param_to_json_retobj(ret_json_obj, "argi", json_object_new_int(i++));
-                     p->paramFlags[j] |= PARAM_ASSIGNED;
-		     break;
-	          }
-               }
-   	    }
-	 }
-	 else
-	 {
-            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-            {
-                int *pInt = (int *) (p->paramPtrs[0]);
-                *pInt = 1; 
-                p->paramFlags[0] |= PARAM_ASSIGNED;
-            }
-            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-            {
-                add_param_to_json_retobj(ret_json_obj, &argName[2], json_object_new_boolean((json_bool)1));
-                p->paramFlags[0] |= PARAM_ASSIGNED;
-            }
-	 }
-      }
-      else
-      {
-	 char *p = strrchr(argv[0], '/');
-	 p = p ? p+1 : argv[0];
-         errno = EINVAL; /* if dieing, ensure executable returns useful error code */
 #ifdef HAVE_MPI
-         mpi_errno = MPI_SUCCESS;
+   MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (status == MACSIO_CLARGS_OK)
+      share_args(knownArgs, flags, rank, &ret_json_obj);
 #endif
-	 if (rank == 0)
-             MACSIO_LOG_MSGLV(MACSIO_LOG_StdErr, msgSeverity,
-                 ("%s: unknown argument %s. Type %s --help for help",p,argv[i],p));
-         return MACSIO_CLARGS_ERROR; 
-      }
-
-      /* move to next argument */
-      i++;
-   }
-
-   /* free argvStr */
-   if (argvStr)
-      free(argvStr);
-
-   /* free the argv pointers we created, locally */
-   if (rank != 0 && argv)
-      free(argv);
-
-   /* find any args for which defaults are specified but a value
-      wasn't assigned from arc/argv and assign the default value(s). */
-   if (flags.defaults_mode == MACSIO_CLARGS_ASSIGN_ON)
-   {
-       MACSIO_KnownArgInfo_t *pka = knownArgs;
-       while (pka)
-       {
-          if (pka->defStr)
-          {
-              if (pka->paramCount)
-              {
-                  int j;
-                  char *defStr, *defStrOrig;
-                  defStr = defStrOrig = strdup(pka->defStr);
-                  for (j = 0; j < pka->paramCount; j++)
-                  {
-                      char *defParam = strsep(&defStr, " ");
-
-                      if (pka->paramFlags[j] & PARAM_ASSIGNED) continue;
-
-                      MACSIO_LOG_MSGL(MACSIO_LOG_StdErr, Dbg2,
-                          ("Default value of \"%s\" assigned for param %d of arg \"%s\"",defParam,j,pka->argName));
-
-	              switch (pka->paramTypes[j])
-	              {
-	                 case 'd':
-	                 {
-                            int n = strlen(defParam)-1;
-                            int tmpInt;
-                            double tmpDbl, ndbl;
-                            ndbl = GetSizeFromModifierChar(defParam[n]);
-		            tmpInt = strtol(defParam, (char **)NULL, 10);
-                            tmpDbl = tmpInt * ndbl;
-                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                            {
-		                int *pInt = (int *) (pka->paramPtrs[j]);
-                                *pInt = (int) tmpDbl;
-                            }
-                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_int((int)tmpDbl));
-		            break;
-	                 }
-	                 case 's':
-	                 {
-                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                            {
-		                char **pChar = (char **) (pka->paramPtrs[j]);
-                                if (*pChar == NULL)
-		                    *pChar = (char*) malloc(strlen(defParam)+1);
-		                strcpy(*pChar, defParam);
-                            }
-                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                            {
-                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_string(defParam));
-                            }
-		            break;
-                         }
-	                 case 'f':
-	                 {
-                            if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                            {
-		                double *pDouble = (double *) (pka->paramPtrs[j]);
-		                *pDouble = atof(defParam);
-                            }
-                            else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                                add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_double(atof(defParam)));
-		            break;
-	                 }
-                      }
-                  }
-                  free(defStrOrig);
-              }
-              else /* boolean arg case */
-              {
-                  if (!(pka->paramFlags[0] & PARAM_ASSIGNED))
-                  {
-                      if (flags.route_mode == MACSIO_CLARGS_TOMEM)
-                      {
-                          int *pInt = (int *) (pka->paramPtrs[0]);
-                          *pInt = 0; 
-                      }
-                      else if (flags.route_mode == MACSIO_CLARGS_TOJSON)
-                          add_param_to_json_retobj(ret_json_obj, pka->argName, json_object_new_boolean((json_bool)0));
-                  }
-              }
-          }
-          pka = pka->next;
-       }
-   }
 
    /* free the known args stuff */
    while (knownArgs)
@@ -720,6 +808,9 @@ MACSIO_CLARGS_ProcessCmdline(
       knownArgs = next;
    }
 
+   if (status != MACSIO_CLARGS_OK)
+      return status;
+
    if (flags.route_mode == MACSIO_CLARGS_TOJSON)
        *retobj = ret_json_obj;
 
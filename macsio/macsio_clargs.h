@@ -108,7 +108,8 @@ option error response which ordinarily causes an abort and instead issues
 warnings.
 
 In parallel, this function must be called collectively by all ranks in
-\c MPI_COMM_WORLD. \c argc and \c argv on task rank 0 are broadcast to all tasks.
+\c MPI_COMM_WORLD. Only task rank 0 processes its \c argc and \c argv. The resulting
+values, or JSON object, are broadcast to and assigned on all other tasks.
 If request for help (e.g. \c \--help is in \c argv) or error(s) are encountered,
 all tasks are broadcast this outcome. Only task rank 0 will print usage or 
 error messages.
@@ -0,0 +1,307 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include <macsio_crc.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MACSIO_CRC_X86
+#include <immintrin.h>
+#endif
+
+#define POLY_CRC32  0xEDB88320u /* zlib, reflected */
+#define POLY_CRC32C 0x82F63B78u /* Castagnoli, reflected */
+
+/* Slicing-by-16 after Stephan Brumme's Crc32.cpp (slicing-by-16 contributed
+   by Bulat Ziganshin). Table s maps a byte to the CRC of that byte followed by
+   s zero bytes so 16 bytes are folded into the CRC with 16 lookups. Tables
+   are generated on first use rather than stored. */
+typedef uint32_t crc_tables_t[16][256];
+
+static crc_tables_t crc32_tab, crc32c_tab;
+
+static void
+make_slice_tables(uint32_t poly, crc_tables_t tab)
+{
+    int i, s, b;
+
+    for (i = 0; i < 256; i++)
+    {
+        uint32_t crc = (uint32_t) i;
+        for (b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (poly & (0u - (crc & 1)));
+        tab[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++)
+        for (s = 1; s < 16; s++)
+            tab[s][i] = (tab[s-1][i] >> 8) ^ tab[0][tab[s-1][i] & 0xFF];
+}
+
+static uint32_t
+crc_slice16(crc_tables_t tab, uint32_t crc, unsigned char const *p, size_t len)
+{
+    crc = ~crc;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 16)
+    {
+        uint32_t w[4];
+        memcpy(w, p, 16);
+        w[0] ^= crc;
+        crc = tab[ 0][ w[3] >> 24        ] ^ tab[ 1][(w[3] >> 16) & 0xFF] ^
+              tab[ 2][(w[3] >>  8) & 0xFF] ^ tab[ 3][ w[3]        & 0xFF] ^
+              tab[ 4][ w[2] >> 24        ] ^ tab[ 5][(w[2] >> 16) & 0xFF] ^
+              tab[ 6][(w[2] >>  8) & 0xFF] ^ tab[ 7][ w[2]        & 0xFF] ^
+              tab[ 8][ w[1] >> 24        ] ^ tab[ 9][(w[1] >> 16) & 0xFF] ^
+              tab[10][(w[1] >>  8) & 0xFF] ^ tab[11][ w[1]        & 0xFF] ^
+              tab[12][ w[0] >> 24        ] ^ tab[13][(w[0] >> 16) & 0xFF] ^
+              tab[14][(w[0] >>  8) & 0xFF] ^ tab[15][ w[0]        & 0xFF];
+        p += 16;
+        len -= 16;
+    }
+#endif
+
+    while (len--)
+        crc = (crc >> 8) ^ tab[0][(crc ^ *p++) & 0xFF];
+
+    return ~crc;
+}
+
+#ifdef MACSIO_CRC_X86
+
+/* Hardware CRC-32C after Mark Adler's crc32c.c. The crc32 instruction has a
+   latency of 3 cycles but a throughput of 1 so three adjacent blocks are
+   checksummed at once and then combined. Combining shifts a block's CRC over
+   the length of the blocks following it (appends zeros) with a table driven
+   linear operator. */
+
+#define LONG_BLOCK 8192
+#define SHORT_BLOCK 256
+
+static uint32_t crc32c_long[4][256], crc32c_short[4][256];
+
+static uint32_t
+gf2_matrix_times(uint32_t const *mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+
+    while (vec)
+    {
+        if (vec & 1)
+            sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+static void
+gf2_matrix_square(uint32_t *square, uint32_t const *mat)
+{
+    int n;
+
+    for (n = 0; n < 32; n++)
+        square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/* Operator appending len (a power of 2) zero bytes to a CRC-32C */
+static void
+crc32c_zeros_op(uint32_t *even, size_t len)
+{
+    uint32_t odd[32], row = 1;
+    int n;
+
+    /* one zero bit */
+    odd[0] = POLY_CRC32C;
+    for (n = 1; n < 32; n++, row <<= 1)
+        odd[n] = row;
+
+    gf2_matrix_square(even, odd); /* two zero bits */
+    gf2_matrix_square(odd, even); /* four zero bits */
+
+    /* first square gives one zero byte, next two and so on */
+    do
+    {
+        gf2_matrix_square(even, odd);
+        len >>= 1;
+        if (len == 0)
+            return;
+        gf2_matrix_square(odd, even);
+        len >>= 1;
+    } while (len);
+
+    memcpy(even, odd, sizeof(odd));
+}
+
+static void
+crc32c_zeros(uint32_t zeros[4][256], size_t len)
+{
+    uint32_t op[32];
+    uint32_t n;
+
+    crc32c_zeros_op(op, len);
+    for (n = 0; n < 256; n++)
+    {
+        zeros[0][n] = gf2_matrix_times(op, n);
+        zeros[1][n] = gf2_matrix_times(op, n << 8);
+        zeros[2][n] = gf2_matrix_times(op, n << 16);
+        zeros[3][n] = gf2_matrix_times(op, n << 24);
+    }
+}
+
+static inline uint32_t
+crc32c_shift(uint32_t const zeros[4][256], uint32_t crc)
+{
+    return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+           zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+static inline uint64_t
+load64(unsigned char const *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, unsigned char const *p, size_t len)
+{
+    uint64_t crc0 = ~crc;
+
+    while (len && ((uintptr_t) p & 7))
+    {
+        crc0 = _mm_crc32_u8((uint32_t) crc0, *p++);
+        len--;
+    }
+
+    while (len >= 3 * LONG_BLOCK)
+    {
+        uint64_t crc1 = 0, crc2 = 0;
+        unsigned char const *end = p + LONG_BLOCK;
+        do
+        {
+            crc0 = _mm_crc32_u64(crc0, load64(p));
+            crc1 = _mm_crc32_u64(crc1, load64(p + LONG_BLOCK));
+            crc2 = _mm_crc32_u64(crc2, load64(p + 2 * LONG_BLOCK));
+            p += 8;
+        } while (p < end);
+        crc0 = crc32c_shift(crc32c_long, (uint32_t) crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_long, (uint32_t) crc0) ^ crc2;
+        p += 2 * LONG_BLOCK;
+        len -= 3 * LONG_BLOCK;
+    }
+
+    while (len >= 3 * SHORT_BLOCK)
+    {
+        uint64_t crc1 = 0, crc2 = 0;
+        unsigned char const *end = p + SHORT_BLOCK;
+        do
+        {
+            crc0 = _mm_crc32_u64(crc0, load64(p));
+            crc1 = _mm_crc32_u64(crc1, load64(p + SHORT_BLOCK));
+            crc2 = _mm_crc32_u64(crc2, load64(p + 2 * SHORT_BLOCK));
+            p += 8;
+        } while (p < end);
+        crc0 = crc32c_shift(crc32c_short, (uint32_t) crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_short, (uint32_t) crc0) ^ crc2;
+        p += 2 * SHORT_BLOCK;
+        len -= 3 * SHORT_BLOCK;
+    }
+
+    while (len >= 8)
+    {
+        crc0 = _mm_crc32_u64(crc0, load64(p));
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--)
+        crc0 = _mm_crc32_u8((uint32_t) crc0, *p++);
+
+    return ~(uint32_t) crc0;
+}
+
+#endif /* MACSIO_CRC_X86 */
+
+static int crc_initialized = 0;
+static int crc_use_hw = 0;
+
+static int
+hw_supported(void)
+{
+#ifdef MACSIO_CRC_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return 0;
+#endif
+}
+
+/* Not thread safe; the first checksum must precede any threaded use */
+static void
+crc_init(void)
+{
+    if (crc_initialized)
+        return;
+    make_slice_tables(POLY_CRC32, crc32_tab);
+    make_slice_tables(POLY_CRC32C, crc32c_tab);
+#ifdef MACSIO_CRC_X86
+    crc32c_zeros(crc32c_long, LONG_BLOCK);
+    crc32c_zeros(crc32c_short, SHORT_BLOCK);
+#endif
+    crc_use_hw = hw_supported();
+    crc_initialized = 1;
+}
+
+unsigned
+MACSIO_CRC_Crc32(void const *buf, size_t len, unsigned crc)
+{
+    crc_init();
+    return crc_slice16(crc32_tab, crc, (unsigned char const *) buf, len);
+}
+
+unsigned
+MACSIO_CRC_Crc32c(void const *buf, size_t len, unsigned crc)
+{
+    crc_init();
+#ifdef MACSIO_CRC_X86
+    if (crc_use_hw)
+        return crc32c_hw(crc, (unsigned char const *) buf, len);
+#endif
+    return crc_slice16(crc32c_tab, crc, (unsigned char const *) buf, len);
+}
+
+int
+MACSIO_CRC_UseHW(int on)
+{
+    crc_init();
+    crc_use_hw = on && hw_supported();
+    return crc_use_hw;
+}
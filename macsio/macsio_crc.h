@@ -0,0 +1,92 @@
+#ifndef _MACSIO_CRC_H
+#define _MACSIO_CRC_H
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include <stddef.h>
+
+/*!
+\defgroup MACSIO_CRC MACSIO_CRC
+\brief Fast checksums for validating data
+
+CRC-32 (the zlib/gzip polynomial) and CRC-32C (the Castagnoli polynomial) are
+computed 16 bytes at a time with slicing-by-16 tables. On x86 CPUs with SSE4.2,
+CRC-32C is computed instead with the crc32 instruction on three interleaved
+streams, which is fast enough to keep up with memory bandwidth. Both methods
+give identical results so checksums computed on one machine can be verified
+on any other.
+
+Checksums may be computed in pieces by passing the checksum of the preceding
+pieces as \c crc (0 for the first piece).
+
+@{
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+\brief CRC-32 (zlib polynomial) of a buffer
+*/
+extern unsigned
+MACSIO_CRC_Crc32(
+    void const *buf, /**< data to checksum */
+    size_t len,      /**< number of bytes in \c buf */
+    unsigned crc     /**< checksum of preceding data or 0 */
+);
+
+/*!
+\brief CRC-32C (Castagnoli polynomial) of a buffer
+
+This is the checksum MACSio stores with generated data.
+*/
+extern unsigned
+MACSIO_CRC_Crc32c(
+    void const *buf, /**< data to checksum */
+    size_t len,      /**< number of bytes in \c buf */
+    unsigned crc     /**< checksum of preceding data or 0 */
+);
+
+/*!
+\brief Select hardware or table driven CRC-32C
+
+The first CRC-32C computed selects hardware if the running CPU supports it.
+Mainly for testing.
+\return Non-zero if hardware is selected (not possible if unsupported)
+*/
+extern int
+MACSIO_CRC_UseHW(
+    int on /**< non-zero to use hardware if supported */
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*!@}*/
+
+#endif /* _MACSIO_CRC_H */
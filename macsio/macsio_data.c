@@ -26,11 +26,19 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <json-cwx/json.h>
 
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#include <macsio_crc.h>
 #include <macsio_data.h>
+#include <macsio_log.h>
+#include <macsio_noise.h>
 #include <macsio_utils.h>
 
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,114 +48,145 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 #define MACSIO_DATA_MAX_PRNGS 20
 
 /*!
-\brief Support functions for Perlin noise
+\brief Philox4x32-10 counter-based random number generator
+
+Salmon, Moraes, Dror and Shaw, "Parallel Random Numbers: As Easy as 1, 2, 3",
+SC11. Maps a 128-bit counter and 64-bit key to 128 random bits. There is no
+state other than the counter and key and so any value in any stream can be
+computed independently of any other (random access, threading, vectorizing).
 @{
 */
-static double fade(double t) { return t * t * t * (t * (t * 6 - 15) + 10); }
-static double lerp(double t, double a, double b) { return a + t * (b - a); }
-static double grad(int hash, double x, double y, double z) {
-    int h = hash & 15;
-    double u = h<8 ? x : y;
-    double v = h<4 ? y : h==12||h==14 ? x : z;
-    return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+static void
+philox4x32_10(uint32_t const ctr[4], uint32_t const key[2], uint32_t out[4])
+{
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    int r;
+
+    for (r = 0; r < 10; r++)
+    {
+        uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t) p1;
+        c3 = (uint32_t) p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
 }
 /*@}*/
 
-/*!
-\brief Ken Perlin's Improved Noise
+/* Seed used for keyed (seed, rank, part, var) streams; set with default PRNGs */
+static unsigned cbprng_seed = 0xDeadBeef;
 
-Copyright 2002, Ken Perlin.
+MACSIO_DATA_CBPRNGKey_t
+MACSIO_DATA_CBPRNGKey(unsigned rank, unsigned part, unsigned var)
+{
+    MACSIO_DATA_CBPRNGKey_t key;
+    key.seed = cbprng_seed;
+    key.rank = rank;
+    key.part = part;
+    key.var = var;
+    return key;
+}
 
-Modified by Mark Miller for C and for arbitrary sized spatial domains
-*/
-static double noise(
-    double _x, /**< x spatial coordinate */
-    double _y, /**< y spatial coordinate */
-    double _z, /**< z spatial coordinate */
-    double const *bounds /**< total spatial bounds to be mapped to unit cube */
-)
+unsigned
+MACSIO_DATA_CBPRNGGetVal(MACSIO_DATA_CBPRNGKey_t const *key, unsigned long long idx)
+{
+    uint32_t ctr[4], k[2], out[4];
+
+    ctr[0] = (uint32_t) (idx >> 2);
+    ctr[1] = (uint32_t) (idx >> 34);
+    ctr[2] = key->part;
+    ctr[3] = key->var;
+    k[0] = key->seed;
+    k[1] = key->rank;
+    philox4x32_10(ctr, k, out);
+
+    return out[idx & 0x3];
+}
+
+void
+MACSIO_DATA_CBPRNGFill(MACSIO_DATA_CBPRNGKey_t const *key, unsigned long long idx0,
+    long long n, unsigned *vals)
 {
-    static int p[512], permutation[256] = {151,160,137,91,90,15,
-        131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
-        190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
-        88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
-        77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
-        102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
-        135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
-        5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
-        223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
-        129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
-        251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
-        49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
-        138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180};
-    static int p_initialized = 0;
-
-    int X, Y, Z, A, AA, AB, B, BA, BB;
-    double u, v, w;
-    double x = 0, y = 0, z = 0;
-
-    if (!p_initialized)
+    uint32_t k[2] = {key->seed, key->rank};
+    unsigned long long idx = idx0;
+    long long i = 0;
+
+    /* leading values up to a block boundary */
+    for (; i < n && (idx & 0x3); i++, idx++)
+        vals[i] = MACSIO_DATA_CBPRNGGetVal(key, idx);
+
+    /* whole blocks; each is independent of all others */
+    for (; i + 4 <= n; i += 4, idx += 4)
     {
-        int i;
-        for (i=0; i < 256 ; i++)
-            p[256+i] = p[i] = permutation[i];
-        p_initialized = 1;
+        uint32_t ctr[4], out[4];
+        ctr[0] = (uint32_t) (idx >> 2);
+        ctr[1] = (uint32_t) (idx >> 34);
+        ctr[2] = key->part;
+        ctr[3] = key->var;
+        philox4x32_10(ctr, k, out);
+        vals[i+0] = out[0];
+        vals[i+1] = out[1];
+        vals[i+2] = out[2];
+        vals[i+3] = out[3];
     }
 
-    /* Map point in bounds to point in unit cube */
-    x = _x / (bounds[3] - bounds[0]);
-    if (bounds[4] != bounds[1])
-        y = _y / (bounds[4] - bounds[1]);
-    if (bounds[5] != bounds[2])
-        z = _z / (bounds[5] - bounds[2]);
-
-    /* Unit cube that contains the point */
-    X = (int)floor(x) & 255;
-    Y = (int)floor(y) & 255;
-    Z = (int)floor(z) & 255;
-
-    /* Find relative X, Y, Z of point in cube */
-    x -= floor(x);
-    y -= floor(y);
-    z -= floor(z);
-
-    /* Compute fade curves */
-    u = fade(x);
-    v = fade(y);
-    w = fade(z);
-
-    /* Hash coords of 8 cube corners */
-    A = p[X  ]+Y; AA = p[A]+Z; AB = p[A+1]+Z;
-    B = p[X+1]+Y; BA = p[B]+Z; BB = p[B+1]+Z;
-
-    return lerp(w, lerp(v, lerp(u, grad(p[AA  ], x  , y  , z  ),
-                                   grad(p[BA  ], x-1, y  , z  )),
-                           lerp(u, grad(p[AB  ], x  , y-1, z  ),
-                                   grad(p[BB  ], x-1, y-1, z  ))),
-                   lerp(v, lerp(u, grad(p[AA+1], x  , y  , z-1),
-                                   grad(p[BA+1], x-1, y  , z-1)),
-                           lerp(u, grad(p[AB+1], x  , y-1, z-1),
-                                   grad(p[BB+1], x-1, y-1, z-1))));
-}
-
-/* Pseudo Random Number Generator (PRNG) support */
-static     char *prng_state_vecs[MACSIO_DATA_MAX_PRNGS] = {0,0,0,0,0,0,0,0,0,0};
-static unsigned prng_state_seeds[MACSIO_DATA_MAX_PRNGS] = {0,0,0,0,0,0,0,0,0,0};
+    /* trailing values */
+    for (; i < n; i++, idx++)
+        vals[i] = MACSIO_DATA_CBPRNGGetVal(key, idx);
+}
+
+void
+MACSIO_DATA_CBPRNGFillDouble(MACSIO_DATA_CBPRNGKey_t const *key, unsigned long long idx0,
+    long long n, double *vals)
+{
+    long long i;
+    unsigned u[256];
+
+    /* generate in small blocks; converting in place in the caller's buffer
+       would access the same memory as both unsigned and double */
+    for (i = 0; i < n; i += 256)
+    {
+        int q, nq = n - i < 256 ? (int) (n - i) : 256;
+        MACSIO_DATA_CBPRNGFill(key, idx0 + i, nq, u);
+        for (q = 0; q < nq; q++)
+            vals[i+q] = u[q] * (1.0 / 4294967296.0);
+    }
+}
+
+/* Pseudo Random Number Generator (PRNG) support. Each PRNG is a counter-based
+   stream keyed by its seed so there is no global (libc) state to switch. */
+typedef struct _prng_stream_t
+{
+    int used;
+    unsigned seed;
+    unsigned long long count;
+} prng_stream_t;
+static prng_stream_t prng_streams[MACSIO_DATA_MAX_PRNGS];
 
 int MACSIO_DATA_CreatePRNG(unsigned seed)
 {
-    static size_t const veclen = 32;
     int i;
 
-    /* find an unused state vector */
-    for (i = 0; i < MACSIO_DATA_MAX_PRNGS && prng_state_vecs[i] != 0; i++);
+    /* find an unused stream */
+    for (i = 0; i < MACSIO_DATA_MAX_PRNGS && prng_streams[i].used; i++);
     assert(i < MACSIO_DATA_MAX_PRNGS);
 
-    /* create and populate a new state vector */
-    prng_state_vecs[i] = (char *) malloc(veclen);
-    assert(prng_state_vecs[i]);
-    prng_state_seeds[i] = seed;
-    initstate(prng_state_seeds[i], prng_state_vecs[i], veclen);
+    prng_streams[i].used = 1;
+    prng_streams[i].seed = seed;
+    prng_streams[i].count = 0;
 
     return i;
 }
@@ -156,35 +195,33 @@ void MACSIO_DATA_ResetPRNG(int id)
 {
     assert(id >= 0);
     assert(id < MACSIO_DATA_MAX_PRNGS);
-    assert(prng_state_vecs[id]);
-    setstate(prng_state_vecs[id]);
-    srandom(prng_state_seeds[id]);
+    assert(prng_streams[id].used);
+    prng_streams[id].count = 0;
 }
 
 long MACSIO_DATA_GetValPRNG(int id)
 {
-    static int lastid = -1;
+    MACSIO_DATA_CBPRNGKey_t key;
 
     assert(id >= 0);
     assert(id < MACSIO_DATA_MAX_PRNGS);
-    assert(prng_state_vecs[id]);
+    assert(prng_streams[id].used);
 
-    if (id != lastid)
-    {
-        setstate(prng_state_vecs[id]);
-        lastid = id;
-    }
+    key.seed = prng_streams[id].seed;
+    key.rank = 0;
+    key.part = 0;
+    key.var = 0;
 
-    return random();
+    /* same range as random() */
+    return (long) (MACSIO_DATA_CBPRNGGetVal(&key, prng_streams[id].count++) >> 1);
 }
 
 void MACSIO_DATA_DestroyPRNG(int id)
 {
     assert(id >= 0);
     assert(id < MACSIO_DATA_MAX_PRNGS);
-    assert(prng_state_vecs[id]);
-    free(prng_state_vecs[id]);
-    prng_state_vecs[id] = 0;
+    assert(prng_streams[id].used);
+    prng_streams[id].used = 0;
 }
 
 void MACSIO_DATA_InitializeDefaultPRNGs(unsigned rank, unsigned utime)
@@ -194,6 +231,8 @@ void MACSIO_DATA_InitializeDefaultPRNGs(unsigned rank, unsigned utime)
     unsigned tseed = nseed ^ utime;  /* time-variant seed */
     unsigned rtseed = rseed ^ tseed; /* rank- and time-variant seed */
 
+    cbprng_seed = nseed;
+
     /* Note: order here must match int args to convenience macros in header */
     MACSIO_DATA_CreatePRNG(nseed);  /* 0, naive */
     MACSIO_DATA_CreatePRNG(tseed);  /* 1, naive_tv */
@@ -444,6 +483,27 @@ MACSIO_DATA_MakeRandomTable(int nrecs, int totbytes)
     return retval;
 }
 
+json_object *
+MACSIO_DATA_MakeTrickleObject(int nbytes, int trickleNum, double trickleTime)
+{
+    int i, nvals = nbytes / (int) sizeof(double);
+    double *vals;
+    json_object *retval = json_object_new_object();
+
+    if (nvals < 1) nvals = 1;
+
+    /* A time-history record of nvals "probe" values */
+    vals = (double *) malloc(nvals * sizeof(double));
+    for (i = 0; i < nvals; i++)
+        vals[i] = sin(trickleTime + (double) i / nvals) + (double) (MD_random() % 1000) / 1.0e6;
+
+    json_object_object_add(retval, "TrickleNum", json_object_new_int(trickleNum));
+    json_object_object_add(retval, "Time", json_object_new_double(trickleTime));
+    json_object_object_add(retval, "History", json_object_new_extarr(vals, json_extarr_type_flt64, 1, &nvals, 0));
+
+    return retval;
+}
+
 //#warning NEED TO REPLACE STRINGS WITH KEYS FOR MESH PARAMETERS
 static json_object *
 make_uniform_mesh_coords(int ndims, int const *dims, double const *bounds)
@@ -464,8 +524,6 @@ make_uniform_mesh_coords(int ndims, int const *dims, double const *bounds)
     return coords;
 }
 
-//#warning PACKAGE EXTARR METHOD WITH CHECKSUM STUFF
-
 static json_object *
 make_rect_mesh_coords(int ndims, int const *dims, double const *bounds)
 {
@@ -908,104 +966,406 @@ make_arb_mesh_topology(int ndims, int const *dims)
 
 //#warning WE SHOULD ENABLE ABILITY TO CHANGE TOPOLOGY WITH TIME
 
+/*!
+\brief Per-variable state shared by the variable generation kernels
+
+Everything that does not vary per element (deltas, number of noise levels)
+is computed once, up front, so the kernels are simple contiguous loops.
+*/
+typedef struct _vargen_t
+{
+    double const *bounds;           /**< spatial bounds of the mesh part */
+    int vdims[3];                   /**< logical dims of the values */
+    double dx, dy, dz;              /**< node spacing in each dimension */
+    double nscale[3];               /**< maps part bounds to unit noise space */
+    int nlevels;                    /**< number of octaves for noise_sum */
+    MACSIO_DATA_CBPRNGKey_t const *key; /**< PRNG key for random */
+} vargen_t;
+
+/*!
+\brief Variable generation kernel
+
+Fills \c n values of row \c j of k-plane \c k starting at i-index \c i0. A value
+depends only on its logical index and not on how rows are split into segments.
+Kernels may be run concurrently on disjoint segments.
+*/
+typedef void (*vargen_kernel_t)(vargen_t const *g, int j, int k, long long i0, long long n, void *vals);
+
+static void
+vargen_none(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    memset(vals, 0, (size_t) n * sizeof(double));
+}
+
+static void
+vargen_constant(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double *v = (double *) vals;
+    long long i;
+
+    for (i = 0; i < n; i++)
+        v[i] = 1.0;
+}
+
+static void
+vargen_random(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double *v = (double *) vals;
+    unsigned long long idx0 = ((unsigned long long) k * g->vdims[1] + j) * g->vdims[0] + i0;
+    long long i;
+    unsigned u[256];
+
+    /* Stream index is sequential index of the value in the whole variable */
+    for (i = 0; i < n; i += 256)
+    {
+        int q, nq = n - i < 256 ? (int) (n - i) : 256;
+        MACSIO_DATA_CBPRNGFill(g->key, idx0 + i, nq, u);
+        for (q = 0; q < nq; q++)
+            v[i+q] = (double) (u[q] % 1000) / 1000;
+    }
+}
+
+static void
+vargen_xramp(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double *v = (double *) vals;
+    double const x0 = g->bounds[0], dx = g->dx;
+    long long i;
+
+    for (i = 0; i < n; i++)
+        v[i] = x0 + (i0 + i) * dx;
+}
+
+static void
+vargen_spherical(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double *v = (double *) vals;
+    double const x0 = g->bounds[0], dx = g->dx;
+    double const y = g->bounds[1] + j * g->dy;
+    double const z = g->bounds[2] + k * g->dz;
+    double const y2 = y*y, z2 = z*z;
+    long long i;
+
+    for (i = 0; i < n; i++)
+    {
+        double const x = x0 + (i0 + i) * dx;
+        v[i] = sqrt(x*x + y2 + z2);
+    }
+}
+
+static void
+vargen_noise(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double const y = (g->bounds[1] + j * g->dy) * g->nscale[1];
+    double const z = (g->bounds[2] + k * g->dz) * g->nscale[2];
+
+    MACSIO_NOISE_Simplex3Row(g->bounds[0] * g->nscale[0], g->dx * g->nscale[0], i0,
+        y, z, n, (double *) vals);
+}
+
+static void
+vargen_noise_sum(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double const y = (g->bounds[1] + j * g->dy) * g->nscale[1];
+    double const z = (g->bounds[2] + k * g->dz) * g->nscale[2];
+
+    MACSIO_NOISE_Simplex3FbmRow(g->bounds[0] * g->nscale[0], g->dx * g->nscale[0], i0,
+        y, z, g->nlevels, n, (double *) vals);
+}
+
+static void
+vargen_ysin(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    double *v = (double *) vals;
+    double const sy = sin((g->bounds[1] + j * g->dy)*3.1415266);
+    long long i;
+
+    for (i = 0; i < n; i++)
+        v[i] = sy;
+}
+
+static void
+vargen_xlayers(vargen_t const *g, int j, int k, long long i0, long long n, void *vals)
+{
+    int *v = (int *) vals;
+    long long i;
+
+    for (i = 0; i < n; i++)
+        v[i] = (int) (((i0 + i) / 20) % 3);
+}
+
+/*!
+\brief Select variable generation kernel from a variable's kind (name)
+
+Longer kind names sharing a prefix with shorter ones must come first.
+*/
+static vargen_kernel_t
+vargen_kernel_from_kind(char const *kind, int *is_int)
+{
+    static struct { char const *kind; vargen_kernel_t kernel; } const kernels[] = {
+        {"constant",  vargen_constant},
+        {"random",    vargen_random},
+        {"xramp",     vargen_xramp},
+        {"spherical", vargen_spherical},
+        {"noise_sum", vargen_noise_sum},
+        {"noise",     vargen_noise},
+        {"ysin",      vargen_ysin},
+        {"xlayers",   vargen_xlayers}
+    };
+    int i;
+
+    *is_int = 0;
+    for (i = 0; i < (int) (sizeof(kernels)/sizeof(kernels[0])); i++)
+    {
+        if (strstr(kind, kernels[i].kind))
+        {
+            *is_int = kernels[i].kernel == vargen_xlayers;
+            return kernels[i].kernel;
+        }
+    }
+    return vargen_none;
+}
+
+/*!
+\brief Set up generator state for a variable and select its kernel
+*/
+static vargen_kernel_t
+vargen_init(vargen_t *g, char const *kind, int ndims, int const *dims, double const *bounds,
+    int const *vdims, MACSIO_DATA_CBPRNGKey_t const *key, int *is_int)
+{
+    double dims_diameter2 = 1;
+    int i;
+
+    g->bounds = bounds;
+    g->vdims[0] = g->vdims[1] = g->vdims[2] = 1;
+    for (i = 0; i < ndims; i++)
+    {
+        g->vdims[i] = vdims[i];
+        dims_diameter2 += dims[i]*dims[i];
+    }
+    g->dx = MACSIO_UTILS_XDelta(dims, bounds);
+    g->dy = ndims > 1 ? MACSIO_UTILS_YDelta(dims, bounds) : 0;
+    g->dz = ndims > 2 ? MACSIO_UTILS_ZDelta(dims, bounds) : 0;
+//#warning SHOULD USE GLOBAL DIMS DIAMETER HERE
+    g->nlevels = (int) log2(sqrt(dims_diameter2))+1;
+    g->key = key;
+
+    /* Map part bounds to a unit cube in noise space (flat dims to 0) */
+    for (i = 0; i < 3; i++)
+        g->nscale[i] = bounds[i+3] != bounds[i] ? 1 / (bounds[i+3] - bounds[i]) : 0;
+
+    /* noise variant must be selected before any threads use it */
+    MACSIO_NOISE_GetISA();
+
+    return vargen_kernel_from_kind(kind, is_int);
+}
+
+void
+MACSIO_DATA_FillScalarVar(char const *kind, int ndims, int const *dims, double const *bounds,
+    int const *vdims, MACSIO_DATA_CBPRNGKey_t const *key, void *vals)
+{
+    vargen_t g;
+    vargen_kernel_t kernel;
+    long long row_size;
+    int k, is_int;
+
+    kernel = vargen_init(&g, kind, ndims, dims, bounds, vdims, key, &is_int);
+    row_size = (long long) g.vdims[0] * (is_int ? sizeof(int) : sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (k = 0; k < g.vdims[2]; k++)
+    {
+        int j;
+        for (j = 0; j < g.vdims[1]; j++)
+            kernel(&g, j, k, 0, g.vdims[0],
+                (char *) vals + ((long long) k * g.vdims[1] + j) * row_size);
+    }
+}
+
+void
+MACSIO_DATA_FillScalarVarRange(char const *kind, int ndims, int const *dims, double const *bounds,
+    int const *vdims, MACSIO_DATA_CBPRNGKey_t const *key, long long offset, long long nvals,
+    void *vals)
+{
+    vargen_t g;
+    vargen_kernel_t kernel;
+    size_t vsize;
+    long long n, nx;
+    int is_int;
+
+    kernel = vargen_init(&g, kind, ndims, dims, bounds, vdims, key, &is_int);
+    vsize = is_int ? sizeof(int) : sizeof(double);
+    nx = g.vdims[0];
+
+    /* a row segment at a time */
+    for (n = 0; n < nvals;)
+    {
+        long long row = (offset + n) / nx;
+        long long i0 = (offset + n) % nx;
+        long long nseg = nx - i0 < nvals - n ? nx - i0 : nvals - n;
+        kernel(&g, (int) (row % g.vdims[1]), (int) (row / g.vdims[1]), i0, nseg,
+            (char *) vals + n * vsize);
+        n += nseg;
+    }
+}
+
+/* When set, vars hold a description of their data instead of the data itself */
+static int lazy_vars = 0;
+
+static json_object *
+make_prng_key_array(MACSIO_DATA_CBPRNGKey_t const *key)
+{
+    json_object *key_obj = json_object_new_array();
+
+    json_object_array_add(key_obj, json_object_new_int64(key->seed));
+    json_object_array_add(key_obj, json_object_new_int64(key->rank));
+    json_object_array_add(key_obj, json_object_new_int64(key->part));
+    json_object_array_add(key_obj, json_object_new_int64(key->var));
+
+    return key_obj;
+}
+
+/* Everything needed to (re)generate any range of a var's values */
+static json_object *
+make_lazy_data(char const *gen_kind, char const *dtype, int ndims, int const *dims,
+    double const *bounds, int const *vdims, MACSIO_DATA_CBPRNGKey_t const *key)
+{
+    json_object *lazy_obj = json_object_new_object();
+    long long nvals = 1;
+    int i;
+
+    for (i = 0; i < ndims; i++)
+        nvals *= vdims[i];
+
+    json_object_object_add(lazy_obj, "Kind", json_object_new_string(gen_kind));
+    json_object_object_add(lazy_obj, "DType", json_object_new_string(dtype));
+    json_object_object_add(lazy_obj, "NodeDims", MACSIO_UTILS_MakeDimsJsonArray(ndims, dims));
+    json_object_object_add(lazy_obj, "ValDims", MACSIO_UTILS_MakeDimsJsonArray(ndims, vdims));
+    json_object_object_add(lazy_obj, "Bounds", MACSIO_UTILS_MakeBoundsJsonArray(bounds));
+    json_object_object_add(lazy_obj, "NumVals", json_object_new_int64(nvals));
+    json_object_object_add(lazy_obj, "Key", make_prng_key_array(key));
+
+    return lazy_obj;
+}
+
+int
+MACSIO_DATA_VarIsLazy(json_object *var_obj)
+{
+    return json_object_path_get_object(var_obj, "LazyData") != 0;
+}
+
+char const *
+MACSIO_DATA_LazyVarDType(json_object *var_obj)
+{
+    return json_object_path_get_string(var_obj, "LazyData/DType");
+}
+
+long long
+MACSIO_DATA_LazyVarNumVals(json_object *var_obj)
+{
+    return (long long) json_object_path_get_int(var_obj, "LazyData/NumVals");
+}
+
+void
+MACSIO_DATA_GetLazyVarChunk(json_object *var_obj, long long offset, long long nvals, void *buf)
+{
+    json_object *lazy_obj = json_object_path_get_object(var_obj, "LazyData");
+    int i, ndims = json_object_array_length(json_object_path_get_array(lazy_obj, "ValDims"));
+    int dims[3] = {1,1,1}, vdims[3] = {1,1,1};
+    double bounds[6];
+    MACSIO_DATA_CBPRNGKey_t key;
+
+    for (i = 0; i < ndims; i++)
+    {
+        dims[i] = JsonGetInt(lazy_obj, "NodeDims", i);
+        vdims[i] = JsonGetInt(lazy_obj, "ValDims", i);
+    }
+    for (i = 0; i < 6; i++)
+        bounds[i] = JsonGetDbl(lazy_obj, "Bounds", i);
+    key.seed = (unsigned) JsonGetInt(lazy_obj, "Key", 0);
+    key.rank = (unsigned) JsonGetInt(lazy_obj, "Key", 1);
+    key.part = (unsigned) JsonGetInt(lazy_obj, "Key", 2);
+    key.var  = (unsigned) JsonGetInt(lazy_obj, "Key", 3);
+
+    MACSIO_DATA_FillScalarVarRange(json_object_path_get_string(lazy_obj, "Kind"),
+        ndims, dims, bounds, vdims, &key, offset, nvals, buf);
+}
+
+unsigned long long
+MACSIO_DATA_LazyVarsNbytes(json_object *problem_obj)
+{
+    json_object *parts = json_object_path_get_array(problem_obj, "parts");
+    unsigned long long nbytes = 0;
+    int i, j;
+
+    for (i = 0; parts && i < json_object_array_length(parts); i++)
+    {
+        json_object *vars = json_object_path_get_array(json_object_array_get_idx(parts, i), "Vars");
+        for (j = 0; vars && j < json_object_array_length(vars); j++)
+        {
+            json_object *var_obj = json_object_array_get_idx(vars, j);
+            if (!MACSIO_DATA_VarIsLazy(var_obj)) continue;
+            nbytes += (unsigned long long) MACSIO_DATA_LazyVarNumVals(var_obj) *
+                (strcmp(MACSIO_DATA_LazyVarDType(var_obj), "int") ? sizeof(double) : sizeof(int));
+        }
+    }
+    return nbytes;
+}
+
 //#warning REPLACE STRINGS FOR CENTERING AND DTYPE WITH ENUMS
 //#warning WE NEED TO GENERALIZE THIS VAR METHOD TO ALLOW FOR NON-RECT NODE/ZONE CONFIGURATIONS
 //#warning SUPPORT FACE AND EDGE CENTERINGS TOO
 static json_object *
 make_scalar_var(int ndims, int const *dims, double const *bounds,
-    char const *centering, char const *dtype, char const *kind)
+    char const *centering, char const *dtype, char const *kind, int part, int var)
 {
+    /* kinds an expansion var may randomly take on; 0 leaves it zero */
+    static char const *exp_kinds[] = {"", "constant", "random", "xramp", "spherical",
+                                      "noise", "noise_sum", "ysin"};
     json_object *var_obj = json_object_new_object();
-    int i,j,k,n;
+    int i;
     int dims2[3] = {1,1,1};
-    double dims_diameter2 = 1;
     int minus_one = strcmp(centering, "zone")?0:-1;
     json_object *data_obj;
-    double *valdp;
-    int    *valip;
 
     for (i = 0; i < ndims; i++)
-    { 
         dims2[i] = dims[i] + minus_one;
-        dims_diameter2 += dims[i]*dims[i];
-    }
 
 //#warning NEED EXPLICIT NAME FOR VARIABLE
     json_object_object_add(var_obj, "name", json_object_new_string(kind));
     json_object_object_add(var_obj, "centering", json_object_new_string(centering));
+
+    char const *gen_kind = kind;
+    if (strstr(kind, "expansion")!=NULL)
+        gen_kind = exp_kinds[MD_random()%8];
+
+    /* Random data is keyed by global part and variable number, not rank, so
+       it differs across parts and can be regenerated from the key, on any
+       rank, to validate what is read back. */
+    MACSIO_DATA_CBPRNGKey_t key = MACSIO_DATA_CBPRNGKey(0, (unsigned) part, (unsigned) var);
+    if (strstr(gen_kind, "random")!=NULL)
+        json_object_object_add(var_obj, "PRNGKey", make_prng_key_array(&key));
+
+    if (lazy_vars)
+    {
+        json_object_object_add(var_obj, "LazyData",
+            make_lazy_data(gen_kind, dtype, ndims, dims, bounds, dims2, &key));
+        return var_obj;
+    }
+
     if (!strcmp(dtype, "double"))
         data_obj = json_object_new_extarr_alloc(json_extarr_type_flt64, ndims, dims2, 0);
     else if (!strcmp(dtype, "int"))
         data_obj = json_object_new_extarr_alloc(json_extarr_type_int32, ndims, dims2, 0);
     json_object_object_add(var_obj, "data", data_obj);
-    valdp = (double *) json_object_extarr_data(data_obj);
-    valip = (int *) json_object_extarr_data(data_obj);
-
-    int exp_random_type = -1;
-    if (strstr(kind, "expansion")!=NULL){
-        exp_random_type = MD_random()%8;
-    }
 
-    n = 0;
-//#warning PASS RANK OR RANDOM SEED IN HERE TO ENSURE DIFF PROCESSORS HAVE DIFF RANDOM DATA
-    for (k = 0; k < dims2[2]; k++)
-    {
-        for (j = 0; j < dims2[1]; j++)
-        {
-            for (i = 0; i < dims2[0]; i++)
-            {
-//#warning PUT THESE INTO A GENERATOR FUNCTION
 //#warning ACCOUNT FOR HALF ZONE OFFSETS
-                if (strstr(kind, "constant")!=NULL || exp_random_type == 1)
-                    valdp[n++] = 1.0;
-                else if (strstr(kind, "random")!=NULL || exp_random_type == 2)
-                    valdp[n++] = (double) (MD_random() % 1000) / 1000;
-                else if (strstr(kind, "xramp")!=NULL || exp_random_type == 3)
-                    valdp[n++] = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
-                else if (strstr(kind, "spherical")!=NULL || exp_random_type == 4)
-                {
-                    double x = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
-                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
-                    double z = bounds[2] + k * MACSIO_UTILS_ZDelta(dims, bounds);
-                    valdp[n++] = sqrt(x*x+y*y+z*z);
-                }
-                else if (strstr(kind, "noise")!=NULL || exp_random_type == 5)
-                {
-                    double x = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
-                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
-                    double z = bounds[2] + k * MACSIO_UTILS_ZDelta(dims, bounds);
-                    valdp[n++] = noise(x,y,z,bounds);
-                }
-                else if (strstr(kind, "noise_sum")!=NULL || exp_random_type == 6)
-                {
-//#warning SHOULD USE GLOBAL DIMS DIAMETER HERE
-                    int q, nlevels = (int) log2(sqrt(dims_diameter2))+1;
-                    double x = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
-                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
-                    double z = bounds[2] + k * MACSIO_UTILS_ZDelta(dims, bounds);
-                    double mult = 1;
-                    valdp[n++] = 0;
-                    for (q = 0; q < nlevels; q++)
-                    {
-                        valdp[n-1] += 1/mult * fabs(noise(mult*x,mult*y,mult*z,bounds));
-                        mult *= 2;
-                    }
-                }
-                else if (strstr(kind, "ysin")!=NULL || exp_random_type == 7)
-                {
-                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
-                    valdp[n++] = sin(y*3.1415266);
-                }
-                else if (strstr(kind, "xlayers")!=NULL || exp_random_type == 8)
-                {
-                    valip[n++] = (i / 20) % 3;
-                }
-            }
-        }
-    }
-//#warning ADD CHECKSUM TO JSON OBJECT
+    MACSIO_DATA_FillScalarVar(gen_kind, ndims, dims, bounds, dims2, &key,
+        (void *) json_object_extarr_data(data_obj));
 
-    return var_obj; 
+    return var_obj;
 
 }
 
@@ -1028,7 +1388,7 @@ make_subset_var(int ndims, int const *dims, double const *bounds)
 }
 
 static json_object *
-make_mesh_vars(int ndims, int const *dims, double const *bounds, int nvars)
+make_mesh_vars(int chunkId, int ndims, int const *dims, double const *bounds, int nvars)
 {
     json_object *vars_array = json_object_new_array();
     char const *centering_names[2] = {"zone", "node"};
@@ -1052,7 +1412,7 @@ make_mesh_vars(int ndims, int const *dims, double const *bounds, int nvars)
         else
             snprintf(tmpname, sizeof(tmpname), "%s_%03d", name, (i-8)/8);
 
-        json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, tmpname));
+        json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, tmpname, chunkId, i));
     }
     return vars_array;
 }
@@ -1072,7 +1432,7 @@ static json_object *make_uniform_mesh_chunk(int chunkId, int ndims, int const *d
     json_object_object_add(mesh_obj, "Coords", make_uniform_mesh_coords(ndims, dims, bounds));
     json_object_object_add(mesh_obj, "Topology", make_uniform_mesh_topology(ndims, dims));
     json_object_object_add(chunk_obj, "Mesh", mesh_obj);
-    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(ndims, dims, bounds, nvars));
+    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(chunkId, ndims, dims, bounds, nvars));
     return chunk_obj;
 }
 
@@ -1091,7 +1451,7 @@ static json_object *make_rect_mesh_chunk(int chunkId, int ndims, int const *dims
     json_object_object_add(mesh_obj, "Topology", make_rect_mesh_topology(ndims, dims));
     json_object_object_add(chunk_obj, "Mesh", mesh_obj);
 //#warning ADD NVARS AND VARMAPS ARGS HERE
-    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(ndims, dims, bounds, nvars));
+    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(chunkId, ndims, dims, bounds, nvars));
     return chunk_obj;
 }
 
@@ -1109,7 +1469,7 @@ static json_object *make_curv_mesh_chunk(int chunkId, int ndims, int const *dims
     json_object_object_add(mesh_obj, "Topology", make_curv_mesh_topology(ndims, dims));
     json_object_object_add(chunk_obj, "Mesh", mesh_obj);
 //#warning ADD NVARS AND VARMAPS ARGS HERE
-    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(ndims, dims, bounds, nvars));
+    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(chunkId, ndims, dims, bounds, nvars));
     return chunk_obj;
 }
 
@@ -1126,7 +1486,7 @@ static json_object *make_ucdzoo_mesh_chunk(int chunkId, int ndims, int const *di
     json_object_object_add(mesh_obj, "Coords", make_ucdzoo_mesh_coords(ndims, dims, bounds));
     json_object_object_add(mesh_obj, "Topology", make_ucdzoo_mesh_topology(ndims, dims));
     json_object_object_add(chunk_obj, "Mesh", mesh_obj);
-    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(ndims, dims, bounds, nvars));
+    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(chunkId, ndims, dims, bounds, nvars));
     return chunk_obj;
 }
 
@@ -1143,7 +1503,7 @@ static json_object *make_arb_mesh_chunk(int chunkId, int ndims, int const *dims,
     json_object_object_add(mesh_obj, "Coords", make_arb_mesh_coords(ndims, dims, bounds));
     json_object_object_add(mesh_obj, "Topology", make_arb_mesh_topology(ndims, dims));
     json_object_object_add(chunk_obj, "Mesh", mesh_obj);
-    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(ndims, dims, bounds, nvars));
+    json_object_object_add(chunk_obj, "Vars", make_mesh_vars(chunkId, ndims, dims, bounds, nvars));
     return chunk_obj;
 }
 
@@ -1203,42 +1563,203 @@ static int choose_part_count(int K, int mod, int *R, int *Q, int time_randomize)
     return retval;
 }
 
-//#warning ADD ABILITY TO VARY MESH TOPOLOGY WITH TIME AND ADD KEY TO INDICATE IF ITS BEEN CHANGED
-//#warning GET FUNTION NAMING CONSISTENT THROUGHOUT SOURCE FILES
+/*!
+\brief Decomposition of the global mesh into parts and of parts among ranks
+
+Built once per run (on every rank, identically) so ownership queries need not
+repeat the walk over all parts. By default parts are handed out to ranks in
+chunk id order but a --part_map can assign them arbitrarily. Parts may also
+be scaled in size, by --part_map or --part_distribution, to model imbalance.
+*/
+typedef struct _decomp_t
+{
+    int built;               /**< table has been built */
+    int dim;                 /**< spatial dimension of parts */
+    int nranks;              /**< number of MPI ranks */
+    int total_parts;         /**< number of parts over all ranks */
+    int part_dims[3];        /**< nominal logical (node) dims of every part */
+    int part_block_dims[3];  /**< number of parts in each dimension */
+    int *rank_first_part;    /**< [nranks+1] offset of each rank's parts in rank_parts */
+    int *rank_parts;         /**< [total_parts] chunk ids grouped by owning rank */
+    int *part_owner;         /**< [total_parts] rank owning each chunk id */
+    double *part_scale;      /**< [total_parts] size multiplier of each part */
+} decomp_t;
+static decomp_t decomp;
+
+/* Communicator over which a part map is broadcast, once given */
+static int decomp_have_comm = 0;
+#ifdef HAVE_MPI
+static MPI_Comm decomp_comm;
+#endif
+
+static unsigned decomp_random(int time_randomize)
+{
+    return (unsigned) (time_randomize ? MD_random_rankinv_tv() : MD_random_rankinv());
+}
+
+/* Read part map file on rank 0 and broadcast it over decomp_comm. Each
+   non-blank line not starting with '#' holds, for the next part, the rank
+   owning it and, optionally, a multiplier for its size. */
+static int
+read_part_map(char const *fname, int nranks, int rank, int **owners, double **scales)
+{
+    int n = 0;
+    int *o = 0;
+    double *s = 0;
+
+    if (rank == 0)
+    {
+        FILE *f = fopen(fname, "r");
+        char line[256];
+        int max = 0, lineno = 0;
+
+        if (!f)
+            MACSIO_LOG_MSG(Die, ("Unable to open part map file \"%s\"", fname));
+        while (fgets(line, sizeof(line), f))
+        {
+            int owner;
+            double scale = 1;
+            char *p = line + strspn(line, " \t");
+
+            lineno++;
+            if (*p == '#' || *p == '\n' || *p == '\0') continue;
+            p[strcspn(p, "\r\n")] = '\0';
+            if (sscanf(p, "%d %lf", &owner, &scale) < 1)
+                MACSIO_LOG_MSG(Die, ("Bad line %d, \"%s\", in part map file", lineno, p));
+            if (n == max)
+            {
+                max = max ? 2 * max : 1024;
+                o = (int *) realloc(o, max * sizeof(int));
+                s = (double *) realloc(s, max * sizeof(double));
+            }
+            o[n] = owner;
+            s[n++] = scale;
+        }
+        fclose(f);
+    }
+
+#ifdef HAVE_MPI
+    MPI_Bcast(&n, 1, MPI_INT, 0, decomp_comm);
+    if (rank != 0)
+    {
+        o = (int *) malloc(n * sizeof(int));
+        s = (double *) malloc(n * sizeof(double));
+    }
+    MPI_Bcast(o, n, MPI_INT, 0, decomp_comm);
+    MPI_Bcast(s, n, MPI_DOUBLE, 0, decomp_comm);
+#endif
+
+    for (int i = 0; i < n; i++)
+    {
+        if (o[i] < 0 || o[i] >= nranks)
+            MACSIO_LOG_MSG(Die, ("Part %d mapped to rank %d outside [0,%d)", i, o[i], nranks));
+        if (s[i] <= 0)
+            MACSIO_LOG_MSG(Die, ("Part %d has non-positive size multiplier %g", i, s[i]));
+    }
+    if (n == 0)
+        MACSIO_LOG_MSG(Die, ("Part map file \"%s\" holds no parts", fname));
+
+    *owners = o;
+    *scales = s;
+    return n;
+}
+
+/* Per-rank weights for a --part_distribution; 0 for uniform. Heavy ranks are
+   chosen with the rank-invariant PRNG so all ranks make the same choice. */
+static double *
+rank_weights(char const *dist, int nranks, int time_randomize)
+{
+    double *w;
+    double a = 0, b = 0;
+    int *perm;
+    int i;
+
+    if (!dist || !strncmp(dist, "uniform", 7))
+        return 0;
+
+    w = (double *) malloc(nranks * sizeof(double));
+    perm = (int *) malloc(nranks * sizeof(int));
+    for (i = 0; i < nranks; i++)
+        perm[i] = i;
+    for (i = nranks - 1; i > 0; i--)
+    {
+        int j = decomp_random(time_randomize) % (i + 1);
+        int tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+    }
+
+    if (!strncmp(dist, "zipf", 4))
+    {
+        /* weight of k-th heaviest rank is 1/k^s */
+        a = 1;
+        sscanf(dist, "zipf:%lf", &a);
+        for (i = 0; i < nranks; i++)
+            w[perm[i]] = pow(i + 1, -a);
+    }
+    else if (!strncmp(dist, "bimodal", 7))
+    {
+        /* fraction a of ranks, chosen at random, are b times heavier */
+        a = 0.5; b = 10;
+        sscanf(dist, "bimodal:%lf:%lf", &a, &b);
+        for (i = 0; i < nranks; i++)
+            w[perm[i]] = i < lround(a * nranks) ? b : 1;
+    }
+    else if (!strncmp(dist, "hotspot", 7))
+    {
+        /* contiguous block of a fraction a of ranks are b times heavier */
+        int n, first = perm[0];
+        a = 0.05; b = 10;
+        sscanf(dist, "hotspot:%lf:%lf", &a, &b);
+        n = (int) lround(a * nranks);
+        if (n < 1) n = 1;
+        for (i = 0; i < nranks; i++)
+            w[i] = (i - first + nranks) % nranks < n ? b : 1;
+    }
+    else
+    {
+        MACSIO_LOG_MSG(Die, ("Unknown --part_distribution \"%s\"", dist));
+    }
+
+    free(perm);
+    return w;
+}
+
 //#warning MAYBE PASS IN SEED HERE OR ADD TO MAIN_OBJ
-//#warning COULD IMPROVE DESIGN A BIT BY SEPARATING ALGORITHM FOR GEN WITH A CALLBACK
-/* Just a very simple spatial partitioning. We use the same exact algorithm
-   to determine which rank owns a chunk. So, we overload this method and
-   for that purpose as well even though in that case, it doesn generate
-   anything. */
-json_object *
-MACSIO_DATA_GenerateTimeZeroDumpObject(json_object *main_obj, int *rank_owning_chunkId)
+/* Just a very simple spatial partitioning */
+static decomp_t const *
+get_decomp(json_object *main_obj)
 {
-//#warning FIX LEAK OF OBJECTS FOR QUERY CASE
-    json_object *mesh_obj = rank_owning_chunkId?0:json_object_new_object();
-    json_object *global_obj = rank_owning_chunkId?0:json_object_new_object();
-    json_object *part_array = rank_owning_chunkId?0:json_object_new_array();
     int size = json_object_path_get_int(main_obj, "parallel/mpi_size");
     int part_size = json_object_path_get_int(main_obj, "clargs/part_size") / sizeof(double);
     double avg_num_parts = json_object_path_get_double(main_obj, "clargs/avg_num_parts");
     int dim = json_object_path_get_int(main_obj, "clargs/part_dim");
-    int vars_per_part = json_object_path_get_int(main_obj, "clargs/vars_per_part");
     double total_num_parts_d = size * avg_num_parts;
     int total_num_parts = (int) lround(total_num_parts_d);
-    int myrank = json_object_path_get_int(main_obj, "parallel/mpi_rank");
     int time_randomize = JsonGetInt(main_obj, "clargs/time_randomize");
+    char const *part_map = json_object_path_get_string(main_obj, "clargs/part_map");
+    char const *part_dist = json_object_path_get_string(main_obj, "clargs/part_distribution");
 
     int K = floor(avg_num_parts); /* some ranks get K parts */
-    int K1 = K+1;                 /* some ranks get K+1 parts */
     int Q = total_num_parts - size * K; /* # ranks with K+1 parts */
     int R = size - Q;                   /* # ranks with K parts */
     int mod = ((double)K == avg_num_parts)?1:2;
-    int nx_parts = total_num_parts, ny_parts = 1, nz_parts = 1;
+    int nx_parts, ny_parts = 1, nz_parts = 1;
     int nx = part_size, ny = 1, nz = 1;
-    int ipart_width = 1, jpart_width = 0, kpart_width = 0;
-    int ipart, jpart, kpart, chunk, rank, parts_on_this_rank;
-    int part_dims[3], part_block_dims[3], global_log_dims[3], global_indices[3];
-    double part_bounds[6], global_bounds[6];
+    int chunk, rank, parts_on_this_rank;
+    int *map_owners = 0;
+    double *map_scales = 0, *weights, wsum;
+
+    if (decomp.built)
+        return &decomp;
+
+    /* A part map determines the number of parts */
+    if (part_map && strlen(part_map))
+    {
+        if (!decomp_have_comm)
+            MACSIO_LOG_MSG(Die, ("MACSIO_DATA_BuildDecomposition must be called first with --part_map"));
+        total_num_parts = read_part_map(part_map, size,
+            JsonGetInt(main_obj, "parallel/mpi_rank"), &map_owners, &map_scales);
+    }
+    nx_parts = total_num_parts;
 
     /* Determine spatial size and arrangement of parts */
     if (dim == 1)
@@ -1257,11 +1778,10 @@ MACSIO_DATA_GenerateTimeZeroDumpObject(json_object *main_obj, int *rank_owning_c
 	}
 	if (!mesh_bounds){
 	    MACSIO_UTILS_Best2DFactors(part_size, &nx, &ny);
-	} else { 
+	} else {
 	    nx = JsonGetInt(mesh_bounds,"", 0);
 	    ny = JsonGetInt(mesh_bounds, "", 1);
 	}
-	jpart_width = 1;
     }
     else if (dim == 3)
     {
@@ -1281,95 +1801,352 @@ MACSIO_DATA_GenerateTimeZeroDumpObject(json_object *main_obj, int *rank_owning_c
 	    ny = JsonGetInt(mesh_bounds,"",1);
 	    nz = JsonGetInt(mesh_bounds,"",2);
 	}
-        jpart_width = 1;
-        kpart_width = 1;
     }
-    MACSIO_UTILS_SetDims(part_dims, nx, ny, nz);
-    MACSIO_UTILS_SetDims(part_block_dims, nx_parts, ny_parts, nz_parts);
-    MACSIO_UTILS_SetDims(global_log_dims, nx * nx_parts, ny * ny_parts, nz * nz_parts);
-    MACSIO_UTILS_SetBounds(global_bounds, 0, 0, 0,
-        nx_parts * ipart_width, ny_parts * jpart_width, nz_parts * kpart_width);
-    if (!rank_owning_chunkId)
+    decomp.dim = dim;
+    decomp.nranks = size;
+    decomp.total_parts = nx_parts * ny_parts * nz_parts;
+    MACSIO_UTILS_SetDims(decomp.part_dims, nx, ny, nz);
+    MACSIO_UTILS_SetDims(decomp.part_block_dims, nx_parts, ny_parts, nz_parts);
+    if (map_owners && decomp.total_parts != total_num_parts)
+        MACSIO_LOG_MSG(Die, ("--mesh_decomp gives %d parts but part map has %d",
+            decomp.total_parts, total_num_parts));
+
+    if (map_owners)
     {
-        json_object_object_add(global_obj, "TotalParts", json_object_new_int(total_num_parts));
-//#warning NOT SURE PartsLogDims IS USEFUL IN GENERAL CASE
-        json_object_object_add(global_obj, "PartsLogDims", MACSIO_UTILS_MakeDimsJsonArray(dim, part_block_dims));
-        json_object_object_add(global_obj, "LogDims", MACSIO_UTILS_MakeDimsJsonArray(dim, global_log_dims));
-        json_object_object_add(global_obj, "Bounds", MACSIO_UTILS_MakeBoundsJsonArray(global_bounds));
-        json_object_object_add(mesh_obj, "global", global_obj);
+        decomp.part_owner = map_owners;
+        decomp.part_scale = map_scales;
     }
-
-    rank = 0;
-    chunk = 0;
-
-    /* If we haven't set a seed for the run then take this from the clock.
-     * This should allow us to randomise the decomposition between runs but
-     * still use this overloaded function to identify chunk ownership within
-     * a single run
-     */
-    if (time_randomize)
-        latest_rand_num = MD_random_rankinv_tv();
     else
-        latest_rand_num = MD_random_rankinv();
-    parts_on_this_rank = choose_part_count(K,mod,&R,&Q,time_randomize);
-    for (ipart = 0; ipart < nx_parts; ipart++)
     {
-        for (jpart = 0; jpart < ny_parts; jpart++)
+        decomp.part_owner = (int *) malloc(decomp.total_parts * sizeof(int));
+        decomp.part_scale = (double *) malloc(decomp.total_parts * sizeof(double));
+
+        /* If we haven't set a seed for the run then take this from the clock.
+         * This should allow us to randomise the decomposition between runs.
+         * All ranks draw the same rank-invariant values here so all build the
+         * same table.
+         */
+        latest_rand_num = decomp_random(time_randomize);
+        rank = 0;
+        parts_on_this_rank = choose_part_count(K,mod,&R,&Q,time_randomize);
+        for (chunk = 0; chunk < decomp.total_parts; chunk++)
         {
-            for (kpart = 0; kpart < nz_parts; kpart++)
+            /* skip ranks with no parts; any excess parts go to the last rank */
+            while (parts_on_this_rank <= 0 && rank < size - 1)
             {
-                if (!rank_owning_chunkId && rank == myrank)
-                {
-                    int global_log_origin[3];
-                    /* build mesh part on this rank */
-                    MACSIO_UTILS_SetBounds(part_bounds, (double) ipart, (double) jpart, (double) kpart,
-                        (double) ipart+ipart_width, (double) jpart+jpart_width, (double) kpart+kpart_width);
-                    json_object *part_obj = make_mesh_chunk(chunk, dim, part_dims, part_bounds,
-                        json_object_path_get_string(main_obj, "clargs/part_type"), vars_per_part);
-                    MACSIO_UTILS_SetDims(global_indices, ipart, jpart, kpart);
-//#warning MAYBE MOVE GLOBAL LOG INDICES TO make_mesh_chunk
-//#warning GlogalLogIndices MAY NOT BE NEEDED
-                    json_object_object_add(part_obj, "GlobalLogIndices",
-                        MACSIO_UTILS_MakeDimsJsonArray(dim, global_indices));
-                    MACSIO_UTILS_SetDims(global_log_origin, ipart * nx, jpart * ny, kpart * nz);
-                    json_object_object_add(part_obj, "GlobalLogOrigin",
-                        MACSIO_UTILS_MakeDimsJsonArray(dim, global_log_origin));
-                    json_object_array_add(part_array, part_obj);
-                }
-                else if (rank_owning_chunkId && *rank_owning_chunkId == chunk)
-                {
-                    *rank_owning_chunkId = rank;
-                    return 0;
-                }
-                chunk++;
-                parts_on_this_rank--;
-                if (parts_on_this_rank == 0)
-                {
-                    rank++;
-                    parts_on_this_rank = choose_part_count(K,mod,&R,&Q,time_randomize);
-                }
+                rank++;
+                parts_on_this_rank = choose_part_count(K,mod,&R,&Q,time_randomize);
             }
+            decomp.part_owner[chunk] = rank;
+            decomp.part_scale[chunk] = 1;
+            parts_on_this_rank--;
         }
-    } 
+    }
+
+    /* Scale parts by the weights of their owners keeping total size fixed */
+    weights = rank_weights(part_dist, size, time_randomize);
+    if (weights)
+    {
+        for (chunk = 0, wsum = 0; chunk < decomp.total_parts; chunk++)
+            wsum += weights[decomp.part_owner[chunk]];
+        for (chunk = 0; chunk < decomp.total_parts; chunk++)
+            decomp.part_scale[chunk] *= weights[decomp.part_owner[chunk]] * decomp.total_parts / wsum;
+        free(weights);
+    }
+
+    /* Group chunk ids by owning rank (counting sort keeps them ascending) */
+    decomp.rank_first_part = (int *) calloc(size + 1, sizeof(int));
+    decomp.rank_parts = (int *) malloc(decomp.total_parts * sizeof(int));
+    for (chunk = 0; chunk < decomp.total_parts; chunk++)
+        decomp.rank_first_part[decomp.part_owner[chunk]+1]++;
+    for (rank = 0; rank < size; rank++)
+        decomp.rank_first_part[rank+1] += decomp.rank_first_part[rank];
+    for (chunk = 0; chunk < decomp.total_parts; chunk++)
+        decomp.rank_parts[decomp.rank_first_part[decomp.part_owner[chunk]]++] = chunk;
+    for (rank = size; rank > 0; rank--)
+        decomp.rank_first_part[rank] = decomp.rank_first_part[rank-1];
+    decomp.rank_first_part[0] = 0;
+
+    decomp.built = 1;
+    return &decomp;
+}
+
+//#warning ADD ABILITY TO VARY MESH TOPOLOGY WITH TIME AND ADD KEY TO INDICATE IF ITS BEEN CHANGED
+//#warning GET FUNTION NAMING CONSISTENT THROUGHOUT SOURCE FILES
+//#warning COULD IMPROVE DESIGN A BIT BY SEPARATING ALGORITHM FOR GEN WITH A CALLBACK
+/* Generates the parts this rank owns according to the decomposition table.
+   Passing rank_owning_chunkId, for which rank ownership is returned instead,
+   is still supported but MACSIO_DATA_GetRankOwningPart() is preferred. */
+json_object *
+MACSIO_DATA_GenerateTimeZeroDumpObject(json_object *main_obj, int *rank_owning_chunkId)
+{
+    decomp_t const *d = get_decomp(main_obj);
+
+    if (rank_owning_chunkId)
+    {
+        *rank_owning_chunkId = d->part_owner[*rank_owning_chunkId];
+        return 0;
+    }
+
+    json_object *mesh_obj = json_object_new_object();
+    json_object *global_obj = json_object_new_object();
+    json_object *part_array = json_object_new_array();
+    int vars_per_part = json_object_path_get_int(main_obj, "clargs/vars_per_part");
+    int myrank = json_object_path_get_int(main_obj, "parallel/mpi_rank");
+    int dim = d->dim;
+    int ipart_width = 1, jpart_width = dim > 1, kpart_width = dim > 2;
+    int i, chunk;
+    int global_log_dims[3], global_indices[3];
+    double part_bounds[6], global_bounds[6];
+
+    lazy_vars = JsonGetInt(main_obj, "clargs/lazy_vars");
+
+    /* Global dims and part origins count nominal sized parts. They do not
+       describe a mesh with scaled parts, which writers of one global array
+       must refuse (see MACSIO_DATA_PartSizesAreUniform). */
+    MACSIO_UTILS_SetDims(global_log_dims, d->part_dims[0] * d->part_block_dims[0],
+        d->part_dims[1] * d->part_block_dims[1], d->part_dims[2] * d->part_block_dims[2]);
+    MACSIO_UTILS_SetBounds(global_bounds, 0, 0, 0,
+        d->part_block_dims[0] * ipart_width, d->part_block_dims[1] * jpart_width,
+        d->part_block_dims[2] * kpart_width);
+    json_object_object_add(global_obj, "TotalParts", json_object_new_int(d->total_parts));
+//#warning NOT SURE PartsLogDims IS USEFUL IN GENERAL CASE
+    json_object_object_add(global_obj, "PartsLogDims", MACSIO_UTILS_MakeDimsJsonArray(dim, d->part_block_dims));
+    json_object_object_add(global_obj, "LogDims", MACSIO_UTILS_MakeDimsJsonArray(dim, global_log_dims));
+    json_object_object_add(global_obj, "Bounds", MACSIO_UTILS_MakeBoundsJsonArray(global_bounds));
+    json_object_object_add(mesh_obj, "global", global_obj);
+
+    /* build mesh parts on this rank */
+    for (i = d->rank_first_part[myrank]; i < d->rank_first_part[myrank+1]; i++)
+    {
+        int global_log_origin[3], part_dims[3];
+
+        /* a scaled part has finer (or coarser) resolution in x, like a
+           refined region of an AMR mesh, but the same spatial bounds */
+        chunk = d->rank_parts[i];
+        MACSIO_UTILS_SetDims(part_dims, d->part_dims[0], d->part_dims[1], d->part_dims[2]);
+        if (d->part_scale[chunk] != 1)
+        {
+            part_dims[0] = (int) lround(part_dims[0] * d->part_scale[chunk]);
+            if (part_dims[0] < 2) part_dims[0] = 2;
+        }
+
+        MACSIO_DATA_GetPartGlobalLogIndices(main_obj, chunk, global_indices);
+        MACSIO_UTILS_SetBounds(part_bounds,
+            (double) global_indices[0], (double) global_indices[1], (double) global_indices[2],
+            (double) global_indices[0]+ipart_width, (double) global_indices[1]+jpart_width,
+            (double) global_indices[2]+kpart_width);
+        json_object *part_obj = make_mesh_chunk(chunk, dim, part_dims, part_bounds,
+            json_object_path_get_string(main_obj, "clargs/part_type"), vars_per_part);
+//#warning MAYBE MOVE GLOBAL LOG INDICES TO make_mesh_chunk
+//#warning GlogalLogIndices MAY NOT BE NEEDED
+        json_object_object_add(part_obj, "GlobalLogIndices",
+            MACSIO_UTILS_MakeDimsJsonArray(dim, global_indices));
+        MACSIO_DATA_GetPartGlobalLogOrigin(main_obj, chunk, global_log_origin);
+        json_object_object_add(part_obj, "GlobalLogOrigin",
+            MACSIO_UTILS_MakeDimsJsonArray(dim, global_log_origin));
+        MACSIO_DATA_ChecksumPart(part_obj);
+        json_object_array_add(part_array, part_obj);
+    }
     json_object_object_add(mesh_obj, "parts", part_array);
 
     return mesh_obj;
 
 }
 
+void MACSIO_DATA_BuildDecomposition(
+    json_object *main_obj,
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm
+#else
+    int      mpiComm
+#endif
+)
+{
+#ifdef HAVE_MPI
+    decomp_comm = mpiComm;
+#endif
+    decomp_have_comm = 1;
+    get_decomp(main_obj);
+}
+
 int MACSIO_DATA_GetRankOwningPart(json_object *main_obj, int chunkId)
 {
-    int tmp = chunkId;
-    /* doesn't really generate anything; just goes through the motions
-       necessary to compute which ranks own which parts. */
-    MACSIO_DATA_GenerateTimeZeroDumpObject(main_obj, &tmp);
-    return tmp;
+    return get_decomp(main_obj)->part_owner[chunkId];
+}
+
+int MACSIO_DATA_GetPartsOfRank(json_object *main_obj, int rank, int const **chunkIds)
+{
+    decomp_t const *d = get_decomp(main_obj);
+
+    if (chunkIds)
+        *chunkIds = d->rank_parts + d->rank_first_part[rank];
+    return d->rank_first_part[rank+1] - d->rank_first_part[rank];
+}
+
+double MACSIO_DATA_GetPartSizeScale(json_object *main_obj, int chunkId)
+{
+    return get_decomp(main_obj)->part_scale[chunkId];
+}
+
+void MACSIO_DATA_GetPartCountRange(json_object *main_obj, int *min_parts, int *max_parts)
+{
+    decomp_t const *d = get_decomp(main_obj);
+    int rank, lo = d->total_parts, hi = 0;
+
+    for (rank = 0; rank < d->nranks; rank++)
+    {
+        int n = d->rank_first_part[rank+1] - d->rank_first_part[rank];
+        if (n < lo) lo = n;
+        if (n > hi) hi = n;
+    }
+    if (min_parts) *min_parts = lo;
+    if (max_parts) *max_parts = hi;
+}
+
+int MACSIO_DATA_PartSizesAreUniform(json_object *main_obj)
+{
+    decomp_t const *d = get_decomp(main_obj);
+    int chunk;
+
+    for (chunk = 0; chunk < d->total_parts; chunk++)
+    {
+        if (d->part_scale[chunk] != 1)
+            return 0;
+    }
+    return 1;
+}
+
+void MACSIO_DATA_GetPartGlobalLogIndices(json_object *main_obj, int chunkId, int *indices)
+{
+    decomp_t const *d = get_decomp(main_obj);
+
+    /* chunk ids run fastest in k, then j, then i */
+    MACSIO_UTILS_SetDims(indices,
+        chunkId / (d->part_block_dims[2] * d->part_block_dims[1]),
+        (chunkId / d->part_block_dims[2]) % d->part_block_dims[1],
+        chunkId % d->part_block_dims[2]);
+}
+
+void MACSIO_DATA_GetPartGlobalLogOrigin(json_object *main_obj, int chunkId, int *origin)
+{
+    decomp_t const *d = get_decomp(main_obj);
+    int indices[3];
+
+    MACSIO_DATA_GetPartGlobalLogIndices(main_obj, chunkId, indices);
+    MACSIO_UTILS_SetDims(origin, indices[0] * d->part_dims[0],
+        indices[1] * d->part_dims[1], indices[2] * d->part_dims[2]);
+}
+
+/* Checksum (or verify checksums of) every extarr in obj. Checksums are kept
+   in the part's "Checksums" object keyed by the extarr's path in the part.
+   Verifying counts extarrs without a checksum in nunchecked. */
+static void
+checksum_extarrs(json_object *obj, char *path, size_t pathlen, json_object *sums,
+    int verify, int chunkId, int *nchecked, int *nbad, int *nunchecked)
+{
+    size_t len = strlen(path);
+    int i;
+
+    switch (json_object_get_type(obj))
+    {
+        case json_type_object:
+        {
+            json_object_object_foreach(obj, key, val)
+            {
+                if (!strcmp(key, "Checksums")) continue;
+                snprintf(path + len, pathlen - len, "%s%s", len ? "/" : "", key);
+                checksum_extarrs(val, path, pathlen, sums, verify, chunkId, nchecked, nbad, nunchecked);
+            }
+            break;
+        }
+        case json_type_array:
+        {
+            for (i = 0; i < json_object_array_length(obj); i++)
+            {
+                snprintf(path + len, pathlen - len, "%s%d", len ? "/" : "", i);
+                checksum_extarrs(json_object_array_get_idx(obj, i), path, pathlen, sums,
+                    verify, chunkId, nchecked, nbad, nunchecked);
+            }
+            break;
+        }
+        case json_type_extarr:
+        {
+            json_object *sum_obj = json_object_object_get(sums, path);
+            unsigned crc;
+
+            if (!verify && sum_obj) break; /* already done */
+            if (verify && !sum_obj)         /* nothing to check against */
+            {
+                (*nunchecked)++;
+                break;
+            }
+
+            crc = MACSIO_CRC_Crc32c(json_object_extarr_data(obj), MACSIO_UTILS_ExtarrNbytes(obj), 0);
+            if (!verify)
+            {
+                json_object_object_add(sums, path, json_object_new_int64(crc));
+                break;
+            }
+            (*nchecked)++;
+            if ((unsigned) json_object_get_int64(sum_obj) != crc)
+            {
+                MACSIO_LOG_MSG(Warn, ("Checksum mismatch in part %d at \"%s\"", chunkId, path));
+                (*nbad)++;
+            }
+            break;
+        }
+        default: break;
+    }
+    path[len] = '\0';
+}
+
+void MACSIO_DATA_ChecksumPart(json_object *part_obj)
+{
+    json_object *sums = json_object_path_get_object(part_obj, "Checksums");
+    char path[256] = "";
+
+    if (!sums)
+    {
+        sums = json_object_new_object();
+        json_object_object_add(part_obj, "Checksums", sums);
+    }
+    checksum_extarrs(part_obj, path, sizeof(path), sums, 0, 0, 0, 0, 0);
 }
 
 int MACSIO_DATA_ValidateDataRead(json_object *main_obj)
 {
-//#warning IMPLEMENT THE DATA READ VALIDATION 
-    return 0;
+    json_object *parts = json_object_path_get_array(main_obj, "problem/parts");
+    int i, j, nchecked = 0, nbad = 0, nunchecked = 0, nlazy = 0;
+
+    if (!parts)
+        parts = json_object_path_get_array(main_obj, "parts");
+
+    for (i = 0; parts && i < json_object_array_length(parts); i++)
+    {
+        json_object *part_obj = json_object_array_get_idx(parts, i);
+        json_object *sums = json_object_path_get_object(part_obj, "Checksums");
+        json_object *vars = json_object_path_get_array(part_obj, "Vars");
+        char path[256] = "";
+
+        for (j = 0; vars && j < json_object_array_length(vars); j++)
+            nlazy += MACSIO_DATA_VarIsLazy(json_object_array_get_idx(vars, j));
+        if (!sums) continue;
+        checksum_extarrs(part_obj, path, sizeof(path), sums, 1,
+            json_object_path_get_int(part_obj, "Mesh/ChunkID"), &nchecked, &nbad, &nunchecked);
+    }
+
+    if (nlazy)
+        MACSIO_LOG_MSG(Info, ("%d lazy variables have no data or checksums and were not validated", nlazy));
+    if (nunchecked)
+        MACSIO_LOG_MSG(Info, ("%d arrays read have no checksum and were not validated", nunchecked));
+
+    if (nbad)
+        MACSIO_LOG_MSG(Err, ("%d of %d arrays read failed checksum validation", nbad, nchecked));
+    else
+        MACSIO_LOG_MSG(Dbg1, ("%d arrays read passed checksum validation", nchecked));
+
+    return nbad;
 }
 
 int MACSIO_DATA_SimpleAssignKPartsToNProcs(int k, int n, int my_rank, int *my_part_cnt, int **my_part_ids)
@@ -1387,6 +2164,7 @@ MACSIO_DATA_EvolveDataset(json_object *main_obj, int *dataset_evolved, float fac
     json_object *part_array = json_object_path_get_array(main_obj, "problem/parts");
     json_object *part_obj = json_object_array_get_idx(part_array, 0);
     json_object *vars_array = json_object_path_get_array(part_obj, "Vars");
+    int chunkId = json_object_path_get_int(part_obj, "Mesh/ChunkID");
 
     char const *centering = "node";
     char const *type = "double";
@@ -1420,7 +2198,8 @@ MACSIO_DATA_EvolveDataset(json_object *main_obj, int *dataset_evolved, float fac
     int whole;
     for (whole=1; whole<arrays_required; whole++){
         snprintf(name, sizeof(name), "expansion_%03d", *dataset_evolved);
-        json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, name));
+        json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, name,
+            chunkId, json_object_array_length(vars_array)));
         *dataset_evolved += 1;
     }
 
@@ -1439,7 +2218,9 @@ MACSIO_DATA_EvolveDataset(json_object *main_obj, int *dataset_evolved, float fac
     }
 
     snprintf(name, sizeof(name), "expansion_%03d", *dataset_evolved);
-    json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, name));
+    json_object_array_add(vars_array, make_scalar_var(ndims, dims, bounds, centering, type, name,
+        chunkId, json_object_array_length(vars_array)));
+    MACSIO_DATA_ChecksumPart(part_obj);
 
     return main_obj;
 }
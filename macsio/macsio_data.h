@@ -26,6 +26,10 @@ this program; if not, write to the Free Software Foundation, Inc., 59 Temple
 Place, Suite 330, Boston, MA 02111-1307 USA
 */
 
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
 /*!
 \defgroup MACSIO_DATA MACSIO_DATA
 \brief Data (Mesh) Generation
@@ -65,8 +69,10 @@ MACSIO_DATA_ResetPRNG(
 
 /*!
 \brief Get next value from PRNG
-\return Next value from the PRNG sequence. Logically equivalent to calling
-        random().
+
+PRNGs are counter-based and keep no shared (libc) state so different PRNGs
+may be used concurrently from different threads. A given PRNG may not.
+\return Next value from the PRNG sequence. Same range as random().
 */
 extern long
 MACSIO_DATA_GetValPRNG(
@@ -144,6 +150,68 @@ from run to run
 */
 #define MD_random_rankinv_tv() MACSIO_DATA_GetValPRNG(5)
 
+/*!
+\brief Key for a counter-based PRNG stream
+
+Values from a counter-based PRNG are a pure function of this key and an
+element index. Any value in a stream can be computed independently of any
+other (in any order, on any thread) and a stream can be regenerated at any
+time from its key alone, e.g. to validate data read back from a file.
+*/
+typedef struct MACSIO_DATA_CBPRNGKey_t
+{
+    unsigned seed; /**< global seed */
+    unsigned rank; /**< MPI rank (0 for rank-independent streams) */
+    unsigned part; /**< global mesh part (chunk) id */
+    unsigned var;  /**< variable number within the part */
+} MACSIO_DATA_CBPRNGKey_t;
+
+/*!
+\brief Make a counter-based PRNG key using the default seed
+*/
+extern MACSIO_DATA_CBPRNGKey_t
+MACSIO_DATA_CBPRNGKey(
+    unsigned rank, /**< MPI rank (0 for rank-independent streams) */
+    unsigned part, /**< global mesh part (chunk) id */
+    unsigned var   /**< variable number within the part */
+);
+
+/*!
+\brief Get value at a given index of a counter-based PRNG stream
+\return A 32 bit random value. This is a pure function of \c key and \c idx.
+*/
+extern unsigned
+MACSIO_DATA_CBPRNGGetVal(
+    MACSIO_DATA_CBPRNGKey_t const *key, /**< key identifying the stream */
+    unsigned long long idx              /**< index of the value in the stream */
+);
+
+/*!
+\brief Fill an array with consecutive values of a counter-based PRNG stream
+
+Results are identical to calling \c MACSIO_DATA_CBPRNGGetVal() for each index
+but values are generated 4 at a time. Disjoint index ranges can be filled
+concurrently from different threads.
+*/
+extern void
+MACSIO_DATA_CBPRNGFill(
+    MACSIO_DATA_CBPRNGKey_t const *key, /**< key identifying the stream */
+    unsigned long long idx0,            /**< index of first value */
+    long long n,                        /**< number of values */
+    unsigned *vals                      /**< [out] caller allocated array of \c n values */
+);
+
+/*!
+\brief Like \c MACSIO_DATA_CBPRNGFill() but for doubles uniform in [0,1)
+*/
+extern void
+MACSIO_DATA_CBPRNGFillDouble(
+    MACSIO_DATA_CBPRNGKey_t const *key, /**< key identifying the stream */
+    unsigned long long idx0,            /**< index of first value */
+    long long n,                        /**< number of values */
+    double *vals                        /**< [out] caller allocated array of \c n values */
+);
+
 /*!
 \brief Initialize default Pseudo Random Number Generators (PRNGs)
 Should be called near beginning of application startup.
@@ -191,14 +259,148 @@ MACSIO_DATA_MakeRandomTable(
 
 /*!@}*/
 
+/*!
+\brief Construct a small object for a trickle dump
+
+A time-history record consisting of the trickle number, time and an array
+of values of approximately \c nbytes bytes.
+*/
+extern struct json_object *
+MACSIO_DATA_MakeTrickleObject(
+    int nbytes,        /**< approximate size in bytes of the trickle object's data */
+    int trickleNum,    /**< number/index of this trickle dump */
+    double trickleTime /**< time to associate with this trickle dump */
+);
+
+/*!
+\brief Fill an array with the values of a variable of a given kind
+
+The kind is matched by name (e.g. "xramp" or "xramp_001") against the known
+kinds: constant, random, xramp, spherical, noise, noise_sum, ysin and xlayers.
+Unknown kinds are zero filled. The generating kernel is selected once for the
+whole variable and, when compiled with OpenMP, k-planes are filled in parallel.
+*/
+extern void
+MACSIO_DATA_FillScalarVar(
+    char const *kind,     /**< kind (name) of the variable */
+    int ndims,            /**< number of dimensions of the mesh part */
+    int const *dims,      /**< logical node dims of the mesh part */
+    double const *bounds, /**< spatial bounds of the mesh part */
+    int const *vdims,     /**< logical dims of the values (one less than \c dims for zone centering) */
+    MACSIO_DATA_CBPRNGKey_t const *key, /**< PRNG key used for "random" kind */
+    void *vals            /**< [out] caller allocated values; int for "xlayers", double otherwise */
+);
+
+/*!
+\brief Fill a contiguous range of the values of a variable of a given kind
+
+Values are indexed in the same (x fastest) order as \c MACSIO_DATA_FillScalarVar()
+and are identical to the corresponding values it produces, however the range
+is split into pieces. Use this to generate a large variable a chunk at a time.
+*/
+extern void
+MACSIO_DATA_FillScalarVarRange(
+    char const *kind,     /**< kind (name) of the variable */
+    int ndims,            /**< number of dimensions of the mesh part */
+    int const *dims,      /**< logical node dims of the mesh part */
+    double const *bounds, /**< spatial bounds of the mesh part */
+    int const *vdims,     /**< logical dims of the values */
+    MACSIO_DATA_CBPRNGKey_t const *key, /**< PRNG key used for "random" kind */
+    long long offset,     /**< index of first value to fill */
+    long long nvals,      /**< number of values to fill */
+    void *vals            /**< [out] caller allocated array of \c nvals values */
+);
+
+/*!
+\defgroup MACSIO_LAZYVARS MACSIO_LAZYVARS
+\brief Variables generated on demand (--lazy_vars)
+
+With --lazy_vars, a mesh part's variables hold a small "LazyData" object
+describing how to generate their values instead of a "data" extarr holding
+them. Plugins that set \c lazyVarsOK in their interface pull values a
+bounded chunk at a time while writing so memory use is independent of
+variable size. Others get ordinary, fully populated variables.
+
+@{
+*/
+
+/*!
+\brief Does a variable hold a generator instead of its data
+*/
+extern int
+MACSIO_DATA_VarIsLazy(
+    struct json_object *var_obj /**< a member of a part's "Vars" array */
+);
+
+/*!
+\brief Type of a lazy variable's values
+\return "double" or "int"
+*/
+extern char const *
+MACSIO_DATA_LazyVarDType(
+    struct json_object *var_obj /**< a lazy variable */
+);
+
+/*!
+\brief Number of values of a lazy variable
+*/
+extern long long
+MACSIO_DATA_LazyVarNumVals(
+    struct json_object *var_obj /**< a lazy variable */
+);
+
+/*!
+\brief Generate a chunk of a lazy variable's values
+*/
+extern void
+MACSIO_DATA_GetLazyVarChunk(
+    struct json_object *var_obj, /**< a lazy variable */
+    long long offset,            /**< index of first value */
+    long long nvals,             /**< number of values */
+    void *buf                    /**< [out] caller allocated buffer for \c nvals values */
+);
+
+/*!
+\brief Total bytes the lazy variables of a problem would occupy if populated
+*/
+extern unsigned long long
+MACSIO_DATA_LazyVarsNbytes(
+    struct json_object *problem_obj /**< a problem object with a "parts" array */
+);
+
+/*!@}*/
+
 extern struct json_object *
 MACSIO_DATA_GenerateTimeZeroDumpObject(
      struct json_object *main_obj, /**< The main JSON object holding mesh, field, amorphous data */
      int *rank_owning_chunkId /**< missing this info */
 );
 
+/*!
+\brief Build the decomposition of the mesh into parts and of parts among ranks
+
+Collective. A \c --part_map file, if given, is read by the first task of
+\c mpiComm and broadcast. Without a part map, the decomposition is otherwise
+built on first use by any of the queries below, but with one this must be
+called before them and before \c MACSIO_DATA_GenerateTimeZeroDumpObject().
+*/
+extern void
+MACSIO_DATA_BuildDecomposition(
+    struct json_object *main_obj, /**< [in] The main JSON object holding the command-line args */
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm              /**< [in] The MPI communicator of all ranks in \c main_obj */
+#else
+    int      mpiComm              /**< [in] Dummy MPI communicator */
+#endif
+);
+
 /*!
 \brief Given a chunkId, return rank of owning task
+
+The decomposition of the mesh into parts and their assignment to ranks is
+computed once per run, identically on all ranks. After that, this and the
+other ownership queries below are constant time lookups that involve no
+communication.
 */
 extern int
 MACSIO_DATA_GetRankOwningPart(
@@ -207,11 +409,101 @@ MACSIO_DATA_GetRankOwningPart(
 );
 
 /*!
-\brief Not yet implemented
+\brief Get the parts owned by a given rank
+
+\return Number of parts owned by \c rank
+*/
+extern int
+MACSIO_DATA_GetPartsOfRank(
+    struct json_object *main_obj, /**< The main JSON object */
+    int rank,                     /**< MPI rank to query */
+    int const **chunkIds          /**< [out] ascending chunk ids owned by \c rank (optional).
+                                       Do not free. */
+);
+
+/*!
+\brief Get the fewest and most parts owned by any rank
+
+Writers making the same number of collective calls on every rank, such as the
+SIF modes of some plugins, should loop over \c max_parts.
+*/
+extern void
+MACSIO_DATA_GetPartCountRange(
+    struct json_object *main_obj, /**< The main JSON object */
+    int *min_parts,               /**< [out] fewest parts owned by any rank (optional) */
+    int *max_parts                /**< [out] most parts owned by any rank (optional) */
+);
+
+/*!
+\brief Whether all parts have their nominal size
+
+\return Non-zero if no part is scaled by --part_map or --part_distribution
+*/
+extern int
+MACSIO_DATA_PartSizesAreUniform(
+    struct json_object *main_obj /**< The main JSON object */
+);
+
+/*!
+\brief Get the multiplier applied to a part's nominal size
+
+Parts are scaled by --part_map or --part_distribution to model load
+imbalance. Otherwise this is 1.
+*/
+extern double
+MACSIO_DATA_GetPartSizeScale(
+    struct json_object *main_obj, /**< The main JSON object */
+    int chunkId                   /**< chunk id of the part */
+);
+
+/*!
+\brief Get a part's i,j,k position in the global arrangement of parts
+*/
+extern void
+MACSIO_DATA_GetPartGlobalLogIndices(
+    struct json_object *main_obj, /**< The main JSON object */
+    int chunkId,                  /**< chunk id of the part */
+    int *indices                  /**< [out] 3 indices of the part among all parts */
+);
+
+/*!
+\brief Get a part's origin in the global logical (node index) space
+
+The origin assumes every part has its nominal size, so it is only meaningful
+when MACSIO_DATA_PartSizesAreUniform() is true.
+*/
+extern void
+MACSIO_DATA_GetPartGlobalLogOrigin(
+    struct json_object *main_obj, /**< The main JSON object */
+    int chunkId,                  /**< chunk id of the part */
+    int *origin                   /**< [out] 3 logical indices of the part's first node */
+);
+
+/*!
+\brief Checksum a mesh part's arrays
+
+Adds the CRC-32C of each extarr in the part that does not yet have one to
+the part's "Checksums" object, keyed by the path of the extarr in the part
+(e.g. "Vars/3/data"). Parts are checksummed when generated. Call this again
+after adding arrays to a part. Lazy variables have no extarr and are skipped.
+*/
+extern void
+MACSIO_DATA_ChecksumPart(
+    struct json_object *part_obj /**< a mesh part */
+);
+
+/*!
+\brief Validate data read back against checksums computed when it was generated
+
+Every extarr of each part in \c main_obj ("problem/parts" or "parts") for which
+the part has a stored checksum is checksummed and compared. Mismatches are
+logged. Lazy variables (see \c --lazy_vars) have no data when generated, so
+no checksum, and are not validated; how many were skipped is logged.
+\return Number of arrays that failed validation
 */
 extern int
 MACSIO_DATA_ValidateDataRead(
-    struct json_object *main_obj
+    struct json_object *main_obj /**< object holding the parts read */
 );
 
 /*!
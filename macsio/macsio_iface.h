@@ -57,6 +57,23 @@ typedef void (*DumpFunc)(
     double dumpTime /**< [in] like "time" for the dump */
 );
 
+/*! \brief Trickle dump (small, frequent append) function specification
+
+Trickle dumps model the time-history and diagnostic output applications
+emit between their (large) burst dumps. Each is a small object that is
+expected to be appended to whatever trickle file(s) the plugin maintains.
+*/
+typedef void (*TrickleDumpFunc)(
+    int argi, /**< [in] index of argv at which to start processing args */
+    int argc, /**< [in] \c argc from main */
+    char **argv, /**< [in] \c argv from main */
+    json_object *main_obj, /**< [in] the main json data object */
+    json_object *trickle_obj, /**< [in] the small json object to be appended */
+    int dumpNum, /**< [in] number of the most recent burst dump (-1 if none yet) */
+    int trickleNum, /**< [in] like a "cycle number" for the trickle dump */
+    double dumpTime /**< [in] like "time" for the trickle dump */
+);
+
 /*! \brief Main mesh+field load (read) function specification */
 typedef void (*LoadFunc)(
     int argi, /**< [in] index of argv at which to start processing args */
@@ -91,8 +108,10 @@ typedef struct MACSIO_IFACE_Handle_t
 //#warning DEFAULT FILE EXTENSION HERE
 //#warning Features: Async, compression, sif, grid types, uni-modal or bi-modal
     int                  slotUsed;                    /**< [Internal] indicate if this position in table is used */
+    int                  lazyVarsOK;                  /**< Plugin can write lazy variables (see MACSIO_LAZYVARS) */
     ProcessArgsFunc      processArgsFunc;             /**< Plugin's command-line argument processing callback */
     DumpFunc             dumpFunc;                    /**< Plugin's main dump (write) function callback */
+    TrickleDumpFunc      trickleDumpFunc;             /**< Plugin's trickle dump (append) function callback (optional) */
     LoadFunc             loadFunc;                    /**< Plugin's main load (read) function callback */
     QueryFeaturesFunc    queryFeaturesFunc;           /**< Plugin's callback to query its feature set (not in use) */
     IdentifyFileFunc     identifyFileFunc;            /**< Plugin's callback to indicate if it thinks it owns a file */
@@ -24,11 +24,15 @@ this program; if not, write to the Free Software Foundation, Inc., 59 Temple
 Place, Suite 330, Boston, MA 02111-1307 USA
 */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -74,16 +78,70 @@ typedef struct _MACSIO_LOG_LogHandle_t
     int log_line_length;      /**< Maximum length of a message line in the log file */
     int lines_per_proc;       /**< Number of message lines allocated in the file for each processor */
     int extra_lines_proc0;    /**< Additional number of message lines for processor with MPI rank 0 */
+    int nlines;               /**< Number of lines, including the heading, this processor owns */
+    off_t offset;             /**< Offset in the log file of this processor's heading line */
+    char *lines;              /**< In-memory image of this processor's lines when buffered, else 0 */
 //#warning FIX USE OF MUTABLE HERE
-    mutable int current_line; /**< Index into this processor's group of lines in the log file at
-                                   which the next message will be written */
+    mutable unsigned long long next_msg;    /**< Number of messages claimed; determines the line of the next */
+    mutable unsigned long long done_msg;    /**< Messages before this are all completely formatted when buffered */
+    unsigned long long *line_done; /**< [nlines] one more than the last message completed on each line when buffered */
+    mutable unsigned long long flushed_msg; /**< Number of messages written to the log file when buffered */
     mutable log_flags_t flags; /**< Informational flags regarding the log */
+    pthread_mutex_t flush_lock; /**< Serializes flushes */
+    pthread_t flusher;        /**< Background thread flushing a buffered log */
+    int flush_msecs;          /**< Interval between background flushes or 0 if there is no flusher */
+    volatile int stop_flusher; /**< Set to tell the background flusher to exit */
 } MACSIO_LOG_LogHandle_t;
 
+/* Fill in a processor's lines as they appear in a newly created log file. A
+   heading of dashes with "Processor XXXX" at its center followed by blank lines. */
+static void
+prime_lines(char *buf, int rank, int line_len, int nlines)
+{
+    char tmp[32];
+    int i;
+
+    memset(buf, '-', line_len);
+    memset(buf + line_len, ' ', (size_t) line_len * (nlines - 1));
+    for (i = 0; i < nlines; i++)
+        buf[(size_t) (i+1) * line_len - 1] = '\n';
+    sprintf(tmp, "Processor %06d", rank);
+    memcpy(buf + line_len/2 - strlen(tmp)/2, tmp, strlen(tmp));
+}
+
+/* Format a message into one log file line. Newlines in the message are
+   replaced with '!'. If pad, the rest of the line is filled with spaces and
+   the line is terminated with a newline. Returns the message length. */
+static int
+format_line(char *line, int line_len, char const *fmt, va_list ap, int pad)
+{
+    int i, n;
+
+    vsnprintf(line, line_len - 1, fmt, ap);
+    n = (int) strlen(line);
+    for (i = 0; i < n; i++)
+    {
+        if (line[i] == '\n')
+            line[i] = '!';
+    }
+    if (pad)
+    {
+        memset(line + n, ' ', line_len - n);
+        line[line_len-1] = '\n';
+    }
+    return n;
+}
+
+/* Each thread formats messages into its own buffer */
+static __thread char msg_buffer[1024];
+
 /*!
 \brief Internal convenience method to build a message from a printf-style format string and args.
 
 This method is public only because it is used within the \c MACSIO_LOG_MSG convenience macro.
+The message is formatted into a buffer belonging to the calling thread and is valid until the
+thread's next call. Any thread may call it. \c errno is left unchanged so it can still be
+reported with the message.
 */
 char const *
 MACSIO_LOG_MakeMsg(
@@ -91,25 +149,15 @@ MACSIO_LOG_MakeMsg(
     ...                 /**< [in] Optional, variable length set of arguments for format to be printed out. */
 )
 {
-//#warning MAKE THIS THREAD SAFE BY ALLOCATING THE RETURNED STRING OR USE A LARGE CIRCULAR BUFFER
-  static char error_buffer[1024];
-  static int error_buffer_ptr = 0;
-  size_t L,Lmax;
-  char   tmp[sizeof(error_buffer)];
-  va_list ptr;
-
-  va_start(ptr, format);
-
-  vsprintf(tmp, format, ptr);
-  L    = strlen(tmp);
-  Lmax = sizeof(error_buffer) - error_buffer_ptr - 1;
-  if (Lmax < L)
-     tmp[Lmax-1] = '\0';
-  strcpy(error_buffer + error_buffer_ptr,tmp);
+    int save_errno = errno;
+    va_list ptr;
 
-  va_end(ptr);
+    va_start(ptr, format);
+    vsnprintf(msg_buffer, sizeof(msg_buffer), format, ptr);
+    va_end(ptr);
 
-  return error_buffer;
+    errno = save_errno;
+    return msg_buffer;
 }
 
 /*!
@@ -144,29 +192,18 @@ MACSIO_LOG_LogInit(
     MPI_Comm_rank(comm, &rank);
 #endif
 
-    /* Rank 0 "primes" the log file; creates it, populates it
-       with processor header lines and spaces and closes it */
+    /* Rank 0 creates the log file and sizes it but leaves it to each processor
+       to write its own header and blank lines, in parallel, so that startup
+       time does not grow with the number of processors */
     if (path && rank == 0)
     {
-        int i, filefd;
-        char *linbuf = (char*) malloc(line_len * (lines_per_proc + extra_lines_proc0) * sizeof(char));
-        memset(linbuf, '-', line_len * sizeof(char));
-        memset(linbuf+line_len, ' ',  line_len * (lines_per_proc + extra_lines_proc0 - 1) * sizeof(char));
-        for (i = 0; i < lines_per_proc+extra_lines_proc0; i++)
-            linbuf[(i+1)*line_len-1] = '\n';
-        filefd = open(path, O_CREAT|O_WRONLY|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP);
-        for (i = 0; i < size; i++)
+        off_t nbytes = ((off_t) size * lines_per_proc + extra_lines_proc0) * line_len;
+        int filefd = open(path, O_CREAT|O_WRONLY|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP);
+        if (filefd >= 0)
         {
-            char tmp[32];
-            sprintf(tmp, "Processor %06d", i);
-            memcpy(linbuf+line_len/2-strlen(tmp)/2, tmp, strlen(tmp));
-            if (i == 0)
-                write(filefd, linbuf, sizeof(char) * line_len * (lines_per_proc+extra_lines_proc0));
-            else
-                write(filefd, linbuf, sizeof(char) * line_len * lines_per_proc);
+            ftruncate(filefd, nbytes);
+            close(filefd);
         }
-        free(linbuf);
-        close(filefd);
     }
 
 #ifdef HAVE_MPI
@@ -182,16 +219,212 @@ MACSIO_LOG_LogInit(
     retval->log_line_length = path?line_len:1024;
     retval->lines_per_proc = path?lines_per_proc:1000000;
     retval->extra_lines_proc0 = path?extra_lines_proc0:0;
-    retval->current_line = 1; /* never write to line '0' to preserve "Processor XXXX" headings */
+    retval->nlines = retval->lines_per_proc + (rank==0?retval->extra_lines_proc0:0);
+    retval->offset = (off_t) (rank * retval->lines_per_proc + (rank?retval->extra_lines_proc0:0)) *
+                         retval->log_line_length;
+    retval->lines = 0;
+    retval->line_done = 0;
+    retval->next_msg = 0;
+    retval->done_msg = 0;
+    retval->flushed_msg = 0;
     retval->flags.was_logged = 0;
+    pthread_mutex_init(&retval->flush_lock, 0);
+    retval->flush_msecs = 0;
+    retval->stop_flusher = 0;
+
+    /* "Prime" this processor's part of the log file */
+    if (path)
+    {
+        size_t nbytes = (size_t) retval->nlines * line_len;
+        char *linbuf = (char*) malloc(nbytes);
+        prime_lines(linbuf, rank, line_len, retval->nlines);
+        pwrite(retval->logfile, linbuf, nbytes, retval->offset);
+        free(linbuf);
+    }
+
     errno = 0;
     return retval;
 }
 
+/* Write lines of messages not yet written. Writes start on a file system
+   block boundary within this processor's part of the file by widening them
+   back over earlier lines, whose messages are done. They are never widened
+   forward over the lines that follow, where the next messages go and may be
+   being formatted now. */
+static void
+flush_lines(MACSIO_LOG_LogHandle_t const *log, unsigned long long upto)
+{
+    int const blk = 4096;
+    int nmsg_lines = log->nlines - 1;
+    unsigned long long n = upto - log->flushed_msg;
+    int first, last, i;
+
+    if (n == 0) return;
+    if (n >= (unsigned long long) nmsg_lines)
+    {
+        first = 1;
+        last = nmsg_lines;
+    }
+    else
+    {
+        first = 1 + (int) (log->flushed_msg % nmsg_lines);
+        last = 1 + (int) ((upto - 1) % nmsg_lines);
+    }
+
+    /* A range that wraps around is written as two pieces. The lines between
+       them are the next to be written. */
+    for (i = 0; i < 2; i++)
+    {
+        int lo_line = i ? 1 : first;
+        int hi_line = (i || last >= first) ? last : nmsg_lines;
+        int min_line = (i || last >= first) ? 0 : last + 1;
+        off_t lo = log->offset + (off_t) lo_line * log->log_line_length;
+        off_t hi = log->offset + (off_t) (hi_line + 1) * log->log_line_length;
+        off_t min = log->offset + (off_t) min_line * log->log_line_length;
+
+        lo = lo / blk * blk;
+        if (lo < min) lo = min;
+        pwrite(log->logfile, log->lines + (lo - log->offset), hi - lo, lo);
+
+        if (last >= first) break;
+    }
+    log->flushed_msg = upto;
+}
+
+/* Advance done_msg over messages completely formatted, up to but not past
+   the first that is not. Messages may complete in any order so a count of
+   those completed says nothing of which. Called with flush_lock held. */
+static unsigned long long
+advance_done(MACSIO_LOG_LogHandle_t const *log, unsigned long long upto)
+{
+    int nmsg_lines = log->nlines - 1;
+
+    while (log->done_msg < upto)
+    {
+        int line = 1 + (int) (log->done_msg % nmsg_lines);
+        if (__atomic_load_n(&log->line_done[line], __ATOMIC_ACQUIRE) <= log->done_msg)
+            break;
+        log->done_msg++;
+    }
+    return log->done_msg;
+}
+
+/*!
+\brief Write a buffered log's pending messages to its file
+
+Waits for messages other threads are in the midst of issuing. Does nothing
+for an unbuffered log. Need not be called collectively.
+*/
+void
+MACSIO_LOG_LogFlush(
+    MACSIO_LOG_LogHandle_t const *log /**< [in] The log to flush */
+)
+{
+    unsigned long long upto;
+
+    if (!log || !log->lines) return;
+    upto = __atomic_load_n(&log->next_msg, __ATOMIC_ACQUIRE);
+    while (1)
+    {
+        pthread_mutex_lock((pthread_mutex_t *) &log->flush_lock);
+        if (advance_done(log, upto) >= upto)
+            break;
+        pthread_mutex_unlock((pthread_mutex_t *) &log->flush_lock);
+        sched_yield();
+    }
+    if (log->done_msg > log->flushed_msg)
+        flush_lines(log, log->done_msg);
+    pthread_mutex_unlock((pthread_mutex_t *) &log->flush_lock);
+}
+
+/* Background flusher. Flushes only messages before the first still being
+   formatted so it never waits on, or writes a partial line of, a message
+   being issued, short of the log wrapping around onto lines being written. */
+static void *
+flusher_main(void *arg)
+{
+    MACSIO_LOG_LogHandle_t *log = (MACSIO_LOG_LogHandle_t *) arg;
+    struct timespec ts;
+
+    ts.tv_sec = log->flush_msecs / 1000;
+    ts.tv_nsec = (long) (log->flush_msecs % 1000) * 1000000L;
+    while (!log->stop_flusher)
+    {
+        unsigned long long upto;
+
+        nanosleep(&ts, 0);
+        pthread_mutex_lock(&log->flush_lock);
+        upto = advance_done(log, __atomic_load_n(&log->next_msg, __ATOMIC_ACQUIRE));
+        if (upto > log->flushed_msg)
+            flush_lines(log, upto);
+        pthread_mutex_unlock(&log->flush_lock);
+    }
+    return 0;
+}
+
+/*!
+\brief Buffer a log's messages in memory
+
+Rather than writing each message to the log file as it is issued, messages are
+formatted into an in-memory image of this processor's part of the log file and
+written from there, a few large writes at a time, by \c MACSIO_LOG_LogFlush(),
+by \c MACSIO_LOG_LogFinalize() and, when \c flush_msecs is positive, by a
+background thread every \c flush_msecs milliseconds. The file's layout, and its
+contents once flushed, are identical to those of an unbuffered log. Messages of
+\c Die severity flush the log before aborting.
+
+Issuing messages remains lock-free; each claims its line with an atomic
+increment. Does nothing for the stderr log. Need not be called collectively.
+*/
+void
+MACSIO_LOG_LogBuffer(
+    MACSIO_LOG_LogHandle_t *log, /**< [in] The log to buffer */
+    int flush_msecs              /**< [in] Interval between background flushes or 0 for none */
+)
+{
+    if (!log || log->lines || !log->pathname) return;
+
+    log->lines = (char *) malloc((size_t) log->nlines * log->log_line_length);
+    log->line_done = (unsigned long long *) calloc(log->nlines, sizeof(unsigned long long));
+    if (!log->lines || !log->line_done)
+    {
+        free(log->lines);
+        free(log->line_done);
+        log->lines = 0;
+        log->line_done = 0;
+        return;
+    }
+
+    /* The image must match the file since writes are widened over lines that
+       have not changed. Read it back if messages were already written. */
+    prime_lines(log->lines, log->rank, log->log_line_length, log->nlines);
+    if (log->next_msg)
+    {
+        int fd = open(log->pathname, O_RDONLY);
+        if (fd >= 0)
+        {
+            pread(fd, log->lines, (size_t) log->nlines * log->log_line_length, log->offset);
+            close(fd);
+        }
+    }
+    log->flushed_msg = log->next_msg;
+    log->done_msg = log->next_msg;
+
+    if (flush_msecs > 0)
+    {
+        log->flush_msecs = flush_msecs;
+        log->stop_flusher = 0;
+        if (pthread_create(&log->flusher, 0, flusher_main, log))
+            log->flush_msecs = 0;
+    }
+}
+
 /*!
 \brief Issue a printf-style message to a log
 
-May be called independently by any processor in the communicator used to initialize the log.
+May be called independently by any processor in the communicator used to initialize the log
+and by any number of threads at once. Each message atomically claims its own line so lines
+from different threads interleave but never overwrite each other, short of wrapping around.
 */
 void
 MACSIO_LOG_LogMsg(
@@ -200,57 +433,42 @@ MACSIO_LOG_LogMsg(
     ...                          /**< [in] Optional, variable list of arguments for the format string. */
 )
 {
-    int i = 0;
     int is_stderr = log->logfile == fileno(stderr);
-    char *msg, *buf;
+    int line_len = log->log_line_length;
+    unsigned long long msg = __atomic_fetch_add(&log->next_msg, 1ULL, __ATOMIC_RELAXED);
+    int line = 1 + (int) (msg % (log->nlines - 1)); /* never line '0', the "Processor XXXX" heading */
+    char stkbuf[256], *buf;
     va_list ptr;
 
-    msg = (char *) malloc(log->log_line_length+10);
-    buf = (char *) malloc(log->log_line_length+10);
-
-    if (is_stderr) sprintf(msg, "%06d: ", log->rank);
     va_start(ptr, fmt);
-    vsnprintf(is_stderr?&msg[8]:msg, log->log_line_length-1, fmt, ptr);
-    va_end(ptr);
-    msg[log->log_line_length-1] = '\0';
-
-    while (i < (int) strlen(msg) && i < log->log_line_length)
+    if (log->lines)
     {
-        if (msg[i] == '\n')
-            buf[i] = '!';
-        else
-            buf[i] = msg[i];
-        i++;
-    }
-    free(msg);
-    if (is_stderr)
-    {
-        buf[i++] = '\n';
-        buf[i++] = '\0';
-    }
-    else
-    {
-        while (i < log->log_line_length)
-            buf[i++] = ' ';
-        buf[log->log_line_length-1] = '\n';
+        /* Format in place in the in-memory image of the file */
+        format_line(log->lines + (size_t) line * line_len, line_len, fmt, ptr, 1);
+        va_end(ptr);
+        __atomic_store_n(&log->line_done[line], msg + 1, __ATOMIC_RELEASE);
+        log->flags.was_logged = 1;
+        return;
     }
 
+    buf = line_len + 10 <= (int) sizeof(stkbuf) ? stkbuf : (char *) malloc(line_len + 10);
     if (is_stderr)
     {
-        write(log->logfile, buf, sizeof(char) * strlen(buf));
+        int n;
+        sprintf(buf, "%06d: ", log->rank);
+        n = 8 + format_line(&buf[8], line_len, fmt, ptr, 0);
+        buf[n++] = '\n';
+        write(log->logfile, buf, sizeof(char) * n);
         fflush(stderr); /* can never be sure stderr is UNbuffered */
     }
     else
     {
-        int extra_lines = log->rank?log->extra_lines_proc0:0;
-        off_t seek_offset = (log->rank * log->lines_per_proc + log->current_line + extra_lines) * log->log_line_length;
-        pwrite(log->logfile, buf, sizeof(char) * log->log_line_length, seek_offset);
+        format_line(buf, line_len, fmt, ptr, 1);
+        pwrite(log->logfile, buf, sizeof(char) * line_len, log->offset + (off_t) line * line_len);
     }
-    free(buf);
+    va_end(ptr);
+    if (buf != stkbuf) free(buf);
 
-    log->current_line++;
-    if (log->current_line == log->lines_per_proc + (log->rank==0?log->extra_lines_proc0:0))
-        log->current_line = 1;
     log->flags.was_logged = 1;
 }
 
@@ -295,11 +513,14 @@ MACSIO_LOG_LogMsgWithDetails(
 #endif
     MACSIO_LOG_LogMsg(log, "%s:%s:%s:%s:%s", _sig, _msg, _err, _mpistr, _mpicls);
     if (sevVal == MACSIO_LOG_MsgDie)
+    {
+        MACSIO_LOG_LogFlush(log);
 #ifdef HAVE_MPI
         MPI_Abort(MPI_COMM_WORLD, mpiErrno==MPI_SUCCESS?sysErrno:mpiErrno);
 #else
         exit(sysErrno);
 #endif
+    }
 }
 
 /*!
@@ -314,6 +535,13 @@ MACSIO_LOG_LogFinalize(
     int was_logged = log->flags.was_logged;
     int reduced_was_logged = was_logged;
 
+    if (log->flush_msecs)
+    {
+        log->stop_flusher = 1;
+        pthread_join(log->flusher, 0);
+    }
+    MACSIO_LOG_LogFlush(log);
+
 //#warning ADD ATEXIT FUNCTIONALITY TO CLOSE LOGS
     if (log->logfile != fileno(stderr))
         close(log->logfile);
@@ -327,6 +555,9 @@ MACSIO_LOG_LogFinalize(
         unlink(log->pathname);
 
     if (log->pathname) free(log->pathname);
+    if (log->lines) free(log->lines);
+    if (log->line_done) free(log->line_done);
+    pthread_mutex_destroy(&log->flush_lock);
     free(log);
 }
 
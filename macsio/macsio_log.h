@@ -217,6 +217,8 @@ extern void MACSIO_LOG_LogMsg(MACSIO_LOG_LogHandle_t const *log, char const *fmt
 extern void MACSIO_LOG_LogMsgWithDetails(MACSIO_LOG_LogHandle_t const *log, char const *linemsg,
     MACSIO_LOG_MsgSeverity_t sevVal, char const *sevStr,
     int sysErrno, int mpiErrno, char const *theFile, int theLine);
+extern void MACSIO_LOG_LogBuffer(MACSIO_LOG_LogHandle_t *log, int flush_msecs);
+extern void MACSIO_LOG_LogFlush(MACSIO_LOG_LogHandle_t const *log);
 extern void MACSIO_LOG_LogFinalize(MACSIO_LOG_LogHandle_t *log);
 
 #ifdef __cplusplus
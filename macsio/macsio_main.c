@@ -27,6 +27,7 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 #include <errno.h>
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -55,6 +56,7 @@ extern "C" {
 #include <macsio_iface.h>
 #include <macsio_log.h>
 #include <macsio_main.h>
+#include <macsio_mif.h>
 #include <macsio_timing.h>
 #include <macsio_utils.h>
 #include <macsio_work.h>
@@ -74,17 +76,30 @@ extern "C" {
 
 #define MAX(A,B) (((A)>(B))?(A):(B))
 
+/* Most bytes each task, and all tasks together, write for each file count
+   tried in a MIFOPT calibration. The latter bounds the time the calibration
+   takes at scale, where one file's baton passes through every task. */
+#define MACSIO_MAIN_MIFOPT_MAX_BYTES (16<<20)
+#define MACSIO_MAIN_MIFOPT_MAX_TOTAL_BYTES (1ULL<<30)
+
 extern char **enviornp;
 
 #ifdef HAVE_MPI
 MPI_Comm MACSIO_MAIN_Comm = MPI_COMM_WORLD;
+MPI_Comm MACSIO_MAIN_WorkComm = MPI_COMM_WORLD;
 #else
 int MACSIO_MAIN_Comm = 0;
+int MACSIO_MAIN_WorkComm = 0;
 #endif
 
 int MACSIO_MAIN_Size = 1;
 int MACSIO_MAIN_Rank = 0;
 
+#ifdef HAVE_MPI
+/* MPI thread support level actually provided by MPI_Init_thread */
+static int mpi_thread_level = MPI_THREAD_SINGLE;
+#endif
+
 static void handle_help_request_and_exit(int argi, int argc, char **argv)
 {
     int rank = 0, i, n, *ids=0;;
@@ -185,12 +200,28 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
             "Use 'MIF' for Multiple Independent File (Poor Man's) mode and then\n"
             "also specify the number of files. Or, use 'MIFFPP' for MIF mode and\n"
             "one file per processor or 'MIFOPT' for MIF mode and let the test\n"
-            "determine the optimum file count. Use 'SIF' for SIngle shared File\n"
-            "(Rich Man's) mode. If you also give a file count for SIF mode, then\n"
-            "MACSio will perform a sort of hybrid combination of MIF and SIF modes.\n"
+            "determine the optimum file count by timing short writes, of up to\n"
+            "16 MiB per processor and 1 GiB in all, at 1, 2, 4, ... files and\n"
+            "choosing the count giving the highest bandwidth. Use 'SIF' for\n"
+            "SIngle shared File (Rich Man's) mode. If you also give a file count\n"
+            "for SIF mode, then MACSio will perform a sort of hybrid combination\n"
+            "of MIF and SIF modes.\n"
             "It will produce the specified number of files by grouping ranks in the\n"
             "the same way MIF does, but I/O within each group will be to a single,\n"
             "shared file using SIF mode.",
+        "--mif_grouping %s %d", "contig 0",
+            "Specify how MIF mode groups processors for each file. Use 'contig' to\n"
+            "group contiguous ranges of ranks. Use 'node' to keep groups within the\n"
+            "nodes found with MPI_Comm_split_type and spread them evenly across\n"
+            "nodes so batons are passed between processors on the same node. Then\n"
+            "also specify the number of groups (writers) per node, which overrides\n"
+            "the file count, or 0 to deal the file count round-robin to nodes. Use\n"
+            "'map' for one group per target in the --mif_group_map file, also\n"
+            "overriding the file count.",
+        "--mif_group_map %s", "",
+            "Name of a file of whitespace separated integers, one per MPI rank in\n"
+            "rank order, giving each rank's target, such as the index of the storage\n"
+            "target its group's file should be on, for '--mif_grouping map'.",
         "--avg_num_parts %f", "1",
             "The average number of mesh parts per MPI rank. Non-integral values\n"
             "are acceptable. For example, a value that is half-way between two\n"
@@ -228,7 +259,22 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
         "--part_map %s", MACSIO_CLARGS_NODEFAULT,
             "Specify the name of an ascii file containing part assignments to MPI ranks.\n"
             "The ith line in the file, numbered from 0, holds the MPI rank to which the\n"
-            "ith part is to be assigned. (currently ignored)",
+            "ith part is to be assigned optionally followed by a multiplier for the\n"
+            "size of the part (default 1). Blank lines and lines starting with '#'\n"
+            "are ignored. The number of parts is then the number of lines and\n"
+            "--avg_num_parts is ignored. Ranks may be assigned any number of parts,\n"
+            "including none. Parts are scaled by changing their resolution in x.",
+        "--part_distribution %s", "uniform",
+            "Scale the sizes of parts to model load imbalance among ranks. All parts\n"
+            "on a rank are scaled by the same factor and the total data size is\n"
+            "unchanged. Options are\n"
+            "\tuniform: no scaling\n"
+            "\tzipf[:S]: the kth heaviest rank has weight 1/k^S (default S=1)\n"
+            "\tbimodal[:F[:W]]: a fraction F of ranks, chosen at random, have W times\n"
+            "\t    the weight of the others (default F=0.5, W=10)\n"
+            "\thotspot[:F[:W]]: a contiguous block of a fraction F of ranks have W\n"
+            "\t    times the weight of the others (default F=0.05, W=10)\n"
+            "This may be combined with --part_map.",
         "--vars_per_part %d", "20",
             "Number of mesh variable objects in each part. The smallest this can\n"
             "be depends on the mesh type. For rectilinear mesh it is 1. For\n"
@@ -238,6 +284,16 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
         "--dataset_growth %f", MACSIO_CLARGS_NODEFAULT, 
             "The factor by which the volume of data will grow between dump iterations\n"
             "If no value is given or the value is <1.0 no dataset changes will take place.",
+        "--lazy_vars", "",
+            "Do not hold variable data in memory. Instead, each variable holds a\n"
+            "description of how to generate its data and plugins that support it\n"
+            "generate and write the data a chunk at a time. Memory use is then\n"
+            "bounded by --lazy_chunk_size rather than --part_size. Ignored, with\n"
+            "a warning, for plugins without support for lazy variables.",
+        "--lazy_chunk_size %d", "1M",
+            "Size in bytes of the chunks in which lazy variable data is generated\n"
+            "and written. A following B|K|M|G character indicates 'B'ytes, 'K'ilo-,\n"
+            "'M'ega- or 'G'iga- bytes as for --part_size.",
         "--topology_change_probability %f", "0.0",
             "The probability that the topology of the mesh (e.g. something fundamental\n"
             "about the mesh's structure) will change between dumps. A value of 1.0\n"
@@ -304,6 +360,17 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
             "A rough lower bound on the number of seconds spent doing work between\n"
             "I/O phases. The type of work done is controlled by the --compute_work_intensity input\n"
             "and defaults to Level 1 (basic sleep).\n",
+        "--async_dump", "",
+            "Overlap burst dumps with the compute work that follows them. Each dump\n"
+            "snapshots the dump object and hands the snapshot to a background I/O\n"
+            "thread which drains it through the plugin while the next compute phase\n"
+            "runs. At most one drain is in flight at a time (double buffering) so\n"
+            "a dump blocks only if the previous drain has not yet completed. Both\n"
+            "the visible (blocking) time and the total drain time are timed. This\n"
+            "requires MPI_THREAD_MULTIPLE support and a plugin that does not rely on\n"
+            "non-thread-safe library state shared with the compute phase. It is\n"
+            "ignored with --exercise_scr and with --dataset_growth each drain must\n"
+            "complete before the dataset is evolved.",
         "--debug_level %d", "0",
             "Set debugging level (1, 2 or 3) of log files. Higher numbers mean\n"
             "more frequent and detailed output. A value of zero, the default,\n"
@@ -320,10 +387,41 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
             "for rank 0.",
         "--log_line_length %d", "128",
             "Set log file line length.",
+        "--log_flush_interval %d", "-1",
+            "Buffer log messages in memory rather than writing each one to the\n"
+            "log file as it is issued, which can perturb the I/O being measured at\n"
+            "higher debug levels. Buffered messages are written, in a few large\n"
+            "writes, after each dump and at exit and, if this is positive, also by\n"
+            "a background thread every this many milliseconds. The log file is\n"
+            "the same either way. A negative value, the default, disables buffering.",
         "--timings_file_name %s", "macsio-timings.log",
             "Specify the name of the timings file. Passing an empty string, \"\"\n"
             "will disable the creation of a timings file.",
+        "--trace_file_name %s", "",
+            "Record an event trace of every timer start and stop and write it to\n"
+            "this file in Chrome trace format for viewing with Perfetto\n"
+            "(ui.perfetto.dev) or chrome://tracing. Each rank appears on its own\n"
+            "row, on a common timeline, so baton passing in MIF groups and stalls\n"
+            "in collective I/O can be seen. An empty string, the default, disables\n"
+            "tracing.",
+        "--trace_events %d", "65536",
+            "Maximum number of trace events each rank holds. Once exceeded, the\n"
+            "oldest events are overwritten.",
         MACSIO_CLARGS_ARG_GROUP_END(Log File Options),
+        MACSIO_CLARGS_ARG_GROUP_BEG(Trickle Dump Options, Options to control small frequent dumps between burst dumps),
+        "--trickle_freq %d", "0",
+            "Number of trickle dumps to perform between consecutive burst dumps.\n"
+            "Trickle dumps model the small, frequent time-history and diagnostic\n"
+            "output applications produce between their large, periodic dumps. The\n"
+            "compute phase between burst dumps is divided into this many plus one\n"
+            "equal steps and a trickle dump is done after each step that is not\n"
+            "followed by a burst dump. A value of zero, the default, disables\n"
+            "trickle dumps. The plugin must support trickle dumps.",
+        "--trickle_size %d", "4096",
+            "Size in bytes of each trickle dump on each MPI rank. A following\n"
+            "B|K|M|G character indicates 'B'ytes, 'K'ilo-, 'M'ega- or 'G'iga- bytes\n"
+            "as for --part_size.",
+        MACSIO_CLARGS_ARG_GROUP_END(Trickle Dump Options),
         "--alignment %d", MACSIO_CLARGS_NODEFAULT,
             "Not currently documented",
         "--filebase %s", "macsio",
@@ -335,7 +433,9 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
         "--num_loads %d", MACSIO_CLARGS_NODEFAULT,
             "Number of loads in succession to test.",
         "--no_validate_read", "",
-            "Don't validate data on read.",
+            "Don't validate data on read. Otherwise, arrays read are checksummed\n"
+            "and compared with the CRC-32C checksums stored with each mesh part\n"
+            "when it was generated.",
         "--read_mesh %s", MACSIO_CLARGS_NODEFAULT,
             "Specficify mesh name to read.",
         "--read_vars %s", MACSIO_CLARGS_NODEFAULT,
@@ -378,19 +478,31 @@ static json_object *ProcessCommandLine(int argc, char *argv[], int *plugin_argi)
 }
 
 static void
-write_timings_file(char const *filename)
+write_timings_file(char const *filename, json_object *main_obj)
 {
-    char **timer_strs = 0, **rtimer_strs = 0;
+    char **timer_strs = 0, **rtimer_strs = 0, **tree_strs = 0, **rtree_strs = 0;
     int i, ntimers, maxlen, rntimers = 0, rmaxlen = 0, rdata[3], rdata_out[3];
+    int ntree, tmaxlen, rntree = 0, rtmaxlen = 0;
+    json_object *mifopt_obj = json_object_path_get_object(main_obj, "mifopt");
+    int nmifopt = mifopt_obj ? json_object_array_length(JsonGetObj(mifopt_obj, "file_counts")) : 0;
+    double mif_efficiency, mif_min_efficiency, mif_max_efficiency;
+    int mif_min_group, mif_max_group;
     MACSIO_LOG_LogHandle_t *timing_log;
 
     MACSIO_TIMING_DumpTimersToStrings(MACSIO_TIMING_ALL_GROUPS, &timer_strs, &ntimers, &maxlen);
+    MACSIO_TIMING_DumpTimerTreeToStrings(MACSIO_TIMING_ALL_GROUPS, &tree_strs, &ntree, &tmaxlen);
     MACSIO_TIMING_ReduceTimers(MACSIO_MAIN_Comm, 0);
+    mif_efficiency = MACSIO_MIF_SerializationEfficiency(MACSIO_MAIN_Comm);
+    MACSIO_MIF_GroupSerializationEfficiency(MACSIO_MAIN_Comm, &mif_min_efficiency, &mif_min_group,
+        &mif_max_efficiency, &mif_max_group);
     if (MACSIO_MAIN_Rank == 0)
+    {
         MACSIO_TIMING_DumpReducedTimersToStrings(MACSIO_TIMING_ALL_GROUPS, &rtimer_strs, &rntimers, &rmaxlen);
-    rdata[0] = maxlen > rmaxlen ? maxlen : rmaxlen;
-    rdata[1] = ntimers;
-    rdata[2] = rntimers;
+        MACSIO_TIMING_DumpReducedTimerTreeToStrings(MACSIO_TIMING_ALL_GROUPS, &rtree_strs, &rntree, &rtmaxlen);
+    }
+    rdata[0] = MU_MAX(MU_MAX(maxlen, rmaxlen), MU_MAX(tmaxlen, rtmaxlen));
+    rdata[1] = ntimers + 1 + ntree;
+    rdata[2] = rntimers + 3 + rntree + (mifopt_obj ? nmifopt + 2 : 0);
     memcpy(rdata_out, rdata, sizeof(rdata));
 #ifdef HAVE_MPI
     MPI_Allreduce(rdata, rdata_out, 3, MPI_INT, MPI_MAX, MACSIO_MAIN_Comm);
@@ -408,6 +520,15 @@ write_timings_file(char const *filename)
     }
     free(timer_strs);
 
+    /* and as a call tree */
+    MACSIO_LOG_LogMsg(timing_log, "Timer Tree...");
+    for (i = 0; i < ntree; i++)
+    {
+        MACSIO_LOG_MSGL(timing_log, Info, (tree_strs[i]));
+        free(tree_strs[i]);
+    }
+    free(tree_strs);
+
     /* dump MPI reduced timers */
     if (MACSIO_MAIN_Rank == 0)
     {
@@ -420,19 +541,310 @@ write_timings_file(char const *filename)
             free(rtimer_strs[i]);
         }
         free(rtimer_strs);
+
+        /* time holding files over time waiting for and holding them */
+        MACSIO_LOG_MSGL(timing_log, Info, ("MIF group serialization efficiency: %.4f", mif_efficiency));
+        if (mif_min_group >= 0)
+            MACSIO_LOG_MSGL(timing_log, Info, ("MIF group serialization efficiency by group: "
+                "min %.4f (group %d), max %.4f (group %d)",
+                mif_min_efficiency, mif_min_group, mif_max_efficiency, mif_max_group));
+
+        MACSIO_LOG_LogMsg(timing_log, "Reduced Timer Tree...");
+        for (i = 0; i < rntree; i++)
+        {
+            MACSIO_LOG_MSGL(timing_log, Info, (rtree_strs[i]));
+            free(rtree_strs[i]);
+        }
+        free(rtree_strs);
+
+        /* the same on all tasks */
+        if (mifopt_obj)
+        {
+            MACSIO_LOG_LogMsg(timing_log, "MIFOPT Calibration...");
+            for (i = 0; i < nmifopt; i++)
+            {
+                MACSIO_LOG_MSGL(timing_log, Info, ("%d files: %f seconds",
+                    JsonGetInt(mifopt_obj, "file_counts", i), JsonGetDbl(mifopt_obj, "seconds", i)));
+            }
+            MACSIO_LOG_MSGL(timing_log, Info, ("chose %d files", JsonGetInt(mifopt_obj, "num_files")));
+        }
     }
 
     MACSIO_LOG_LogFinalize(timing_log);
 }
 
+/* Sets how MACSIO_MIF groups processors. Rank 0 reads the group map. */
+static void
+setup_mif_grouping(json_object *clargs_obj)
+{
+    char const *grouping = JsonGetStr(clargs_obj, "mif_grouping", 0);
+
+    if (!strcmp(grouping, "node"))
+    {
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_NODE, JsonGetInt(clargs_obj, "mif_grouping", 1),
+            0, MACSIO_MAIN_Comm);
+    }
+    else if (!strcmp(grouping, "map"))
+    {
+        char const *mapFile = JsonGetStr(clargs_obj, "mif_group_map");
+        int *targets = (int *) malloc(MACSIO_MAIN_Size * sizeof(int));
+        int ntargets = 0;
+
+        if (MACSIO_MAIN_Rank == 0)
+        {
+            FILE *mapf = fopen(mapFile, "r");
+            if (mapf)
+            {
+                while (ntargets < MACSIO_MAIN_Size && fscanf(mapf, "%d", &targets[ntargets]) == 1)
+                    ntargets++;
+                fclose(mapf);
+            }
+        }
+#ifdef HAVE_MPI
+        MPI_Bcast(&ntargets, 1, MPI_INT, 0, MACSIO_MAIN_Comm);
+        MPI_Bcast(targets, ntargets, MPI_INT, 0, MACSIO_MAIN_Comm);
+#endif
+        if (ntargets < MACSIO_MAIN_Size)
+            MACSIO_LOG_MSG(Die, ("--mif_group_map \"%s\" gives targets for %d of %d ranks",
+                mapFile, ntargets, MACSIO_MAIN_Size));
+
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_MAP, 0, targets, MACSIO_MAIN_Comm);
+        free(targets);
+    }
+    else if (strcmp(grouping, "contig"))
+    {
+        MACSIO_LOG_MSG(Warn, ("unknown --mif_grouping \"%s\", using contig", grouping));
+    }
+}
+
+/* Resolves the MIFFPP and MIFOPT (or MIFAUTO) parallel file modes to MIF with
+   a file count so plugins see only MIF and SIF. For MIFOPT, times writing up to
+   MACSIO_MAIN_MIFOPT_MAX_BYTES of this task's nbytes, and no more than
+   MACSIO_MAIN_MIFOPT_MAX_TOTAL_BYTES over all tasks, at 1, 2, 4, ... files and
+   the task count and chooses the count giving the highest bandwidth, the fewer
+   files on ties. The measurements are kept in main_obj under "mifopt". The file
+   count is that of the groups MACSIO_MIF will form, which some groupings fix. */
+static void
+resolve_file_count(json_object *main_obj, unsigned long long nbytes)
+{
+    json_object *parfmode_obj = json_object_path_get_array(main_obj, "clargs/parallel_file_mode");
+    char const *modestr = JsonGetStr(main_obj, "clargs/parallel_file_mode", 0);
+    char const *grouping = JsonGetStr(main_obj, "clargs/mif_grouping", 0);
+    int fixedCount = !strcmp(grouping, "map") ||
+        (!strcmp(grouping, "node") && JsonGetInt(main_obj, "clargs/mif_grouping", 1) > 0);
+    int numFiles = MACSIO_MAIN_Size;
+
+    if (!parfmode_obj || !modestr || !strcmp(modestr, "SIF"))
+        return;
+
+    if (fixedCount)
+    {
+        if (strcmp(modestr, "MIF"))
+            MACSIO_LOG_MSG(Warn, ("--mif_grouping %s fixes the file count, ignoring %s", grouping, modestr));
+        numFiles = MACSIO_MIF_GroupCount(numFiles);
+    }
+    else if (!strcmp(modestr, "MIF"))
+    {
+        numFiles = MACSIO_MIF_GroupCount(JsonGetInt(main_obj, "clargs/parallel_file_mode", 1));
+    }
+    else if (!strcmp(modestr, "MIFOPT") || !strcmp(modestr, "MIFAUTO"))
+    {
+        MACSIO_TIMING_GroupMask_t mifopt_grp = MACSIO_TIMING_GroupMask("MIFOPT calibration");
+        json_object *mifopt_obj = json_object_new_object();
+        json_object *counts_arr = json_object_new_array();
+        json_object *secs_arr = json_object_new_array();
+        unsigned long long maxBytes = MACSIO_MAIN_MIFOPT_MAX_TOTAL_BYTES / MACSIO_MAIN_Size;
+        unsigned long long totBytes;
+        double bestBW = -1;
+        size_t len;
+        char *buf;
+        int n;
+
+        if (maxBytes > MACSIO_MAIN_MIFOPT_MAX_BYTES)
+            maxBytes = MACSIO_MAIN_MIFOPT_MAX_BYTES;
+        len = (size_t) (nbytes < maxBytes ? nbytes : maxBytes);
+        totBytes = len;
+        buf = (char *) malloc(len + 1);
+        memset(buf, 'x', len);
+#ifdef HAVE_MPI
+        MPI_Allreduce(MPI_IN_PLACE, &totBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MACSIO_MAIN_Comm);
+#endif
+
+        for (n = 1; n <= MACSIO_MAIN_Size;
+             n = n < MACSIO_MAIN_Size && 2 * n > MACSIO_MAIN_Size ? MACSIO_MAIN_Size : 2 * n)
+        {
+            char nbytes_str[32], seconds_str[32], bandwidth_str[32];
+            MACSIO_TIMING_TimerId_t calib_tid = MT_StartTimer("MIFOPT calibration", mifopt_grp, n);
+            double dt = MACSIO_MIF_TimeFileCount(n, MACSIO_MAIN_Comm, 5,
+                JsonGetStr(main_obj, "clargs/filebase"), buf, len);
+            double bw = dt > 0 ? totBytes / dt : 0;
+            MT_StopTimer(calib_tid);
+
+            MACSIO_LOG_MSG(Info, ("MIFOPT %d files: %s/%s = %s", n,
+                MU_PrByts(totBytes, 0, nbytes_str, sizeof(nbytes_str)),
+                MU_PrSecs(dt, 0, seconds_str, sizeof(seconds_str)),
+                MU_PrBW(totBytes, dt, 0, bandwidth_str, sizeof(bandwidth_str))));
+            json_object_array_add(counts_arr, json_object_new_int(n));
+            json_object_array_add(secs_arr, json_object_new_double(dt));
+            if (bw > bestBW)
+            {
+                bestBW = bw;
+                numFiles = n;
+            }
+        }
+        free(buf);
+
+        json_object_object_add(mifopt_obj, "file_counts", counts_arr);
+        json_object_object_add(mifopt_obj, "seconds", secs_arr);
+        json_object_object_add(mifopt_obj, "num_files", json_object_new_int(numFiles));
+        json_object_object_add(main_obj, "mifopt", mifopt_obj);
+        MACSIO_LOG_MSG(Info, ("MIFOPT chose %d files", numFiles));
+    }
+    else if (strcmp(modestr, "MIFFPP") && strcmp(modestr, "MIFMAX"))
+    {
+        return;
+    }
+
+    json_object_array_put_idx(parfmode_obj, 0, json_object_new_string("MIF"));
+    json_object_array_put_idx(parfmode_obj, 1, json_object_new_int(numFiles));
+}
+
+/* Bytes this task wrote in a dump; what the plugin accounted for when it does
+   so, otherwise an even share of the total size of the dump's files. Collective. */
+static unsigned long long
+dump_file_bytes(int dumpNum)
+{
+    MACSIO_UTILS_ByteCounts_t counts;
+    int accounted = MACSIO_UTILS_GetAccountedBytes(dumpNum, MACSIO_UTILS_BURST_PHASE, &counts);
+    int any_accounted = accounted;
+
+#ifdef HAVE_MPI
+    /* tasks with nothing to write may account for nothing */
+    MPI_Allreduce(&accounted, &any_accounted, 1, MPI_INT, MPI_MAX, MACSIO_MAIN_Comm);
+#endif
+    if (any_accounted)
+        return counts.stored;
+    return MACSIO_UTILS_StatFiles(MACSIO_MAIN_Comm, dumpNum) / MACSIO_MAIN_Size;
+}
+
+/* Logs a dump's bandwidth and returns the bytes it is based on: those the
+   plugin accounted for writing or, for plugins that do not, nbytes */
+static unsigned long long
+log_dump_bandwidth(int dumpNum, unsigned long long nbytes, double dt)
+{
+    char nbytes_str[32], seconds_str[32], bandwidth_str[32];
+    char raw_str[32], meta_str[32];
+    MACSIO_UTILS_ByteCounts_t counts;
+
+    if (!MACSIO_UTILS_GetAccountedBytes(dumpNum, MACSIO_UTILS_BURST_PHASE, &counts))
+    {
+        /* THE VOLUME OF DATA WRITTEN TO FILE =/= SIZE OF JSON PROBLEM OBJECT */
+        MACSIO_LOG_MSG(Info, ("Dump %02d BW: %s/%s = %s (problem size; plugin does not account bytes)", dumpNum,
+                MU_PrByts(nbytes, 0, nbytes_str, sizeof(nbytes_str)),
+                MU_PrSecs(dt, 0, seconds_str, sizeof(seconds_str)),
+                MU_PrBW(nbytes, dt, 0, bandwidth_str, sizeof(bandwidth_str))));
+        return nbytes;
+    }
+
+    MACSIO_LOG_MSG(Info, ("Dump %02d BW: %s/%s = %s (raw %s, meta %s)", dumpNum,
+            MU_PrByts(counts.stored, 0, nbytes_str, sizeof(nbytes_str)),
+            MU_PrSecs(dt, 0, seconds_str, sizeof(seconds_str)),
+            MU_PrBW(counts.stored, dt, 0, bandwidth_str, sizeof(bandwidth_str)),
+            MU_PrByts(counts.raw, 0, raw_str, sizeof(raw_str)),
+            MU_PrByts(counts.meta, 0, meta_str, sizeof(meta_str))));
+    return counts.stored;
+}
+
+/* State of the (at most one) dump being drained in the background */
+typedef struct _async_dump_t
+{
+    pthread_t thread;                   /**< background I/O thread */
+    int threaded;                       /**< non-zero if thread was actually created */
+    int active;                         /**< non-zero while a drain is in flight or unaccounted */
+    int argi;                           /**< plugin args passed through to dumpFunc */
+    int argc;
+    char **argv;
+    json_object *snapshot;              /**< private copy of main_obj being drained */
+    MACSIO_IFACE_Handle_t const *iface; /**< plugin doing the drain */
+    int dumpNum;                        /**< dump number of the snapshot */
+    double dumpTime;                    /**< dump time of the snapshot */
+    double drain_dt;                    /**< time the plugin took to drain the snapshot */
+} async_dump_t;
+
+static void *
+async_dump_drain(void *arg)
+{
+    async_dump_t *ad = (async_dump_t *) arg;
+    MACSIO_TIMING_GroupMask_t main_wr_grp = MACSIO_TIMING_GroupMask("main_write");
+    MACSIO_TIMING_TimerId_t drain_tid;
+
+    MACSIO_TIMING_TraceDumpNum = ad->dumpNum; /* this thread's events are of this dump */
+    drain_tid = MT_StartTimer("async dump drain", main_wr_grp, ad->dumpNum);
+
+    (*(ad->iface->dumpFunc))(ad->argi, ad->argc, ad->argv, ad->snapshot, ad->dumpNum, ad->dumpTime);
+    errno = 0;
+
+    ad->drain_dt = MT_StopTimer(drain_tid);
+
+    return 0;
+}
+
+static void
+async_dump_start(async_dump_t *ad, int argi, int argc, char **argv, json_object *main_obj,
+    MACSIO_IFACE_Handle_t const *iface, int dumpNum, double dumpTime)
+{
+    ad->argi = argi;
+    ad->argc = argc;
+    ad->argv = argv;
+    ad->iface = iface;
+    ad->dumpNum = dumpNum;
+    ad->dumpTime = dumpTime;
+    ad->drain_dt = 0;
+
+    /* snapshot so main_obj is free to change while the snapshot drains */
+    ad->snapshot = MACSIO_UTILS_CopyJsonObject(main_obj);
+
+    ad->threaded = !pthread_create(&ad->thread, 0, async_dump_drain, ad);
+    if (!ad->threaded)
+    {
+        MACSIO_LOG_MSG(Warn, ("unable to create async dump thread, dumping synchronously"));
+        async_dump_drain(ad);
+    }
+    ad->active = 1;
+}
+
+/* Blocks until any in-flight drain completes and accounts for it */
+static void
+async_dump_finish(async_dump_t *ad, unsigned long long nbytes,
+    double *dumpTime, unsigned long long *dumpBytes, int *dumpCount)
+{
+    if (!ad->active) return;
+
+    if (ad->threaded)
+        pthread_join(ad->thread, 0);
+    json_object_put(ad->snapshot);
+    ad->snapshot = 0;
+    ad->active = 0;
+#ifdef HAVE_MPI
+    mpi_errno = 0;
+#endif
+
+    *dumpTime += ad->drain_dt;
+    *dumpBytes += log_dump_bandwidth(ad->dumpNum, nbytes, ad->drain_dt);
+    *dumpCount += 1;
+}
+
 static int
 main_write(int argi, int argc, char **argv, json_object *main_obj)
 {
     int rank = 0, dumpNum = 0, dumpCount = 0;
     unsigned long long problem_nbytes, dumpBytes = 0, summedBytes = 0;
+    unsigned long long accountedBytes[3*MACSIO_UTILS_NUM_PHASES] = {0};
+    unsigned long long summedAccountedBytes[3*MACSIO_UTILS_NUM_PHASES];
     char nbytes_str[32], seconds_str[32], bandwidth_str[32];
     double dumpTime = 0;
-    double timer_dt;
+    double visibleTime = 0;
+    double timer_dt = 0;
     double bandwidth, summedBandwidth;
     MACSIO_TIMING_GroupMask_t main_wr_grp = MACSIO_TIMING_GroupMask("main_write");
     double dump_loop_start, dump_loop_end;
@@ -440,18 +852,60 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
     int exercise_scr = JsonGetInt(main_obj, "clargs/exercise_scr");
     int work_intensity = JsonGetInt(main_obj, "clargs/compute_work_intensity");
     double work_dt = json_object_path_get_double(main_obj, "clargs/compute_time");
+    int async_dump = JsonGetInt(main_obj, "clargs/async_dump");
+    int trickle_freq = JsonGetInt(main_obj, "clargs/trickle_freq");
+    int trickle_size = JsonGetInt(main_obj, "clargs/trickle_size");
+    MACSIO_TIMING_GroupMask_t trickle_grp = MACSIO_TIMING_GroupMask("trickle_dump");
+    int trickleNum = 0;
+    unsigned long long trickleBytes = 0;
+    double trickleTime = 0;
+    async_dump_t adump = {0};
 
     /* Sanity check args */
+    if (async_dump && exercise_scr)
+    {
+        MACSIO_LOG_MSG(Warn, ("--async_dump ignored with --exercise_scr"));
+        async_dump = 0;
+    }
+#ifdef HAVE_MPI
+    if (async_dump && mpi_thread_level < MPI_THREAD_MULTIPLE)
+    {
+        MACSIO_LOG_MSG(Warn, ("--async_dump requires MPI_THREAD_MULTIPLE, dumping synchronously"));
+        async_dump = 0;
+    }
+    if (async_dump)
+    {
+        /* keep compute phase communication off the comm the plugins use */
+        MPI_Comm_dup(MACSIO_MAIN_Comm, &MACSIO_MAIN_WorkComm);
+    }
+#endif
+    if (async_dump)
+        MACSIO_TIMING_UseThreadLock = 1;
+
+    if (JsonGetInt(main_obj, "clargs/lazy_vars"))
+    {
+        const MACSIO_IFACE_Handle_t *lazy_iface = MACSIO_IFACE_GetByName(
+            json_object_path_get_string(main_obj, "clargs/interface"));
+        if (!lazy_iface->lazyVarsOK)
+        {
+            MACSIO_LOG_MSG(Warn, ("\"%s\" plugin does not support --lazy_vars, ignoring", lazy_iface->name));
+            json_object_path_set_boolean(main_obj, "clargs/lazy_vars", (json_bool) 0);
+        }
+    }
 
     MACSIO_DATA_MakeRandomTable(100, 10000);
 
     /* Generate a static problem object to dump on each dump */
+    MACSIO_DATA_BuildDecomposition(main_obj, MACSIO_MAIN_Comm);
     json_object *problem_obj = MACSIO_DATA_GenerateTimeZeroDumpObject(main_obj,0);
     problem_nbytes = (unsigned long long) json_object_object_nbytes(problem_obj, JSON_C_FALSE);
+    problem_nbytes += MACSIO_DATA_LazyVarsNbytes(problem_obj); /* as if populated */
 
 ////#warning MAKE JSON OBJECT KEY CASE CONSISTENT
     json_object_object_add(main_obj, "problem", problem_obj);
 
+    resolve_file_count(main_obj, problem_nbytes);
+
     /* Just here for debugging for the moment */
     if (MACSIO_LOG_DebugLevel >= 2)
     {
@@ -481,6 +935,7 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
     double dt;
     double tNextBurstDump;
     double tNextTrickleDump;
+    double step_dt;
     int dataset_evolved = 0;
     float factor = json_object_path_get_double(main_obj, "clargs/dataset_growth");
    
@@ -491,21 +946,44 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
         work_dt = 1;
     }
 
+    const MACSIO_IFACE_Handle_t *trickle_iface = MACSIO_IFACE_GetByName(
+        json_object_path_get_string(main_obj, "clargs/interface"));
+    if (trickle_freq < 0 || (trickle_freq > 0 && !trickle_iface->trickleDumpFunc))
+    {
+        if (trickle_freq > 0)
+            MACSIO_LOG_MSG(Warn, ("\"%s\" plugin does not support trickle dumps", trickle_iface->name));
+        trickle_freq = 0;
+    }
+    else if (trickle_freq > 0 && !strcmp(json_object_path_get_string(main_obj, "clargs/fileext"),""))
+    {
+        /* trickle dumps may precede the first burst dump */
+        json_object_path_set_string(main_obj, "clargs/fileext", trickle_iface->ext);
+    }
+
     dt = work_dt;
     maxT = total_dumps*dt;
-    tNextBurstDump = dt;
     dumpNum = 0;
     t = 0;
+
+    /* Each burst dump interval, dt, is split into trickle_freq+1 steps. Without
+       compute work, time just advances one step per iteration and a burst dump
+       leads each interval. With it, a burst dump follows the interval's last step. */
+    step_dt = dt / (trickle_freq + 1);
+    tNextBurstDump = doWork ? dt : 0;
+    tNextTrickleDump = doWork ? step_dt : 0;
 ////#warning THIS LOOP CURRENTLY JUST DOES A DUMP AFTER EVERY COMPUTE UP TO THE TOTAL NUMBER OF DUMPS. 
     while (t < maxT){
+        int did_burst = 0;
 
         if (doWork){
-            MACSIO_WORK_DoComputeWork(&t, dt, work_intensity);
+            MACSIO_WORK_DoComputeWork(&t, step_dt, work_intensity);
         }
 
-        if (t >= tNextBurstDump || !doWork){
+        /* half-step slop guards against round-off in accumulating t */
+        if (t >= tNextBurstDump - 0.5 * step_dt){
             int scr_need_checkpoint_flag = 1;
             MACSIO_TIMING_TimerId_t heavy_dump_tid;
+            MACSIO_TIMING_TraceDumpNum = dumpNum;
 #ifdef HAVE_SCR
             if (exercise_scr)
             SCR_Need_checkpoint(&scr_need_checkpoint_flag);
@@ -526,20 +1004,36 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
                     SCR_Start_checkpoint();
 #endif
 
-                /* Start dump timer */
-                heavy_dump_tid = MT_StartTimer("heavy dump", main_wr_grp, dumpNum);
+                if (async_dump)
+                {
+                    /* Visible time is only what this thread blocks for: waiting on
+                       the previous drain, if any, and snapshotting this dump. */
+                    heavy_dump_tid = MT_StartTimer("async dump visible", main_wr_grp, dumpNum);
+
+                    async_dump_finish(&adump, problem_nbytes, &dumpTime, &dumpBytes, &dumpCount);
+
+                    async_dump_start(&adump, argi, argc, argv, main_obj, iface, dumpNum, dumpTime);
+
+                    timer_dt = MT_StopTimer(heavy_dump_tid);
+                    visibleTime += timer_dt;
+                }
+                else
+                {
+                    /* Start dump timer */
+                    heavy_dump_tid = MT_StartTimer("heavy dump", main_wr_grp, dumpNum);
 ////#warning REPLACE DUMPN AND DUMPT WITH A STATE TUPLE
-                /* do the dump */
-                //MACSIO_BurstDump(dt);
+                    /* do the dump */
+                    //MACSIO_BurstDump(dt);
 
-                
-                (*(iface->dumpFunc))(argi, argc, argv, main_obj, dumpNum, dumpTime);
+                    (*(iface->dumpFunc))(argi, argc, argv, main_obj, dumpNum, dumpTime);
 #ifdef HAVE_MPI
-                mpi_errno = 0;
+                    mpi_errno = 0;
 #endif
-                errno = 0;
+                    errno = 0;
 
-                timer_dt = MT_StopTimer(heavy_dump_tid);
+                    timer_dt = MT_StopTimer(heavy_dump_tid);
+                    visibleTime += timer_dt;
+                }
 
 #ifdef HAVE_SCR
                 if (exercise_scr)
@@ -547,41 +1041,68 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
 #endif
             }
 
-            /* stop timer */
-            dumpTime += timer_dt;
-            dumpBytes += problem_nbytes;
-            dumpCount += 1;
-
-            /* log dump timing */ // THE VOLUME OF DATA WRITTEN TO FILE =/= SIZE OF JSON PROBLEM OBJECT
-            MACSIO_LOG_MSG(Info, ("Dump %02d BW: %s/%s = %s", dumpNum,
-                    MU_PrByts(problem_nbytes, 0, nbytes_str, sizeof(nbytes_str)),
-                    MU_PrSecs(timer_dt, 0, seconds_str, sizeof(seconds_str)),
-                    MU_PrBW(problem_nbytes, timer_dt, 0, bandwidth_str, sizeof(bandwidth_str))));
-            unsigned long long stat_bytes = MACSIO_UTILS_StatFiles(dumpNum);
-            MACSIO_LOG_MSG(Info, ("Dump %02d Stat BW: %s/%s = %s", dumpNum,
-                    MU_PrByts(stat_bytes, 0, nbytes_str, sizeof(nbytes_str)),
-                    MU_PrSecs(timer_dt, 0, seconds_str, sizeof(seconds_str)),
-                    MU_PrBW(stat_bytes, timer_dt, 0, bandwidth_str, sizeof(bandwidth_str))));
+            if (!async_dump)
+            {
+                /* stop timer */
+                dumpTime += timer_dt;
+                dumpBytes += log_dump_bandwidth(dumpNum, problem_nbytes, timer_dt);
+                dumpCount += 1;
+            }
     
+            /* write out messages buffered during the dump, outside of its timer */
+            MACSIO_LOG_LogFlush(MACSIO_LOG_MainLog);
+
             dumpNum++;
+            did_burst = 1;
             tNextBurstDump += dt;
 
             if (factor > 1.0){
-                unsigned long long prev_bytes = MACSIO_UTILS_StatFiles(dumpNum-1);
+                unsigned long long prev_bytes;
+                async_dump_finish(&adump, problem_nbytes, &dumpTime, &dumpBytes, &dumpCount);
+                prev_bytes = dump_file_bytes(dumpNum-1);
                 int growth_bytes = (prev_bytes*factor) - prev_bytes;
                 if (growth_bytes > 0)
                     MACSIO_DATA_EvolveDataset(main_obj, &dataset_evolved, factor, growth_bytes);
             }
         } /* end of burst dump loop */
 
-        if (t >= tNextTrickleDump){
-        /* MACSIO_TrickleDump(dt); */
+        if (trickle_freq > 0 && t >= tNextTrickleDump - 0.5 * step_dt){
+            if (!did_burst){
+                json_object *trickle_obj = MACSIO_DATA_MakeTrickleObject(trickle_size, trickleNum, t);
+                MACSIO_UTILS_ByteCounts_t prior, counts;
+                MACSIO_UTILS_GetAccountedBytes(dumpNum-1, MACSIO_UTILS_TRICKLE_PHASE, &prior);
+                MACSIO_TIMING_TimerId_t trickle_tid = MT_StartTimer("trickle dump", trickle_grp, trickleNum);
+
+                (*(trickle_iface->trickleDumpFunc))(argi, argc, argv, main_obj, trickle_obj,
+                    dumpNum-1, trickleNum, t);
+#ifdef HAVE_MPI
+                mpi_errno = 0;
+#endif
+                errno = 0;
+
+                trickleTime += MT_StopTimer(trickle_tid);
+                if (MACSIO_UTILS_GetAccountedBytes(dumpNum-1, MACSIO_UTILS_TRICKLE_PHASE, &counts))
+                    trickleBytes += counts.stored - prior.stored;
+                else
+                    trickleBytes += (unsigned long long) json_object_object_nbytes(trickle_obj, JSON_C_FALSE);
+                trickleNum++;
+                json_object_put(trickle_obj);
+            }
+            tNextTrickleDump += step_dt;
         } /*end of trickle dump loop */
 
         /* Increase the timestep if we aren't using the work routine to do so */
-        if (!doWork) t++;
+        if (!doWork) t += step_dt;
     } /* end of timetep loop */
 
+    /* drain whatever is still in flight */
+    if (async_dump)
+    {
+        MACSIO_TIMING_TimerId_t final_tid = MT_StartTimer("async dump final wait", main_wr_grp, dumpNum);
+        async_dump_finish(&adump, problem_nbytes, &dumpTime, &dumpBytes, &dumpCount);
+        visibleTime += MT_StopTimer(final_tid);
+    }
+
     dump_loop_end = MT_Time();
 
     MACSIO_LOG_MSG(Info, ("Overall BW: %s/%s = %s",
@@ -589,6 +1110,41 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
         MU_PrSecs(dumpTime, 0, seconds_str, sizeof(seconds_str)),
         MU_PrBW(dumpBytes, dumpTime, 0, bandwidth_str, sizeof(bandwidth_str))));
 
+    if (trickleNum)
+    {
+        MACSIO_LOG_MSG(Info, ("Trickle BW: %d dumps, %s/%s = %s", trickleNum,
+            MU_PrByts(trickleBytes, 0, nbytes_str, sizeof(nbytes_str)),
+            MU_PrSecs(trickleTime, 0, seconds_str, sizeof(seconds_str)),
+            MU_PrBW(trickleBytes, trickleTime, 0, bandwidth_str, sizeof(bandwidth_str))));
+    }
+
+    if (async_dump)
+    {
+        MACSIO_LOG_MSG(Info, ("Async dump visible time: %s of %s drain time (%.1f%% hidden)",
+            MU_PrSecs(visibleTime, 0, seconds_str, sizeof(seconds_str)),
+            MU_PrSecs(dumpTime, 0, nbytes_str, sizeof(nbytes_str)),
+            dumpTime > 0 ? 100.0 * (1.0 - visibleTime / dumpTime) : 0.0));
+        MACSIO_TIMING_UseThreadLock = 0;
+#ifdef HAVE_MPI
+        MPI_Comm_free(&MACSIO_MAIN_WorkComm);
+        MACSIO_MAIN_WorkComm = MACSIO_MAIN_Comm;
+#endif
+    }
+
+    /* Totals of bytes plugins accounted for, by kind and phase */
+    for (int j = 0; j < total_dumps; j++)
+    {
+        for (int p = 0; p < MACSIO_UTILS_NUM_PHASES; p++)
+        {
+            MACSIO_UTILS_ByteCounts_t counts;
+            if (!MACSIO_UTILS_GetAccountedBytes(j, (MACSIO_UTILS_BytesPhase_t) p, &counts)) continue;
+            accountedBytes[3*p+0] += counts.raw;
+            accountedBytes[3*p+1] += counts.meta;
+            accountedBytes[3*p+2] += counts.stored;
+        }
+    }
+    memcpy(summedAccountedBytes, accountedBytes, sizeof(accountedBytes));
+
     bandwidth = dumpBytes / dumpTime;
     summedBandwidth = bandwidth;
     min_dump_loop_start = dump_loop_start;
@@ -598,6 +1154,8 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
     MPI_Comm_rank(MACSIO_MAIN_Comm, &rank);
     MPI_Reduce(&bandwidth, &summedBandwidth, 1, MPI_DOUBLE, MPI_SUM, 0, MACSIO_MAIN_Comm);
     MPI_Reduce(&dumpBytes, &summedBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MACSIO_MAIN_Comm);
+    MPI_Reduce(accountedBytes, summedAccountedBytes, 3*MACSIO_UTILS_NUM_PHASES,
+        MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MACSIO_MAIN_Comm);
     MPI_Reduce(&dump_loop_start, &min_dump_loop_start, 1, MPI_DOUBLE, MPI_MIN, 0, MACSIO_MAIN_Comm);
     MPI_Reduce(&dump_loop_end, &max_dump_loop_end, 1, MPI_DOUBLE, MPI_MAX, 0, MACSIO_MAIN_Comm);
 #endif
@@ -610,9 +1168,16 @@ main_write(int argi, int argc, char **argv, json_object *main_obj)
             MU_PrByts(summedBytes, 0, nbytes_str, sizeof(nbytes_str)),
             MU_PrSecs(max_dump_loop_end - min_dump_loop_start, 0, seconds_str, sizeof(seconds_str)),
             MU_PrBW(summedBytes, max_dump_loop_end - min_dump_loop_start, 0, bandwidth_str, sizeof(bandwidth_str))));
-    }
-    for (int j=0; j<total_dumps; j++){
-        MACSIO_UTILS_StatFiles(j);
+        for (int p = 0; p < MACSIO_UTILS_NUM_PHASES; p++)
+        {
+            char raw_str[32], meta_str[32];
+            if (!summedAccountedBytes[3*p+2]) continue;
+            MACSIO_LOG_MSG(Info, ("%s Bytes Written: %s (raw %s, meta %s)",
+                p == MACSIO_UTILS_BURST_PHASE ? "Burst" : "Trickle",
+                MU_PrByts(summedAccountedBytes[3*p+2], 0, nbytes_str, sizeof(nbytes_str)),
+                MU_PrByts(summedAccountedBytes[3*p+0], 0, raw_str, sizeof(raw_str)),
+                MU_PrByts(summedAccountedBytes[3*p+1], 0, meta_str, sizeof(meta_str))));
+        }
     }
     MACSIO_UTILS_CleanupFileStore();
 
@@ -637,6 +1202,7 @@ main_read(int argi, int argc, char **argv, json_object *main_obj)
         /* log load start */
 
         /* Start load timer */
+        MACSIO_TIMING_TraceDumpNum = loadNum;
         heavy_load_tid = MT_StartTimer("heavy load", main_rd_grp, loadNum);
 
         /* do the load */
@@ -648,9 +1214,15 @@ main_read(int argi, int argc, char **argv, json_object *main_obj)
 
         /* log load completion */
 
-        /* Validate the data */
-        if (JsonGetBool(main_obj, "clargs/validate_read"))
+        /* Validate the data (timed separately so as not to skew load times) */
+        if (!JsonGetBool(main_obj, "clargs/no_validate_read"))
+        {
+            MACSIO_TIMING_TimerId_t validate_tid = MT_StartTimer("validate read", main_rd_grp, loadNum);
             MACSIO_DATA_ValidateDataRead(data_read_obj);
+            MT_StopTimer(validate_tid);
+        }
+
+        MACSIO_LOG_LogFlush(MACSIO_LOG_MainLog);
     }
 
     /* Just here for debugging for the moment */
@@ -705,7 +1277,7 @@ main(int argc, char *argv[])
     json_object *clargs_obj = 0;
     MACSIO_TIMING_GroupMask_t main_grp;
     MACSIO_TIMING_TimerId_t main_tid;
-    int i, argi, exercise_scr = 0;
+    int i, argi, exercise_scr = 0, async_dump = 0;
     double currtime;
     unsigned ucurrtim;
 
@@ -713,6 +1285,10 @@ main(int argc, char *argv[])
     for (i = 0; i < argc && !exercise_scr; i++)
         exercise_scr = !strcmp("exercise_scr", argv[i]);
 
+    /* quick pre-scan for async dump cl flag; it needs threaded MPI */
+    for (i = 0; i < argc && !async_dump; i++)
+        async_dump = !strcmp("--async_dump", argv[i]);
+
 #ifdef HAVE_CALIPER
 #ifdef HAVE_MPI
     /* Ensures Caliper's MPI runtime lib is loaded */
@@ -723,7 +1299,10 @@ main(int argc, char *argv[])
 
 ////#warning SHOULD WE BE USING MPI-3 API
 #ifdef HAVE_MPI
-    MPI_Init(&argc, &argv);
+    if (async_dump)
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &mpi_thread_level);
+    else
+        MPI_Init(&argc, &argv);
 #ifdef HAVE_SCR
 ////#warning SANITY CHECK WITH MIFFPP
     if (exercise_scr)
@@ -731,6 +1310,7 @@ main(int argc, char *argv[])
 #endif
     MPI_Comm_dup(MPI_COMM_WORLD, &MACSIO_MAIN_Comm);
     MPI_Comm_set_errhandler(MACSIO_MAIN_Comm, MPI_ERRORS_RETURN);
+    MACSIO_MAIN_WorkComm = MACSIO_MAIN_Comm;
     MPI_Comm_size(MACSIO_MAIN_Comm, &MACSIO_MAIN_Size);
     MPI_Comm_rank(MACSIO_MAIN_Comm, &MACSIO_MAIN_Rank);
     mpi_errno = MPI_SUCCESS;
@@ -759,10 +1339,17 @@ main(int argc, char *argv[])
         JsonGetInt(clargs_obj, "log_line_length"),
         JsonGetInt(clargs_obj, "log_line_cnt/0"),
         JsonGetInt(clargs_obj, "log_line_cnt/1"));
+    if (JsonGetInt(clargs_obj, "log_flush_interval") >= 0)
+        MACSIO_LOG_LogBuffer(MACSIO_LOG_MainLog, JsonGetInt(clargs_obj, "log_flush_interval"));
 
 ////#warning THESE INITIALIZATIONS SHOULD BE IN MACSIO_LOG
     MACSIO_LOG_DebugLevel = JsonGetInt(clargs_obj, "debug_level");
 
+    setup_mif_grouping(clargs_obj);
+
+    if (strlen(JsonGetStr(clargs_obj, "trace_file_name")))
+        MACSIO_TIMING_TraceStart(MACSIO_MAIN_Comm, JsonGetInt(clargs_obj, "trace_events"));
+
     /* Setup parallel information */
     json_object_object_add(parallel_obj, "mpi_size", json_object_new_int(MACSIO_MAIN_Size));
     json_object_object_add(parallel_obj, "mpi_rank", json_object_new_int(MACSIO_MAIN_Rank));
@@ -783,7 +1370,10 @@ main(int argc, char *argv[])
 
     /* Write timings data file if requested */
     if (strlen(JsonGetStr(clargs_obj, "timings_file_name")))
-        write_timings_file(JsonGetStr(clargs_obj, "timings_file_name"));
+        write_timings_file(JsonGetStr(clargs_obj, "timings_file_name"), main_obj);
+
+    if (strlen(JsonGetStr(clargs_obj, "trace_file_name")))
+        MACSIO_TIMING_TraceWrite(MACSIO_MAIN_Comm, JsonGetStr(clargs_obj, "trace_file_name"));
 
     MACSIO_TIMING_ClearTimers(MACSIO_TIMING_ALL_GROUPS);
 
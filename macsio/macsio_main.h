@@ -50,8 +50,10 @@ extern "C" {
 
 #ifdef HAVE_MPI
 extern MPI_Comm MACSIO_MAIN_Comm;
+extern MPI_Comm MACSIO_MAIN_WorkComm;
 #else
 extern int MACSIO_MAIN_Comm;
+extern int MACSIO_MAIN_WorkComm;
 #endif
 extern int MACSIO_MAIN_Size;
 extern int MACSIO_MAIN_Rank;
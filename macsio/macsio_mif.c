@@ -24,7 +24,9 @@ this program; if not, write to the Free Software Foundation, Inc., 59 Temple
 Place, Suite 330, Boston, MA 02111-1307 USA
 */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_SCR
 #ifdef __cplusplus
@@ -37,12 +39,16 @@ extern "C" {
 #endif
 
 #include <macsio_mif.h>
+#include <macsio_timing.h>
 
 #define MACSIO_MIF_BATON_OK  0
 #define MACSIO_MIF_BATON_ERR 1
 #define MACSIO_MIF_MIFMAX -1
 #define MACSIO_MIF_MIFAUTO -2
 
+/* Largest single message in MACSIO_MIF_AggregateWrite; counts are ints */
+#define MACSIO_MIF_AGG_MSG_SIZE (1<<30)
+
 /*! \struct _MACSIO_MIF_baton_t */
 typedef struct _MACSIO_MIF_baton_t
 {
@@ -69,11 +75,262 @@ typedef struct _MACSIO_MIF_baton_t
     MACSIO_MIF_OpenCB openCb;   /**< Open file callback */
     MACSIO_MIF_CloseCB closeCb; /**< Close file callback */
     void *clientData;           /**< Client data to be passed around in calls */
+    int *groupOfRank;           /**< Group of each rank in the MPI comm (0 for contiguous grouping) */
+    int *rankInGroupOfRank;     /**< Rank within its group of each rank in the MPI comm */
+    int *groupMembers;          /**< Ranks, in order, in this processor's group */
+    int numMembers;             /**< Number of ranks in this processor's group */
+    mutable MACSIO_TIMING_TimerId_t holdTid; /**< Timer running while this processor holds the file */
+    unsigned long long batonMsg[2]; /**< Baton value and offset received with the pipeline flag */
+    unsigned long long offset;  /**< Offset passed on with the baton with the pipeline flag */
+#ifdef HAVE_MPI
+    MPI_Request batonReq;       /**< Receive for the baton posted early with the pipeline flag */
+#endif
 } MACSIO_MIF_baton_t;
 
+/* Time this processor has spent waiting for and holding batons */
+static double mif_wait_time = 0;
+static double mif_hold_time = 0;
+
+/* Group of this processor in the last baton of more than one group and the
+   time it has spent waiting for and holding that group's file */
+static int mif_group = -1;
+static double mif_group_wait_time = 0;
+static double mif_group_hold_time = 0;
+
+static void
+add_group_time(MACSIO_MIF_baton_t const *Bat, double wait, double hold)
+{
+    if (Bat->numGroups < 2)
+        return;
+    if (Bat->groupRank != mif_group)
+    {
+        mif_group = Bat->groupRank;
+        mif_group_wait_time = 0;
+        mif_group_hold_time = 0;
+    }
+    mif_group_wait_time += wait;
+    mif_group_hold_time += hold;
+}
+
+/* Label of the baton wait timer of tasks at a rank in group; ranks are bucketed
+   by powers of 2 so the number of timers grows only with the log of group size */
+static void
+wait_label(int rankInGroup, char *label, int len)
+{
+    int lo = 1;
+
+    while (2 * lo <= rankInGroup)
+        lo *= 2;
+    if (lo == 1)
+        snprintf(label, len, "MIF baton wait (rank 1 in group)");
+    else
+        snprintf(label, len, "MIF baton wait (ranks %d-%d in group)", lo, 2 * lo - 1);
+}
+
+/* Grouping set by MACSIO_MIF_SetGrouping() and the node or target of each
+   rank in the comm it was set for */
+static MACSIO_MIF_grouping_t mif_grouping = MACSIO_MIF_GROUP_CONTIG;
+static int mif_writersPerNode = 0;
+static int mif_commSize = 0;
+static int *mif_nodeOfRank = 0;
+static int *mif_targetOfRank = 0;
+
+/* Group of the i'th of n items divided into k contiguous groups, the first n%k one larger */
+static int
+split_index(int i, int n, int k)
+{
+    int size = n / k, split = (n % k) * (size + 1);
+    return i < split ? i / (size + 1) : n % k + (i - split) / size;
+}
+
+static int
+compare_ints(void const *a, void const *b)
+{
+    int ia = *((int const *) a), ib = *((int const *) b);
+    return ia < ib ? -1 : ia > ib;
+}
+
+/* Assigns each rank a group with the grouping set by MACSIO_MIF_SetGrouping
+   and returns the number of groups */
+static int
+assign_groups(
+    int numFiles,
+    int commSize,
+    int *groupOfRank
+)
+{
+    int r, n, numGroups = 0;
+
+    if (mif_grouping == MACSIO_MIF_GROUP_MAP)
+    {
+        /* distinct targets, in order, are the groups */
+        int *targets = (int *) malloc(commSize * sizeof(int));
+        memcpy(targets, mif_targetOfRank, commSize * sizeof(int));
+        qsort(targets, commSize, sizeof(int), compare_ints);
+        for (r = 0; r < commSize; r++)
+        {
+            if (r == 0 || targets[r] != targets[r-1])
+                targets[numGroups++] = targets[r];
+        }
+        for (r = 0; r < commSize; r++)
+        {
+            int *t = (int *) bsearch(&mif_targetOfRank[r], targets, numGroups, sizeof(int), compare_ints);
+            groupOfRank[r] = (int) (t - targets);
+        }
+        free(targets);
+    }
+    else
+    {
+        int nnodes = 0;
+        int *nodeSize, *nodeGroups, *firstGroup, *seen;
+
+        for (r = 0; r < commSize; r++)
+        {
+            if (mif_nodeOfRank[r] >= nnodes)
+                nnodes = mif_nodeOfRank[r] + 1;
+        }
+        nodeSize = (int *) calloc(nnodes, sizeof(int));
+        nodeGroups = (int *) calloc(nnodes, sizeof(int));
+        firstGroup = (int *) calloc(nnodes, sizeof(int));
+        seen = (int *) calloc(nnodes, sizeof(int));
+        for (r = 0; r < commSize; r++)
+            nodeSize[mif_nodeOfRank[r]]++;
+
+        if (mif_writersPerNode > 0 || numFiles >= nnodes)
+        {
+            /* groups are dealt round-robin to nodes with ranks to spare and
+               each node's ranks are divided among its groups */
+            int toDeal = mif_writersPerNode > 0 ? nnodes * mif_writersPerNode : numFiles;
+            int dealt = 1;
+            while (toDeal > 0 && dealt)
+            {
+                dealt = 0;
+                for (n = 0; n < nnodes && toDeal > 0; n++)
+                {
+                    if (nodeGroups[n] < nodeSize[n] &&
+                        (mif_writersPerNode <= 0 || nodeGroups[n] < mif_writersPerNode))
+                    {
+                        nodeGroups[n]++;
+                        toDeal--;
+                        dealt = 1;
+                    }
+                }
+            }
+            for (n = 0; n < nnodes; n++)
+            {
+                firstGroup[n] = numGroups;
+                numGroups += nodeGroups[n];
+            }
+            for (r = 0; r < commSize; r++)
+            {
+                n = mif_nodeOfRank[r];
+                groupOfRank[r] = firstGroup[n] + split_index(seen[n]++, nodeSize[n], nodeGroups[n]);
+            }
+        }
+        else
+        {
+            /* each group spans every numFiles'th node */
+            for (r = 0; r < commSize; r++)
+                groupOfRank[r] = mif_nodeOfRank[r] % numFiles;
+            numGroups = numFiles;
+        }
+
+        free(nodeSize);
+        free(nodeGroups);
+        free(firstGroup);
+        free(seen);
+    }
+
+    return numGroups;
+}
+
+/* True if MACSIO_MIF_Init for a comm of this size uses tables rather than contiguous grouping */
+static int
+use_group_tables(int commSize)
+{
+    return mif_commSize == commSize &&
+           ((mif_grouping == MACSIO_MIF_GROUP_NODE && mif_nodeOfRank) ||
+            (mif_grouping == MACSIO_MIF_GROUP_MAP && mif_targetOfRank));
+}
+
+void
+MACSIO_MIF_SetGrouping(
+    MACSIO_MIF_grouping_t grouping,
+    int writersPerNode,
+    int const *targets,
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm
+#else
+    int      mpiComm
+#endif
+)
+{
+    int r, commSize = 1, rankInComm = 0;
+
+#ifdef HAVE_MPI
+    MPI_Comm_size(mpiComm, &commSize);
+    MPI_Comm_rank(mpiComm, &rankInComm);
+#endif
+
+    free(mif_nodeOfRank);
+    free(mif_targetOfRank);
+    mif_nodeOfRank = 0;
+    mif_targetOfRank = 0;
+    mif_grouping = grouping;
+    mif_writersPerNode = writersPerNode;
+    mif_commSize = commSize;
+
+    if (grouping == MACSIO_MIF_GROUP_MAP && targets)
+    {
+        mif_targetOfRank = (int *) malloc(commSize * sizeof(int));
+        memcpy(mif_targetOfRank, targets, commSize * sizeof(int));
+    }
+    else if (grouping == MACSIO_MIF_GROUP_NODE)
+    {
+        int *leaderOfRank = (int *) malloc(commSize * sizeof(int));
+        int nnodes = 0;
+
+#ifdef HAVE_MPI
+        {
+            /* a node's leader is its lowest rank */
+            MPI_Comm nodeComm;
+            int leader;
+            MPI_Comm_split_type(mpiComm, MPI_COMM_TYPE_SHARED, rankInComm, MPI_INFO_NULL, &nodeComm);
+            MPI_Allreduce(&rankInComm, &leader, 1, MPI_INT, MPI_MIN, nodeComm);
+            MPI_Comm_free(&nodeComm);
+            MPI_Allgather(&leader, 1, MPI_INT, leaderOfRank, 1, MPI_INT, mpiComm);
+        }
+#else
+        leaderOfRank[0] = 0;
+#endif
+
+        /* nodes are numbered in order of their leaders */
+        mif_nodeOfRank = (int *) malloc(commSize * sizeof(int));
+        for (r = 0; r < commSize; r++)
+            mif_nodeOfRank[r] = leaderOfRank[r] == r ? nnodes++ : mif_nodeOfRank[leaderOfRank[r]];
+        free(leaderOfRank);
+    }
+}
+
+int
+MACSIO_MIF_GroupCount(
+    int numFiles
+)
+{
+    int *groupOfRank, numGroups;
+
+    if (!use_group_tables(mif_commSize))
+        return numFiles;
+
+    groupOfRank = (int *) malloc(mif_commSize * sizeof(int));
+    numGroups = assign_groups(numFiles, mif_commSize, groupOfRank);
+    free(groupOfRank);
+
+    return numGroups;
+}
+
 //#warning ENSURE DIFFERENT INSTANCES USE DIFFERENT MPI TAGS
 //#warning ADD A THROTTLE OPTION HERE FOR TOT FILES VS CONCURRENT FILES
-//#warning FOR AUTO MODE, MUST HAVE A CALL TO QUERY FILE COUNT
 MACSIO_MIF_baton_t *
 MACSIO_MIF_Init(
     int numFiles,
@@ -152,6 +409,49 @@ MACSIO_MIF_Init(
     ret->openCb = openCb;
     ret->closeCb = closeCb;
     ret->clientData = clientData;
+    ret->groupOfRank = 0;
+    ret->rankInGroupOfRank = 0;
+    ret->groupMembers = 0;
+    ret->numMembers = 0;
+    ret->holdTid = MACSIO_TIMING_INVALID_TIMER;
+
+    if (use_group_tables(commSize))
+    {
+        int r, *counts;
+
+        ret->groupOfRank = (int *) malloc(commSize * sizeof(int));
+        ret->rankInGroupOfRank = (int *) malloc(commSize * sizeof(int));
+        ret->numGroups = assign_groups(numFiles, commSize, ret->groupOfRank);
+
+        /* ranks within each group are in rank order */
+        counts = (int *) calloc(ret->numGroups, sizeof(int));
+        for (r = 0; r < commSize; r++)
+            ret->rankInGroupOfRank[r] = counts[ret->groupOfRank[r]]++;
+        ret->groupRank = ret->groupOfRank[rankInComm];
+        ret->rankInGroup = ret->rankInGroupOfRank[rankInComm];
+        ret->numMembers = counts[ret->groupRank];
+        ret->groupMembers = (int *) malloc(ret->numMembers * sizeof(int));
+        for (r = 0; r < commSize; r++)
+        {
+            if (ret->groupOfRank[r] == ret->groupRank)
+                ret->groupMembers[ret->rankInGroupOfRank[r]] = r;
+        }
+        free(counts);
+
+        ret->procBeforeMe = ret->rankInGroup > 0 ? ret->groupMembers[ret->rankInGroup - 1] : -1;
+        ret->procAfterMe = ret->rankInGroup < ret->numMembers - 1 ?
+            ret->groupMembers[ret->rankInGroup + 1] : -1;
+    }
+
+    ret->batonMsg[0] = MACSIO_MIF_BATON_OK;
+    ret->batonMsg[1] = 0;
+    ret->offset = 0;
+#ifdef HAVE_MPI
+    ret->batonReq = MPI_REQUEST_NULL;
+    if (ioFlags.pipeline && ret->procBeforeMe != -1)
+        MPI_Irecv(ret->batonMsg, 2, MPI_UNSIGNED_LONG_LONG, ret->procBeforeMe,
+            mpiTag, mpiComm, &ret->batonReq);
+#endif
 
     return ret;
 }
@@ -161,9 +461,57 @@ MACSIO_MIF_Finish(
     MACSIO_MIF_baton_t *bat
 )
 {
+#ifdef HAVE_MPI
+    if (bat->batonReq != MPI_REQUEST_NULL)
+    {
+        MPI_Cancel(&bat->batonReq);
+        MPI_Wait(&bat->batonReq, MPI_STATUS_IGNORE);
+    }
+#endif
+    free(bat->groupOfRank);
+    free(bat->rankInGroupOfRank);
+    free(bat->groupMembers);
     free(bat);
 }
 
+/* Create the group's file, routed through SCR if in use */
+static void *
+create_group_file(
+    MACSIO_MIF_baton_t const *Bat,
+    char const *fname,
+    char const *nsname
+)
+{
+#ifdef HAVE_SCR
+    if (Bat->ioFlags.use_scr)
+    {
+        char scr_filename[SCR_MAX_FILENAME];
+        if (SCR_Route_file(fname, scr_filename) == SCR_SUCCESS)
+            return Bat->createCb(scr_filename, nsname, Bat->clientData);
+    }
+#endif
+    return Bat->createCb(fname, nsname, Bat->clientData);
+}
+
+/* Open the group's file, routed through SCR if in use */
+static void *
+open_group_file(
+    MACSIO_MIF_baton_t const *Bat,
+    char const *fname,
+    char const *nsname
+)
+{
+#ifdef HAVE_SCR
+    if (Bat->ioFlags.use_scr)
+    {
+        char scr_filename[SCR_MAX_FILENAME];
+        if (SCR_Route_file(fname, scr_filename) == SCR_SUCCESS)
+            return Bat->openCb(scr_filename, nsname, Bat->ioFlags, Bat->clientData);
+    }
+#endif
+    return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
+}
+
 void *
 MACSIO_MIF_WaitForBaton(
     MACSIO_MIF_baton_t *Bat,
@@ -171,84 +519,77 @@ MACSIO_MIF_WaitForBaton(
     char const *nsname
 )
 {
+    MACSIO_TIMING_GroupMask_t mif_grp = MACSIO_TIMING_GroupMask("MACSIO_MIF");
+    MACSIO_TIMING_TimerId_t tid;
+    void *file;
+
     if (Bat->procBeforeMe != -1)
     {
-        int mpi_err;
+        int mpi_err = 0, baton = MACSIO_MIF_BATON_OK;
+        char label[64];
+        double dt;
+
+        /* with the pipeline flag, open while the tasks before finish */
+        file = 0;
+        if (Bat->ioFlags.pipeline)
+        {
+            tid = MT_StartTimer("MIF open", mif_grp, MACSIO_TIMING_ITER_AUTO);
+            file = open_group_file(Bat, fname, nsname);
+            MT_StopTimer(tid);
+        }
+
+        wait_label(Bat->rankInGroup, label, sizeof(label));
+        tid = MT_StartTimer(label, mif_grp, MACSIO_TIMING_ITER_AUTO);
 #ifdef HAVE_MPI
-        MPI_Status mpi_stat;
-        int baton;
-        mpi_err = MPI_Recv(&baton, 1, MPI_INT, Bat->procBeforeMe,
-                           Bat->mpiTag, Bat->mpiComm, &mpi_stat);
-        if (mpi_err == MPI_SUCCESS && baton != MACSIO_MIF_BATON_ERR)
-#else
-        if (1)
-#endif
+        if (Bat->ioFlags.pipeline)
         {
-            if (Bat->ioFlags.use_scr)
-            {
-#ifdef HAVE_SCR
-                char scr_filename[SCR_MAX_FILENAME];
-                if (SCR_Route_file(fname, scr_filename) == SCR_SUCCESS)
-                    return Bat->openCb(scr_filename, nsname, Bat->ioFlags, Bat->clientData);
-                else
-                    return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-#else
-                return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-#endif
-            }
-            else
-            {
-                return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-            }
+            mpi_err = MPI_Wait(&Bat->batonReq, MPI_STATUS_IGNORE);
+            baton = (int) Bat->batonMsg[0];
+            Bat->offset = Bat->batonMsg[1];
         }
         else
         {
+            MPI_Status mpi_stat;
+            mpi_err = MPI_Recv(&baton, 1, MPI_INT, Bat->procBeforeMe,
+                               Bat->mpiTag, Bat->mpiComm, &mpi_stat);
+        }
+#endif
+        dt = MT_StopTimer(tid);
+        mif_wait_time += dt;
+        add_group_time(Bat, dt, 0);
+        if (mpi_err || baton == MACSIO_MIF_BATON_ERR)
+        {
+            if (file)
+                Bat->closeCb(file, Bat->clientData);
             Bat->mifErr = MACSIO_MIF_BATON_ERR;
             Bat->mpiErr = mpi_err;
             return 0;
         }
+
+        if (Bat->ioFlags.pipeline)
+        {
+            Bat->holdTid = MT_StartTimer("MIF file hold", mif_grp, MACSIO_TIMING_ITER_AUTO);
+            return file;
+        }
+        tid = MT_StartTimer("MIF open", mif_grp, MACSIO_TIMING_ITER_AUTO);
+        file = open_group_file(Bat, fname, nsname);
+    }
+    else if (Bat->ioFlags.do_wr)
+    {
+        tid = MT_StartTimer("MIF create", mif_grp, MACSIO_TIMING_ITER_AUTO);
+        file = create_group_file(Bat, fname, nsname);
     }
     else
     {
-        if (Bat->ioFlags.do_wr)
-        {
-            if (Bat->ioFlags.use_scr)
-            {
-#ifdef HAVE_SCR
-                char scr_filename[SCR_MAX_FILENAME];
-                if (SCR_Route_file(fname, scr_filename) == SCR_SUCCESS)
-                    return Bat->createCb(scr_filename, nsname, Bat->clientData);
-                else
-                    return Bat->createCb(fname, nsname, Bat->clientData);
-#else
-                return Bat->createCb(fname, nsname, Bat->clientData);
-#endif
-            }
-            else
-            {
-                return Bat->createCb(fname, nsname, Bat->clientData);
-            }
-        }
-        else
-        {
-            if (Bat->ioFlags.use_scr)
-            {
-#ifdef HAVE_SCR
-                char scr_filename[SCR_MAX_FILENAME];
-                if (SCR_Route_file(fname, scr_filename) == SCR_SUCCESS)
-                    return Bat->openCb(scr_filename, nsname, Bat->ioFlags, Bat->clientData);
-                else
-                    return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-#else
-                return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-#endif
-            }
-            else
-            {
-                return Bat->openCb(fname, nsname, Bat->ioFlags, Bat->clientData);
-            }
-        }
+        tid = MT_StartTimer("MIF open", mif_grp, MACSIO_TIMING_ITER_AUTO);
+        file = open_group_file(Bat, fname, nsname);
     }
+    MT_StopTimer(tid);
+
+    /* stopped when the baton is handed off */
+    Bat->holdTid = MT_StartTimer("MIF file hold", mif_grp, MACSIO_TIMING_ITER_AUTO);
+
+    return file;
 }
 
 int
@@ -257,14 +598,40 @@ MACSIO_MIF_HandOffBaton(
     void *file
 )
 {
-    int retval = Bat->closeCb(file, Bat->clientData);
+    MACSIO_TIMING_GroupMask_t mif_grp = MACSIO_TIMING_GroupMask("MACSIO_MIF");
+    MACSIO_TIMING_TimerId_t tid;
+    int retval;
+
+    if (Bat->holdTid != MACSIO_TIMING_INVALID_TIMER)
+    {
+        double dt = MT_StopTimer(Bat->holdTid);
+        mif_hold_time += dt;
+        add_group_time(Bat, 0, dt);
+    }
+    Bat->holdTid = MACSIO_TIMING_INVALID_TIMER;
+
+    tid = MT_StartTimer("MIF close", mif_grp, MACSIO_TIMING_ITER_AUTO);
+    retval = Bat->closeCb(file, Bat->clientData);
+    MT_StopTimer(tid);
+
     if (Bat->procAfterMe != -1)
     {
         int mpi_err;
+        tid = MT_StartTimer("MIF baton handoff", mif_grp, MACSIO_TIMING_ITER_AUTO);
 #ifdef HAVE_MPI
-        int baton = Bat->mifErr;
-        mpi_err = MPI_Ssend(&baton, 1, MPI_INT, Bat->procAfterMe,
-                            Bat->mpiTag, Bat->mpiComm);
+        if (Bat->ioFlags.pipeline)
+        {
+            /* the receive is already posted so there is no need to synchronize */
+            unsigned long long msg[2] = {(unsigned long long) Bat->mifErr, Bat->offset};
+            mpi_err = MPI_Send(msg, 2, MPI_UNSIGNED_LONG_LONG, Bat->procAfterMe,
+                               Bat->mpiTag, Bat->mpiComm);
+        }
+        else
+        {
+            int baton = Bat->mifErr;
+            mpi_err = MPI_Ssend(&baton, 1, MPI_INT, Bat->procAfterMe,
+                                Bat->mpiTag, Bat->mpiComm);
+        }
         if (mpi_err != MPI_SUCCESS)
 #else
         if (0)
@@ -273,7 +640,177 @@ MACSIO_MIF_HandOffBaton(
             Bat->mifErr = MACSIO_MIF_BATON_ERR;
             Bat->mpiErr = mpi_err;
         }
+        MT_StopTimer(tid);
+    }
+    return retval;
+}
+
+unsigned long long
+MACSIO_MIF_BatonOffset(
+    MACSIO_MIF_baton_t const *Bat
+)
+{
+    return Bat->batonMsg[1];
+}
+
+void
+MACSIO_MIF_SetBatonOffset(
+    MACSIO_MIF_baton_t *Bat,
+    unsigned long long offset
+)
+{
+    Bat->offset = offset;
+}
+
+/* Number of tasks in the group of this processor */
+static int
+group_size(
+    MACSIO_MIF_baton_t const *Bat
+)
+{
+    if (Bat->groupMembers)
+        return Bat->numMembers;
+    return Bat->rankInComm < Bat->commSplit ? Bat->groupSize + 1 : Bat->groupSize;
+}
+
+/* Rank in the MPI comm of the i'th task in the group of this processor */
+static int
+group_member(
+    MACSIO_MIF_baton_t const *Bat,
+    int i
+)
+{
+    if (Bat->groupMembers)
+        return Bat->groupMembers[i];
+    return Bat->rankInComm - Bat->rankInGroup + i;
+}
+
+int
+MACSIO_MIF_AggregateWrite(
+    MACSIO_MIF_baton_t *Bat,
+    char const *fname,
+    char const *nsname,
+    void const *buf,
+    size_t len,
+    MACSIO_MIF_WriteCB writeCb
+)
+{
+    int retval = 0;
+
+#ifdef HAVE_MPI
+    if (Bat->rankInGroup > 0)
+    {
+        /* Send the size and then the data, in pieces small enough for an int count,
+           and receive the offset in the file at which the data will be written */
+        int leader = group_member(Bat, 0);
+        int i, nmsgs = (int) ((len + MACSIO_MIF_AGG_MSG_SIZE - 1) / MACSIO_MIF_AGG_MSG_SIZE);
+        unsigned long long nbytes = len;
+        MPI_Request *reqs = (MPI_Request *) malloc((nmsgs + 2) * sizeof(MPI_Request));
+
+        MPI_Irecv(&Bat->batonMsg[1], 1, MPI_UNSIGNED_LONG_LONG, leader, Bat->mpiTag, Bat->mpiComm, &reqs[nmsgs+1]);
+        MPI_Isend(&nbytes, 1, MPI_UNSIGNED_LONG_LONG, leader, Bat->mpiTag, Bat->mpiComm, &reqs[0]);
+        for (i = 0; i < nmsgs; i++)
+        {
+            size_t off = (size_t) i * MACSIO_MIF_AGG_MSG_SIZE;
+            int n = (int) (len - off < MACSIO_MIF_AGG_MSG_SIZE ? len - off : MACSIO_MIF_AGG_MSG_SIZE);
+            MPI_Isend((char *) buf + off, n, MPI_BYTE, leader, Bat->mpiTag, Bat->mpiComm, &reqs[i+1]);
+        }
+        Bat->mpiErr = MPI_Waitall(nmsgs + 2, reqs, MPI_STATUSES_IGNORE);
+        if (Bat->mpiErr != MPI_SUCCESS)
+            Bat->mifErr = MACSIO_MIF_BATON_ERR;
+        free(reqs);
+        return 0;
+    }
+#endif
+
+    {
+        void *file = create_group_file(Bat, fname, nsname);
+        int nmembers = group_size(Bat) - 1;
+
+        Bat->batonMsg[1] = 0;
+        if (!file)
+            Bat->mifErr = MACSIO_MIF_BATON_ERR;
+        if (file && len && writeCb(file, buf, len, Bat->clientData))
+            Bat->mifErr = MACSIO_MIF_BATON_ERR;
+
+#ifdef HAVE_MPI
+        if (nmembers > 0)
+        {
+            unsigned long long *sizes = (unsigned long long *) malloc(nmembers * sizeof(unsigned long long));
+            unsigned long long *offsets = (unsigned long long *) malloc(nmembers * sizeof(unsigned long long));
+            MPI_Request *reqs = (MPI_Request *) malloc(nmembers * sizeof(MPI_Request));
+            MPI_Request *offset_reqs = (MPI_Request *) malloc(nmembers * sizeof(MPI_Request));
+            unsigned long long maxsize = 0, sum = 0, cap;
+            char *aggbuf;
+            int m, first;
+
+            for (m = 0; m < nmembers; m++)
+                MPI_Irecv(&sizes[m], 1, MPI_UNSIGNED_LONG_LONG, group_member(Bat, 1 + m),
+                    Bat->mpiTag, Bat->mpiComm, &reqs[m]);
+            MPI_Waitall(nmembers, reqs, MPI_STATUSES_IGNORE);
+            free(reqs);
+
+            /* Tell each task where its data will be in the file */
+            for (m = 0; m < nmembers; m++)
+            {
+                offsets[m] = len + sum;
+                MPI_Isend(&offsets[m], 1, MPI_UNSIGNED_LONG_LONG, group_member(Bat, 1 + m),
+                    Bat->mpiTag, Bat->mpiComm, &offset_reqs[m]);
+                if (sizes[m] > maxsize) maxsize = sizes[m];
+                sum += sizes[m];
+            }
+            cap = sum < MACSIO_MIF_AGG_BUF_SIZE ? sum : MACSIO_MIF_AGG_BUF_SIZE;
+            if (cap < maxsize) cap = maxsize;
+            aggbuf = (char *) malloc(cap ? cap : 1);
+
+            /* Receive as many tasks' data as fit, in rank order, and write it at once */
+            for (first = 0; first < nmembers;)
+            {
+                unsigned long long total = 0;
+                int last, nreqs = 0;
+
+                for (last = first; last < nmembers && total + sizes[last] <= cap; last++)
+                {
+                    nreqs += (int) ((sizes[last] + MACSIO_MIF_AGG_MSG_SIZE - 1) / MACSIO_MIF_AGG_MSG_SIZE);
+                    total += sizes[last];
+                }
+
+                reqs = (MPI_Request *) malloc((nreqs + 1) * sizeof(MPI_Request));
+                total = 0;
+                nreqs = 0;
+                for (m = first; m < last; m++)
+                {
+                    unsigned long long off;
+                    for (off = 0; off < sizes[m]; off += MACSIO_MIF_AGG_MSG_SIZE)
+                    {
+                        int n = (int) (sizes[m] - off < MACSIO_MIF_AGG_MSG_SIZE ? sizes[m] - off : MACSIO_MIF_AGG_MSG_SIZE);
+                        MPI_Irecv(aggbuf + total + off, n, MPI_BYTE, group_member(Bat, 1 + m),
+                            Bat->mpiTag, Bat->mpiComm, &reqs[nreqs++]);
+                    }
+                    total += sizes[m];
+                }
+                Bat->mpiErr = MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+                free(reqs);
+                if (Bat->mpiErr != MPI_SUCCESS)
+                    Bat->mifErr = MACSIO_MIF_BATON_ERR;
+
+                if (file && total && writeCb(file, aggbuf, (size_t) total, Bat->clientData))
+                    Bat->mifErr = MACSIO_MIF_BATON_ERR;
+                first = last;
+            }
+
+            MPI_Waitall(nmembers, offset_reqs, MPI_STATUSES_IGNORE);
+            free(offset_reqs);
+            free(offsets);
+            free(aggbuf);
+            free(sizes);
+        }
+#endif
+
+        if (file)
+            retval = Bat->closeCb(file, Bat->clientData);
     }
+
     return retval;
 }
 
@@ -285,7 +822,11 @@ MACSIO_MIF_RankOfGroup(
 {
     int retval;
 
-    if (rankInComm < Bat->commSplit)
+    if (Bat->groupOfRank)
+    {
+        retval = Bat->groupOfRank[rankInComm];
+    }
+    else if (rankInComm < Bat->commSplit)
     {
         retval = rankInComm / (Bat->groupSize + 1);
     }
@@ -306,7 +847,11 @@ MACSIO_MIF_RankInGroup(
 {
     int retval;
 
-    if (rankInComm < Bat->commSplit)
+    if (Bat->rankInGroupOfRank)
+    {
+        retval = Bat->rankInGroupOfRank[rankInComm];
+    }
+    else if (rankInComm < Bat->commSplit)
     {
         retval = rankInComm % (Bat->groupSize + 1);
     }
@@ -317,3 +862,134 @@ MACSIO_MIF_RankInGroup(
 
     return retval;
 }
+
+static void *
+calib_create(char const *fname, char const *nsname, void *udata)
+{
+    return (void *) fopen(fname, "w");
+}
+
+static void *
+calib_open(char const *fname, char const *nsname, MACSIO_MIF_ioFlags_t ioFlags, void *udata)
+{
+    return (void *) fopen(fname, "a");
+}
+
+static int
+calib_close(void *file, void *udata)
+{
+    return file ? fclose((FILE *) file) : -1;
+}
+
+double
+MACSIO_MIF_TimeFileCount(
+    int numFiles,
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm,
+#else
+    int      mpiComm,
+#endif
+    int mpiTag,
+    char const *fileBase,
+    void const *buf,
+    size_t len
+)
+{
+    MACSIO_MIF_ioFlags_t ioFlags = {MACSIO_MIF_WRITE, 0, 0};
+    MACSIO_MIF_baton_t *bat = MACSIO_MIF_Init(numFiles, ioFlags, mpiComm, mpiTag,
+        calib_create, calib_open, calib_close, 0);
+    char fname[256];
+    double t0 = 0, dt = 0;
+    double wait_time = mif_wait_time, hold_time = mif_hold_time;
+    int group = mif_group;
+    double group_wait_time = mif_group_wait_time, group_hold_time = mif_group_hold_time;
+    FILE *f;
+
+    snprintf(fname, sizeof(fname), "%s_%05d.mifopt", fileBase,
+        MACSIO_MIF_RankOfGroup(bat, bat->rankInComm));
+
+#ifdef HAVE_MPI
+    MPI_Barrier(mpiComm);
+    t0 = MPI_Wtime();
+#endif
+    f = (FILE *) MACSIO_MIF_WaitForBaton(bat, fname, 0);
+    if (f)
+        fwrite(buf, 1, len, f);
+    MACSIO_MIF_HandOffBaton(bat, f);
+#ifdef HAVE_MPI
+    dt = MPI_Wtime() - t0;
+    MPI_Allreduce(MPI_IN_PLACE, &dt, 1, MPI_DOUBLE, MPI_MAX, mpiComm);
+#endif
+
+    /* all tasks are done with the files once the reduction completes */
+    if (bat->rankInGroup == 0)
+        remove(fname);
+    MACSIO_MIF_Finish(bat);
+
+    /* calibrations are not part of the serialization efficiency */
+    mif_wait_time = wait_time;
+    mif_hold_time = hold_time;
+    mif_group = group;
+    mif_group_wait_time = group_wait_time;
+    mif_group_hold_time = group_hold_time;
+
+    return dt;
+}
+
+double
+MACSIO_MIF_SerializationEfficiency(
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm
+#else
+    int      mpiComm
+#endif
+)
+{
+    double times[2] = {mif_wait_time, mif_hold_time};
+
+#ifdef HAVE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_SUM, mpiComm);
+#endif
+
+    return times[0] + times[1] > 0 ? times[1] / (times[0] + times[1]) : 1;
+}
+
+void
+MACSIO_MIF_GroupSerializationEfficiency(
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm,
+#else
+    int      mpiComm,
+#endif
+    double *minEff,
+    int *minGroup,
+    double *maxEff,
+    int *maxGroup
+)
+{
+    struct { double eff; int group; } lo = {2, -1}, hi = {-1, -1};
+
+#ifdef HAVE_MPI
+    MPI_Comm groupComm;
+    double times[2] = {mif_group_wait_time, mif_group_hold_time};
+
+    /* each group's efficiency and then the least and most efficient groups */
+    MPI_Comm_split(mpiComm, mif_group < 0 ? MPI_UNDEFINED : mif_group, 0, &groupComm);
+    if (groupComm != MPI_COMM_NULL)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_SUM, groupComm);
+        MPI_Comm_free(&groupComm);
+        lo.eff = hi.eff = times[0] + times[1] > 0 ? times[1] / (times[0] + times[1]) : 1;
+        lo.group = hi.group = mif_group;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &lo, 1, MPI_DOUBLE_INT, MPI_MINLOC, mpiComm);
+    MPI_Allreduce(MPI_IN_PLACE, &hi, 1, MPI_DOUBLE_INT, MPI_MAXLOC, mpiComm);
+#endif
+
+    if (lo.group < 0)
+        lo.eff = hi.eff = 1;
+    if (minEff) *minEff = lo.eff;
+    if (minGroup) *minGroup = lo.group;
+    if (maxEff) *maxEff = hi.eff;
+    if (maxGroup) *maxGroup = hi.group;
+}
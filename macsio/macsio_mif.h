@@ -45,6 +45,9 @@ extern "C" {
 #define MACSIO_MIF_READ  0
 #define MACSIO_MIF_WRITE 1
 
+/*! \brief Bytes of other tasks' data a group's first task holds at a time in \c MACSIO_MIF_AggregateWrite() */
+#define MACSIO_MIF_AGG_BUF_SIZE (1<<28)
+
 /*!
 \brief Bit Field struct for I/O flags
 */
@@ -52,8 +55,19 @@ typedef struct _MACSIO_MIF_ioFlags_t
 {
     unsigned int do_wr : 1;   /**< bit0: 1=write, 0=read */
     unsigned int use_scr : 1; /**< bit1: 1=use SCR, 0=don't use SCR */
+    unsigned int pipeline : 1; /**< bit2: 1=open early and pass offsets with the baton (see \c MACSIO_MIF_WaitForBaton()) */
 } MACSIO_MIF_ioFlags_t;
 
+/*!
+\brief How \c MACSIO_MIF_Init() assigns processors to groups
+*/
+typedef enum _MACSIO_MIF_grouping_t
+{
+    MACSIO_MIF_GROUP_CONTIG = 0, /**< Contiguous ranges of ranks (the default) */
+    MACSIO_MIF_GROUP_NODE,       /**< Groups kept within nodes and spread evenly across them */
+    MACSIO_MIF_GROUP_MAP         /**< One group per target in a user-supplied rank to target map */
+} MACSIO_MIF_grouping_t;
+
 /*!
 \brief Opaque struct holding private implementation of MACSIO_MIF_baton_t
 */
@@ -63,6 +77,7 @@ typedef void *(*MACSIO_MIF_CreateCB)(const char *fname, const char *nsname, void
 typedef void *(*MACSIO_MIF_OpenCB)  (const char *fname, const char *nsname,
                                         MACSIO_MIF_ioFlags_t ioFlags, void *udata);
 typedef int   (*MACSIO_MIF_CloseCB) (void *file, void *udata);
+typedef int   (*MACSIO_MIF_WriteCB) (void *file, void const *buf, size_t len, void *udata);
 
 /*!
 \brief Initialize MACSIO_MIF for a MIF I/O operation
@@ -89,6 +104,11 @@ If there is a remainder, \em R, after dividing the communicator size into
 \c numFiles groups, then the first \em R groups will have one additional
 processor.
 
+That is the default, \c MACSIO_MIF_GROUP_CONTIG, grouping. Other groupings,
+set with \c MACSIO_MIF_SetGrouping(), may produce a different number of groups
+(see \c MACSIO_MIF_GroupCount()). In every grouping, processors within a group
+pass the baton in rank order.
+
 \returns The MACSIO_MIF \em baton object
 */
 extern MACSIO_MIF_baton_t *
@@ -96,9 +116,9 @@ MACSIO_MIF_Init(
     int numFiles,                   /**< [in] Number of resultant files. Note: this is entirely independent of
                                          number of tasks. Typically, this number is chosen to match
                                          the number of independent I/O pathways between the nodes the
-                                         application is executing on and the filesystem. Pass MACSIO_MIF_MAX for
-                                         file-per-processor. Pass MACSIO_MIF_AUTO (currently not supported) to
-                                         request that MACSIO_MIF determine and use an optimum file count. */
+                                         application is executing on and the filesystem. Pass the communicator size for
+                                         file-per-processor. An optimum file count can be found by calibration
+                                         with \c MACSIO_MIF_TimeFileCount(). */
     MACSIO_MIF_ioFlags_t ioFlags,   /**< [in] See \ref MACSIO_MIF_ioFlags_t for meaning of flags. */
 #ifdef HAVE_MPI
     MPI_Comm mpiComm,               /**< [in] The MPI communicator containing all the MPI ranks that will
@@ -114,6 +134,51 @@ MACSIO_MIF_Init(
     void *clientData                /**< [in] Optional, client specific data MACSIO_MIF will pass to callbacks */
 );
 
+/*!
+\brief Set how subsequent \c MACSIO_MIF_Init() calls group processors
+
+With \c MACSIO_MIF_GROUP_NODE, processors are grouped by the node they share
+memory with, found with \c MPI_Comm_split_type(MPI_COMM_TYPE_SHARED), so the
+baton is passed among processors on the same node and each node drives a
+balanced number of files concurrently. If \c writersPerNode is positive, each
+node is divided into that many groups (fewer if it has fewer processors) and
+the \c numFiles argument to \c MACSIO_MIF_Init() is ignored; 1 gives one group
+per node. Otherwise, the \c numFiles groups are dealt round-robin to nodes.
+When there are more groups than nodes, each node's processors are divided
+among its groups. When there are fewer, a group spans every \c numFiles th
+node.
+
+With \c MACSIO_MIF_GROUP_MAP, \c targets gives a target, such as a storage
+target index, for each rank in \c mpiComm. Processors with the same target form
+a group, ordered by target, and \c numFiles is ignored.
+
+All processors in \c mpiComm call this function collectively. Subsequent
+\c MACSIO_MIF_Init() calls with a communicator of a different size use
+\c MACSIO_MIF_GROUP_CONTIG grouping.
+*/
+extern void
+MACSIO_MIF_SetGrouping(
+    MACSIO_MIF_grouping_t grouping, /**< [in] The grouping policy */
+    int writersPerNode,             /**< [in] Groups per node for \c MACSIO_MIF_GROUP_NODE or 0 */
+    int const *targets,             /**< [in] For \c MACSIO_MIF_GROUP_MAP, the target of each rank. Copied. */
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm                /**< [in] The MPI communicator subsequently passed to \c MACSIO_MIF_Init() */
+#else
+    int      mpiComm                /**< [in] Dummy MPI communicator */
+#endif
+);
+
+/*!
+\brief Number of groups \c MACSIO_MIF_Init() will form
+
+\returns The number of groups, and so files, \c MACSIO_MIF_Init() forms when
+passed \c numFiles with the grouping set by \c MACSIO_MIF_SetGrouping().
+*/
+extern int
+MACSIO_MIF_GroupCount(
+    int numFiles /**< [in] The number of files that would be passed to \c MACSIO_MIF_Init() */
+);
+
 /*!
 \brief End a MACSIO_MIF I/O operation and free resources
 */
@@ -129,6 +194,14 @@ collectively. For the first task in each group, this call returns immediately.
 For all others in the group, it blocks, waiting for the task \em before it to
 finish its work on the group's file and call \c MACSIO_MIF_HandOffBaton().
 
+With the \c pipeline I/O flag, tasks after the first post the receive for the
+baton in \c MACSIO_MIF_Init() and call \c openCb \em before waiting for it so
+the open overlaps the work of the tasks before them. \c openCb must then be able
+to open the file before the first task creates it, as opening for append does.
+Tasks should also prepare their data before calling this function so only
+writing it remains once they hold the baton. The baton carries the offset at
+which the task before stopped writing (see \c MACSIO_MIF_BatonOffset()).
+
 \returns A void pointer to whatever data instance the \c createCb or \c openCb
 methods return. The caller must cast this returned pointer to the correct type.
 
@@ -155,6 +228,117 @@ MACSIO_MIF_HandOffBaton(
     void *file                     /**< [in] A void pointer to the group's file handle */
 );
 
+/*!
+\brief Offset passed with the baton
+
+With the \c pipeline I/O flag, the offset in the group's file at which the task
+before this one stopped writing, as it set with \c MACSIO_MIF_SetBatonOffset(),
+so this task can write there without seeking to the end of the file. After
+\c MACSIO_MIF_AggregateWrite(), the offset at which this task's data was written.
+
+\returns The offset. 0 on the first task in each group or otherwise.
+*/
+extern unsigned long long
+MACSIO_MIF_BatonOffset(
+    MACSIO_MIF_baton_t const *Bat /**< [in] The MACSIO_MIF baton handle */
+);
+
+/*!
+\brief Set the offset to pass with the baton
+
+With the \c pipeline I/O flag, sets the offset \c MACSIO_MIF_HandOffBaton() passes
+to the next task in the group; usually where this task stopped writing. If not
+set, the offset received is passed on.
+*/
+extern void
+MACSIO_MIF_SetBatonOffset(
+    MACSIO_MIF_baton_t *Bat,     /**< [in] The MACSIO_MIF baton handle */
+    unsigned long long offset    /**< [in] The offset to pass with the baton */
+);
+
+/*!
+\brief Write a group's file by aggregating its tasks' data at the group's first task
+
+An alternative to \c MACSIO_MIF_WaitForBaton() and \c MACSIO_MIF_HandOffBaton() for
+plugins whose tasks each append their data to a group's file. Rather than opening,
+appending to and closing the file in turn, each task serializes its data to memory,
+\c buf, and calls this function. All tasks in \c mpiComm argument to
+\c MACSIO_MIF_Init() call this function collectively.
+
+Tasks other than the first in each group send their data, with non-blocking sends, to
+the group's first task and return once it has been received. The first task creates
+the file with the \c createCb callback, writes its own data and then its group's data,
+in rank order and in large contiguous requests, with \c writeCb and closes the file
+with the \c closeCb callback. The resulting file is the same as one written by passing
+the baton with each task appending its data in turn.
+
+The first task in each group holds up to \c MACSIO_MIF_AGG_BUF_SIZE bytes of other
+tasks' data at a time. On return, \c MACSIO_MIF_BatonOffset() gives the offset in the
+file at which this task's data was, or will be, written so that tasks can record where
+to find it.
+Do not use it with a baton initialized with the \c pipeline I/O flag.
+
+\returns On the first task of each group, the integer value returned from the
+\c MACSIO_MIF_CloseCB callback. Zero on other tasks.
+*/
+extern int
+MACSIO_MIF_AggregateWrite(
+    MACSIO_MIF_baton_t *Bat,    /**< [in] The MACSIO_MIF baton handle */
+    char const *fname,          /**< [in] The filename */
+    char const *nsname,         /**< [in] The namespace within the file passed to \c createCb */
+    void const *buf,            /**< [in] This task's data */
+    size_t len,                 /**< [in] Number of bytes in \c buf */
+    MACSIO_MIF_WriteCB writeCb  /**< [in] Callback to append bytes to the group's file. Returns zero on success. */
+);
+
+/*!
+\brief Fraction of baton time tasks spent holding rather than waiting for files
+
+Over all \c MACSIO_MIF_WaitForBaton() and \c MACSIO_MIF_HandOffBaton() calls so
+far, excluding calibrations, the time tasks held files divided by the time they
+waited for and held files. For groups of \em S tasks that hold files equally long
+it is 2/(\em S+1), so low values mean groups are too large. Collective.
+
+The time each task spends in each phase, waiting for the baton (by rank in group,
+bucketed by powers of 2), creating, opening, holding and closing the file and
+handing off the baton, is also recorded in timers of the "MACSIO_MIF" group.
+Timings per group are given by \c MACSIO_MIF_GroupSerializationEfficiency().
+
+\returns The efficiency, between 0 and 1, the same on all tasks. 1 if no batons were passed.
+*/
+extern double
+MACSIO_MIF_SerializationEfficiency(
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm /**< [in] The MPI communicator of all tasks to include */
+#else
+    int      mpiComm /**< [in] Dummy MPI communicator */
+#endif
+);
+
+/*!
+\brief Least and most efficient groups' serialization efficiency
+
+The efficiency of \c MACSIO_MIF_SerializationEfficiency() for each group
+separately, over the time tasks have waited for and held files in the group
+they were in for the last baton of more than one group, excluding calibrations.
+Rather than a timer per group, whose number grows with the file count, the groups
+are reduced to the least and most efficient. Collective.
+
+Without batons of more than one group, the efficiencies are 1 and the groups -1.
+*/
+extern void
+MACSIO_MIF_GroupSerializationEfficiency(
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm, /**< [in] The MPI communicator of all tasks to include */
+#else
+    int      mpiComm, /**< [in] Dummy MPI communicator */
+#endif
+    double *minEff,   /**< [out] Efficiency of the least efficient group */
+    int *minGroup,    /**< [out] The least efficient group */
+    double *maxEff,   /**< [out] Efficiency of the most efficient group */
+    int *maxGroup     /**< [out] The most efficient group */
+);
+
 /*!
 \brief Rank of the group in which a given (global) rank exists.
 
@@ -183,6 +367,31 @@ MACSIO_MIF_RankInGroup(
     int rankInComm                 /**< [in] The (global) rank of a task for which it's rank in a group is desired */
 );
 
+/*!
+\brief Time writing files with a given file count
+
+Used to choose a file count by calibration. Each task writes \c len bytes from
+\c buf to its group's file, passing the baton as a plugin would, to files named
+\c fileBase_NNNNN.mifopt which are removed afterwards. All tasks in \c mpiComm
+call this function collectively.
+
+\returns The elapsed time, in seconds, from a common start until the last task
+finished writing, the same on all tasks. Without MPI, zero.
+*/
+extern double
+MACSIO_MIF_TimeFileCount(
+    int numFiles,         /**< [in] The number of files (groups) to time */
+#ifdef HAVE_MPI
+    MPI_Comm mpiComm,     /**< [in] The MPI communicator whose tasks write */
+#else
+    int      mpiComm,     /**< [in] Dummy MPI communicator */
+#endif
+    int mpiTag,           /**< [in] MPI message tag for the baton */
+    char const *fileBase, /**< [in] Base name of the files */
+    void const *buf,      /**< [in] This task's data */
+    size_t len            /**< [in] Number of bytes in \c buf */
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,458 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include <macsio_noise.h>
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MACSIO_NOISE_X86
+#include <immintrin.h>
+#endif
+
+/* 3D simplex noise after Stefan Gustavson's "Simplex noise demystified" with
+   the simplex corner selection done without branches and the lattice
+   gradients chosen by an integer hash instead of a permutation table so that
+   every step maps directly onto vector instructions. The vector variants
+   below are transliterations of simplex3() and must be kept in step with it. */
+
+#define F3 (1.0/3.0)
+#define G3 (1.0/6.0)
+
+/* Corner kernels have squared radius 0.5 so that each corner's contribution
+   falls to zero before the simplex boundary (Gustavson's 0.6 leaves small
+   discontinuities). NSCALE brings the result into [-1,1]. */
+#define NSCALE 76.0
+
+/* Hash multipliers; any odd constants with well mixed bits will do */
+#define HI 0x8da6b343u
+#define HJ 0xd8163841u
+#define HK 0xcb1ab31fu
+#define HM 0x2c1b3c6du
+
+static inline unsigned
+lattice_hash(int i, int j, int k)
+{
+    unsigned h = ((unsigned) i * HI) ^ ((unsigned) j * HJ) ^ ((unsigned) k * HK);
+    h ^= h >> 15;
+    h *= HM;
+    h ^= h >> 12;
+    return h;
+}
+
+/* Ken Perlin's 12 edge gradients (plus 4 repeats) dotted with (x,y,z) */
+static inline double
+grad(unsigned hash, double x, double y, double z)
+{
+    unsigned h = hash & 15;
+    double u = h<8 ? x : y;
+    double v = h<4 ? y : (h&13)==12 ? x : z;
+    return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
+}
+
+static inline double
+corner(unsigned hash, double x, double y, double z)
+{
+    double t = 0.5 - x*x - y*y - z*z;
+    t = t < 0 ? 0 : t;
+    t *= t;
+    return t * t * grad(hash, x, y, z);
+}
+
+/* floor() without a libm call (same result for |x| < 2^31) */
+static inline double
+fast_floor(double x)
+{
+    int i = (int) x;
+    return (double) (x < i ? i - 1 : i);
+}
+
+static double
+simplex3(double x, double y, double z)
+{
+    /* Skew to find simplex cell and unskew back to cell origin */
+    double s = (x+y+z)*F3;
+    double fi = fast_floor(x+s), fj = fast_floor(y+s), fk = fast_floor(z+s);
+    double t = (fi+fj+fk)*G3;
+    double x0 = x-(fi-t), y0 = y-(fj-t), z0 = z-(fk-t);
+    int i = (int) fi, j = (int) fj, k = (int) fk;
+
+    /* Offsets of 2nd and 3rd corners from ordering of x0,y0,z0 */
+    int xy = x0>=y0, xz = x0>=z0, yz = y0>=z0;
+    int i1 = xy&xz,   j1 = (!xy)&yz,   k1 = (!xz)&(!yz);
+    int i2 = xy|xz,   j2 = (!xy)|yz,   k2 = (!xz)|(!yz);
+
+    double n = corner(lattice_hash(i,j,k), x0, y0, z0);
+    n += corner(lattice_hash(i+i1,j+j1,k+k1), x0-i1+G3, y0-j1+G3, z0-k1+G3);
+    n += corner(lattice_hash(i+i2,j+j2,k+k2), x0-i2+2.0*G3, y0-j2+2.0*G3, z0-k2+2.0*G3);
+    n += corner(lattice_hash(i+1,j+1,k+1), x0-1.0+3.0*G3, y0-1.0+3.0*G3, z0-1.0+3.0*G3);
+
+    return NSCALE * n;
+}
+
+static void
+simplex3_row_scalar(double x0, double dx, long long i0, double y, double z, long long n, double *vals)
+{
+    long long i;
+    for (i = 0; i < n; i++)
+        vals[i] = simplex3(x0 + (i0 + i) * dx, y, z);
+}
+
+#ifdef MACSIO_NOISE_X86
+
+/* AVX2: 4 points at a time. Integer lattice work is done in 4x32 bit lanes
+   and widened to 4x64 bit masks for selecting among doubles. */
+
+__attribute__((target("avx2")))
+static inline __m128i
+lattice_hash_avx2(__m128i i, __m128i j, __m128i k)
+{
+    __m128i h = _mm_xor_si128(_mm_xor_si128(
+        _mm_mullo_epi32(i, _mm_set1_epi32((int) HI)),
+        _mm_mullo_epi32(j, _mm_set1_epi32((int) HJ))),
+        _mm_mullo_epi32(k, _mm_set1_epi32((int) HK)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int) HM));
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+widen_mask_avx2(__m128i m)
+{
+    return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(m));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+corner_avx2(__m128i hash, __m256d x, __m256d y, __m256d z)
+{
+    __m256d const sign = _mm256_set1_pd(-0.0);
+    __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    __m256d lt8 = widen_mask_avx2(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    __m256d lt4 = widen_mask_avx2(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m256d h12 = widen_mask_avx2(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+    __m256d b1 = widen_mask_avx2(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m256d b2 = widen_mask_avx2(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    __m256d u = _mm256_blendv_pd(y, x, lt8);
+    __m256d v = _mm256_blendv_pd(_mm256_blendv_pd(z, x, h12), y, lt4);
+    __m256d g = _mm256_add_pd(_mm256_xor_pd(u, _mm256_and_pd(b1, sign)),
+                              _mm256_xor_pd(v, _mm256_and_pd(b2, sign)));
+    __m256d t = _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(_mm256_set1_pd(0.5),
+        _mm256_mul_pd(x, x)), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+    t = _mm256_max_pd(t, _mm256_setzero_pd());
+    t = _mm256_mul_pd(t, t);
+    return _mm256_mul_pd(_mm256_mul_pd(t, t), g);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+simplex3_avx2(__m256d x, __m256d y, __m256d z)
+{
+    __m256d const one = _mm256_set1_pd(1.0);
+    __m256d s = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(x, y), z), _mm256_set1_pd(F3));
+    __m256d fi = _mm256_floor_pd(_mm256_add_pd(x, s));
+    __m256d fj = _mm256_floor_pd(_mm256_add_pd(y, s));
+    __m256d fk = _mm256_floor_pd(_mm256_add_pd(z, s));
+    __m256d t = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(fi, fj), fk), _mm256_set1_pd(G3));
+    __m256d x0 = _mm256_sub_pd(x, _mm256_sub_pd(fi, t));
+    __m256d y0 = _mm256_sub_pd(y, _mm256_sub_pd(fj, t));
+    __m256d z0 = _mm256_sub_pd(z, _mm256_sub_pd(fk, t));
+    __m128i i = _mm256_cvtpd_epi32(fi), j = _mm256_cvtpd_epi32(fj), k = _mm256_cvtpd_epi32(fk);
+
+    __m256d xy = _mm256_cmp_pd(x0, y0, _CMP_GE_OQ);
+    __m256d xz = _mm256_cmp_pd(x0, z0, _CMP_GE_OQ);
+    __m256d yz = _mm256_cmp_pd(y0, z0, _CMP_GE_OQ);
+    __m256d i1 = _mm256_and_pd(_mm256_and_pd(xy, xz), one);
+    __m256d j1 = _mm256_and_pd(_mm256_andnot_pd(xy, yz), one);
+    __m256d k1 = _mm256_andnot_pd(_mm256_or_pd(xz, yz), one);
+    __m256d i2 = _mm256_and_pd(_mm256_or_pd(xy, xz), one);
+    __m256d j2 = _mm256_andnot_pd(_mm256_andnot_pd(yz, xy), one);
+    __m256d k2 = _mm256_andnot_pd(_mm256_and_pd(xz, yz), one);
+
+    __m256d g1 = _mm256_set1_pd(G3), g2 = _mm256_set1_pd(2.0*G3), g3 = _mm256_set1_pd(3.0*G3);
+    __m128i const ione = _mm_set1_epi32(1);
+
+    __m256d n = corner_avx2(lattice_hash_avx2(i, j, k), x0, y0, z0);
+    n = _mm256_add_pd(n, corner_avx2(lattice_hash_avx2(
+            _mm_add_epi32(i, _mm256_cvtpd_epi32(i1)),
+            _mm_add_epi32(j, _mm256_cvtpd_epi32(j1)),
+            _mm_add_epi32(k, _mm256_cvtpd_epi32(k1))),
+        _mm256_add_pd(_mm256_sub_pd(x0, i1), g1),
+        _mm256_add_pd(_mm256_sub_pd(y0, j1), g1),
+        _mm256_add_pd(_mm256_sub_pd(z0, k1), g1)));
+    n = _mm256_add_pd(n, corner_avx2(lattice_hash_avx2(
+            _mm_add_epi32(i, _mm256_cvtpd_epi32(i2)),
+            _mm_add_epi32(j, _mm256_cvtpd_epi32(j2)),
+            _mm_add_epi32(k, _mm256_cvtpd_epi32(k2))),
+        _mm256_add_pd(_mm256_sub_pd(x0, i2), g2),
+        _mm256_add_pd(_mm256_sub_pd(y0, j2), g2),
+        _mm256_add_pd(_mm256_sub_pd(z0, k2), g2)));
+    n = _mm256_add_pd(n, corner_avx2(lattice_hash_avx2(
+            _mm_add_epi32(i, ione), _mm_add_epi32(j, ione), _mm_add_epi32(k, ione)),
+        _mm256_add_pd(_mm256_sub_pd(x0, one), g3),
+        _mm256_add_pd(_mm256_sub_pd(y0, one), g3),
+        _mm256_add_pd(_mm256_sub_pd(z0, one), g3)));
+
+    return _mm256_mul_pd(_mm256_set1_pd(NSCALE), n);
+}
+
+__attribute__((target("avx2")))
+static void
+simplex3_row_avx2(double x0, double dx, long long i0, double y, double z, long long n, double *vals)
+{
+    __m256d const vx0 = _mm256_set1_pd(x0), vdx = _mm256_set1_pd(dx);
+    __m256d const vy = _mm256_set1_pd(y), vz = _mm256_set1_pd(z);
+    __m256d const lane = _mm256_set_pd(3, 2, 1, 0);
+    long long i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d vi = _mm256_add_pd(_mm256_set1_pd((double) (i0 + i)), lane);
+        _mm256_storeu_pd(vals + i, simplex3_avx2(_mm256_add_pd(vx0, _mm256_mul_pd(vi, vdx)), vy, vz));
+    }
+    if (i < n)
+    {
+        /* remainder with a masked store */
+        __m256d vi = _mm256_add_pd(_mm256_set1_pd((double) (i0 + i)), lane);
+        __m256i m = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i), _mm256_set_epi64x(3, 2, 1, 0));
+        _mm256_maskstore_pd(vals + i, m, simplex3_avx2(_mm256_add_pd(vx0, _mm256_mul_pd(vi, vdx)), vy, vz));
+    }
+}
+
+/* AVX-512F: 8 points at a time. Lattice integers are in 8x32 bit lanes
+   (AVX2 instructions) and selections use mask registers. Conversions and
+   max use the zero-masked forms with all lanes set; the unmasked forms pass
+   an undefined source that -Wuninitialized flags. */
+#define ALL8 ((__mmask8) 0xFF)
+
+__attribute__((target("avx512f")))
+static inline __m256i
+lattice_hash_avx512(__m256i i, __m256i j, __m256i k)
+{
+    __m256i h = _mm256_xor_si256(_mm256_xor_si256(
+        _mm256_mullo_epi32(i, _mm256_set1_epi32((int) HI)),
+        _mm256_mullo_epi32(j, _mm256_set1_epi32((int) HJ))),
+        _mm256_mullo_epi32(k, _mm256_set1_epi32((int) HK)));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int) HM));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d
+negate_where_avx512(__m512d v, __mmask8 m)
+{
+    __m512i const sign = _mm512_set1_epi64((long long) 0x8000000000000000ULL);
+    return _mm512_castsi512_pd(_mm512_mask_xor_epi64(_mm512_castpd_si512(v), m,
+        _mm512_castpd_si512(v), sign));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d
+corner_avx512(__m256i hash, __m512d x, __m512d y, __m512d z)
+{
+    __m512i h = _mm512_maskz_cvtepu32_epi64(ALL8, _mm256_and_si256(hash, _mm256_set1_epi32(15)));
+    __mmask8 lt8 = _mm512_cmplt_epi64_mask(h, _mm512_set1_epi64(8));
+    __mmask8 lt4 = _mm512_cmplt_epi64_mask(h, _mm512_set1_epi64(4));
+    __mmask8 h12 = _mm512_cmpeq_epi64_mask(_mm512_and_si512(h, _mm512_set1_epi64(13)), _mm512_set1_epi64(12));
+    __mmask8 b1 = _mm512_test_epi64_mask(h, _mm512_set1_epi64(1));
+    __mmask8 b2 = _mm512_test_epi64_mask(h, _mm512_set1_epi64(2));
+    __m512d u = _mm512_mask_blend_pd(lt8, y, x);
+    __m512d v = _mm512_mask_blend_pd(lt4, _mm512_mask_blend_pd(h12, z, x), y);
+    __m512d g = _mm512_add_pd(negate_where_avx512(u, b1), negate_where_avx512(v, b2));
+    __m512d t = _mm512_sub_pd(_mm512_sub_pd(_mm512_sub_pd(_mm512_set1_pd(0.5),
+        _mm512_mul_pd(x, x)), _mm512_mul_pd(y, y)), _mm512_mul_pd(z, z));
+    t = _mm512_maskz_max_pd(ALL8, t, _mm512_setzero_pd());
+    t = _mm512_mul_pd(t, t);
+    return _mm512_mul_pd(_mm512_mul_pd(t, t), g);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d
+simplex3_avx512(__m512d x, __m512d y, __m512d z)
+{
+    __m512d const one = _mm512_set1_pd(1.0);
+    __m512d s = _mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(x, y), z), _mm512_set1_pd(F3));
+    __m512d fi = _mm512_floor_pd(_mm512_add_pd(x, s));
+    __m512d fj = _mm512_floor_pd(_mm512_add_pd(y, s));
+    __m512d fk = _mm512_floor_pd(_mm512_add_pd(z, s));
+    __m512d t = _mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(fi, fj), fk), _mm512_set1_pd(G3));
+    __m512d x0 = _mm512_sub_pd(x, _mm512_sub_pd(fi, t));
+    __m512d y0 = _mm512_sub_pd(y, _mm512_sub_pd(fj, t));
+    __m512d z0 = _mm512_sub_pd(z, _mm512_sub_pd(fk, t));
+    __m256i i = _mm512_maskz_cvtpd_epi32(ALL8, fi);
+    __m256i j = _mm512_maskz_cvtpd_epi32(ALL8, fj);
+    __m256i k = _mm512_maskz_cvtpd_epi32(ALL8, fk);
+
+    __mmask8 xy = _mm512_cmp_pd_mask(x0, y0, _CMP_GE_OQ);
+    __mmask8 xz = _mm512_cmp_pd_mask(x0, z0, _CMP_GE_OQ);
+    __mmask8 yz = _mm512_cmp_pd_mask(y0, z0, _CMP_GE_OQ);
+    __mmask8 mi1 = xy & xz,     mj1 = ~xy & yz,     mk1 = ~xz & ~yz;
+    __mmask8 mi2 = xy | xz,     mj2 = ~xy | yz,     mk2 = ~xz | ~yz;
+    __m512d i1 = _mm512_maskz_mov_pd(mi1, one), j1 = _mm512_maskz_mov_pd(mj1, one), k1 = _mm512_maskz_mov_pd(mk1, one);
+    __m512d i2 = _mm512_maskz_mov_pd(mi2, one), j2 = _mm512_maskz_mov_pd(mj2, one), k2 = _mm512_maskz_mov_pd(mk2, one);
+
+    __m512d g1 = _mm512_set1_pd(G3), g2 = _mm512_set1_pd(2.0*G3), g3 = _mm512_set1_pd(3.0*G3);
+    __m256i const ione = _mm256_set1_epi32(1);
+
+    __m512d n = corner_avx512(lattice_hash_avx512(i, j, k), x0, y0, z0);
+    n = _mm512_add_pd(n, corner_avx512(lattice_hash_avx512(
+            _mm256_add_epi32(i, _mm512_maskz_cvtpd_epi32(ALL8, i1)),
+            _mm256_add_epi32(j, _mm512_maskz_cvtpd_epi32(ALL8, j1)),
+            _mm256_add_epi32(k, _mm512_maskz_cvtpd_epi32(ALL8, k1))),
+        _mm512_add_pd(_mm512_sub_pd(x0, i1), g1),
+        _mm512_add_pd(_mm512_sub_pd(y0, j1), g1),
+        _mm512_add_pd(_mm512_sub_pd(z0, k1), g1)));
+    n = _mm512_add_pd(n, corner_avx512(lattice_hash_avx512(
+            _mm256_add_epi32(i, _mm512_maskz_cvtpd_epi32(ALL8, i2)),
+            _mm256_add_epi32(j, _mm512_maskz_cvtpd_epi32(ALL8, j2)),
+            _mm256_add_epi32(k, _mm512_maskz_cvtpd_epi32(ALL8, k2))),
+        _mm512_add_pd(_mm512_sub_pd(x0, i2), g2),
+        _mm512_add_pd(_mm512_sub_pd(y0, j2), g2),
+        _mm512_add_pd(_mm512_sub_pd(z0, k2), g2)));
+    n = _mm512_add_pd(n, corner_avx512(lattice_hash_avx512(
+            _mm256_add_epi32(i, ione), _mm256_add_epi32(j, ione), _mm256_add_epi32(k, ione)),
+        _mm512_add_pd(_mm512_sub_pd(x0, one), g3),
+        _mm512_add_pd(_mm512_sub_pd(y0, one), g3),
+        _mm512_add_pd(_mm512_sub_pd(z0, one), g3)));
+
+    return _mm512_mul_pd(_mm512_set1_pd(NSCALE), n);
+}
+
+__attribute__((target("avx512f")))
+static void
+simplex3_row_avx512(double x0, double dx, long long i0, double y, double z, long long n, double *vals)
+{
+    __m512d const vx0 = _mm512_set1_pd(x0), vdx = _mm512_set1_pd(dx);
+    __m512d const vy = _mm512_set1_pd(y), vz = _mm512_set1_pd(z);
+    __m512d const lane = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+    long long i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m512d vi = _mm512_add_pd(_mm512_set1_pd((double) (i0 + i)), lane);
+        _mm512_storeu_pd(vals + i, simplex3_avx512(_mm512_add_pd(vx0, _mm512_mul_pd(vi, vdx)), vy, vz));
+    }
+    if (i < n)
+    {
+        /* remainder with a masked store */
+        __m512d vi = _mm512_add_pd(_mm512_set1_pd((double) (i0 + i)), lane);
+        _mm512_mask_storeu_pd(vals + i, (__mmask8) ((1u << (n - i)) - 1),
+            simplex3_avx512(_mm512_add_pd(vx0, _mm512_mul_pd(vi, vdx)), vy, vz));
+    }
+}
+
+#endif /* MACSIO_NOISE_X86 */
+
+static int noise_isa = -1;
+
+static MACSIO_NOISE_ISA_t
+best_supported_isa(void)
+{
+#ifdef MACSIO_NOISE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return MACSIO_NOISE_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return MACSIO_NOISE_AVX2;
+#endif
+    return MACSIO_NOISE_SCALAR;
+}
+
+MACSIO_NOISE_ISA_t
+MACSIO_NOISE_GetISA(void)
+{
+    if (noise_isa < 0)
+        noise_isa = best_supported_isa();
+    return (MACSIO_NOISE_ISA_t) noise_isa;
+}
+
+MACSIO_NOISE_ISA_t
+MACSIO_NOISE_SetISA(MACSIO_NOISE_ISA_t isa)
+{
+    MACSIO_NOISE_ISA_t best = best_supported_isa();
+    noise_isa = isa > best ? best : isa;
+    return (MACSIO_NOISE_ISA_t) noise_isa;
+}
+
+char const *
+MACSIO_NOISE_ISAName(MACSIO_NOISE_ISA_t isa)
+{
+    switch (isa)
+    {
+        case MACSIO_NOISE_AVX512: return "avx512f";
+        case MACSIO_NOISE_AVX2:   return "avx2";
+        default: break;
+    }
+    return "scalar";
+}
+
+double
+MACSIO_NOISE_Simplex3(double x, double y, double z)
+{
+    return simplex3(x, y, z);
+}
+
+void
+MACSIO_NOISE_Simplex3Row(double x0, double dx, long long i0, double y, double z, long long n, double *vals)
+{
+    switch (MACSIO_NOISE_GetISA())
+    {
+#ifdef MACSIO_NOISE_X86
+        case MACSIO_NOISE_AVX512: simplex3_row_avx512(x0, dx, i0, y, z, n, vals); return;
+        case MACSIO_NOISE_AVX2:   simplex3_row_avx2(x0, dx, i0, y, z, n, vals); return;
+#endif
+        default: break;
+    }
+    simplex3_row_scalar(x0, dx, i0, y, z, n, vals);
+}
+
+void
+MACSIO_NOISE_Simplex3FbmRow(double x0, double dx, long long i0, double y, double z,
+    int noctaves, long long n, double *vals)
+{
+    double tmp[256];
+    long long i;
+
+    for (i = 0; i < n; i += 256)
+    {
+        int q, m, nm = n - i < 256 ? (int) (n - i) : 256;
+        double mult = 1;
+
+        for (m = 0; m < nm; m++)
+            vals[i+m] = 0;
+
+        /* Scaling by a power of 2 is exact so each octave's points are
+           exactly mult times the first octave's points */
+        for (q = 0; q < noctaves; q++, mult *= 2)
+        {
+            MACSIO_NOISE_Simplex3Row(mult*x0, mult*dx, i0 + i, mult*y, mult*z, nm, tmp);
+            for (m = 0; m < nm; m++)
+                vals[i+m] += fabs(tmp[m]) / mult;
+        }
+    }
+}
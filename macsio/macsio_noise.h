@@ -0,0 +1,138 @@
+#ifndef _MACSIO_NOISE_H
+#define _MACSIO_NOISE_H
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/*!
+\defgroup MACSIO_NOISE MACSIO_NOISE
+\brief Batched 3D simplex noise for generating realistic field data
+
+Noise is generated a row at a time (points evenly spaced in x at fixed y and z)
+so it can be vectorized. On x86 the widest of AVX-512, AVX2 or scalar code
+supported by the running CPU is selected at run time. All variants compute the
+same function and agree to within rounding.
+
+Noise values are in approximately [-1,1] with features on the order of unit
+size. The lattice is hashed (no permutation table) so the noise does not repeat.
+
+@{
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+\brief Instruction set variants of the noise generator
+*/
+typedef enum MACSIO_NOISE_ISA_t
+{
+    MACSIO_NOISE_SCALAR = 0, /**< portable scalar code */
+    MACSIO_NOISE_AVX2 = 1,   /**< 4 points at a time with AVX2 */
+    MACSIO_NOISE_AVX512 = 2  /**< 8 points at a time with AVX-512F */
+} MACSIO_NOISE_ISA_t;
+
+/*!
+\brief Get instruction set variant used for noise generation
+
+The first call selects the widest variant the running CPU supports. Call this
+once before generating noise from multiple threads.
+*/
+extern MACSIO_NOISE_ISA_t
+MACSIO_NOISE_GetISA(void);
+
+/*!
+\brief Set instruction set variant used for noise generation
+
+Mainly for testing. Requests for a variant the CPU does not support are
+reduced to the widest one that is supported.
+\return The variant actually selected
+*/
+extern MACSIO_NOISE_ISA_t
+MACSIO_NOISE_SetISA(
+    MACSIO_NOISE_ISA_t isa /**< requested instruction set variant */
+);
+
+/*!
+\brief Name of an instruction set variant (e.g. for logging)
+*/
+extern char const *
+MACSIO_NOISE_ISAName(
+    MACSIO_NOISE_ISA_t isa /**< instruction set variant */
+);
+
+/*!
+\brief 3D simplex noise at a single point
+*/
+extern double
+MACSIO_NOISE_Simplex3(
+    double x, /**< x coordinate in noise space */
+    double y, /**< y coordinate in noise space */
+    double z  /**< z coordinate in noise space */
+);
+
+/*!
+\brief 3D simplex noise at a row of points
+
+Computes noise at (x0 + (i0+i)*dx, y, z) for i in [0,n). Results for a given
+point do not depend on how a row is split into segments.
+*/
+extern void
+MACSIO_NOISE_Simplex3Row(
+    double x0,    /**< x coordinate of point 0 in noise space */
+    double dx,    /**< x spacing of points */
+    long long i0, /**< index of first point to compute */
+    double y,     /**< y coordinate of all points */
+    double z,     /**< z coordinate of all points */
+    long long n,  /**< number of points */
+    double *vals  /**< [out] caller allocated array of \c n values */
+);
+
+/*!
+\brief Fractal (turbulence) sum of 3D simplex noise at a row of points
+
+Sum over octaves q in [0,noctaves) of |noise(2^q * p)| / 2^q at the same points
+as \c MACSIO_NOISE_Simplex3Row().
+*/
+extern void
+MACSIO_NOISE_Simplex3FbmRow(
+    double x0,    /**< x coordinate of point 0 in noise space */
+    double dx,    /**< x spacing of points */
+    long long i0, /**< index of first point to compute */
+    double y,     /**< y coordinate of all points */
+    double z,     /**< z coordinate of all points */
+    int noctaves, /**< number of octaves to sum */
+    long long n,  /**< number of points */
+    double *vals  /**< [out] caller allocated array of \c n values */
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*!@}*/
+
+#endif /* _MACSIO_NOISE_H */
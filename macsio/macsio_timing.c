@@ -38,14 +38,26 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 #include <cfloat>
 #include <climits>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 #define MACSIO_TIMING_HASH_TABLE_SIZE 10007
 
 int MACSIO_TIMING_UseMPI_Wtime = 1;
+int MACSIO_TIMING_UseThreadLock = 0;
+
+/* Serializes access to the timer tables and group names when timers are
+   started and stopped from more than one thread (e.g. async dumps) */
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TIMER_LOCK()   if (MACSIO_TIMING_UseThreadLock) pthread_mutex_lock(&timer_lock)
+#define TIMER_UNLOCK() if (MACSIO_TIMING_UseThreadLock) pthread_mutex_unlock(&timer_lock)
 
 static double get_current_time()
 {
@@ -95,6 +107,26 @@ static double get_current_time()
 
     return (ms/1000.);
 
+#else
+
+#if defined(CLOCK_MONOTONIC)
+
+    /* monotonic and, through the vDSO, no system call */
+    static struct timespec T0;
+           struct timespec T1;
+
+    if (first)
+    {
+        first = 0;
+        clock_gettime(CLOCK_MONOTONIC, &T0);
+        return 0.0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &T1);
+
+    return (double) (T1.tv_sec - T0.tv_sec) +
+           (double) (T1.tv_nsec - T0.tv_nsec) / 1000000000.;
+
 #else
 
     static struct timeval T0;
@@ -112,6 +144,8 @@ static double get_current_time()
     return (double) (T1.tv_sec - T0.tv_sec) +
            (double) (T1.tv_usec - T0.tv_usec) / 1000000.;
 
+#endif
+
 #endif
 }
 
@@ -166,7 +200,11 @@ group_mask_from_name(char const *grpName)
 MACSIO_TIMING_GroupMask_t
 MACSIO_TIMING_GroupMask(char const *grpName)
 {
-    return group_mask_from_name(grpName);
+    MACSIO_TIMING_GroupMask_t gmask;
+    TIMER_LOCK();
+    gmask = group_mask_from_name(grpName);
+    TIMER_UNLOCK();
+    return gmask;
 }
 
 typedef struct _timerInfo_t
@@ -182,6 +220,9 @@ typedef struct _timerInfo_t
     int iter_num;                    /**< Iteration number of current timer */
     int depth;                       /**< Depth of this timer relative to other active timers */
     int is_restart;                  /**< Is this timer restarting the current iteration */
+    int parent;                      /**< Timer running when this timer was first started or -1 */
+    unsigned int hash;               /**< Hash of file, line, mask and label; same on all tasks */
+    unsigned int parent_hash;        /**< hash of parent, which identifies it across tasks */
 
     double total_time;               /**< Total cummulative time spent in this timer over all iterations */
     double min_time;                 /**< Min over all iterations this timer ran */
@@ -200,6 +241,71 @@ typedef struct _timerInfo_t
 static timerInfo_t timerHashTable[MACSIO_TIMING_HASH_TABLE_SIZE];
 static timerInfo_t reducedTimerTable[MACSIO_TIMING_HASH_TABLE_SIZE];
 
+/* Log-linear histograms of timer times, after HDR histograms. Each power of 2
+   from 2^HIST_MIN_EXP to 2^HIST_MAX_EXP seconds is split into HIST_SUB_BUCKETS
+   equal buckets so any time is known to within about 4%. Histograms merge by
+   adding counts. They are kept apart from timerInfo_t, allocated only for
+   timers that have stopped, so the timer tables stay small. */
+#define HIST_SUB_BUCKETS 8
+#define HIST_MIN_EXP -24 /* about 60 nanoseconds */
+#define HIST_MAX_EXP 12  /* about 68 minutes */
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_MIN_EXP) * HIST_SUB_BUCKETS)
+typedef unsigned int timerHist_t[HIST_BUCKETS];
+
+static timerHist_t *timerHists[MACSIO_TIMING_HASH_TABLE_SIZE];        /* iterations on this task */
+static timerHist_t *reducedTimerHists[MACSIO_TIMING_HASH_TABLE_SIZE]; /* iterations on all tasks */
+static timerHist_t *reducedRankHists[MACSIO_TIMING_HASH_TABLE_SIZE];  /* total time of each task */
+
+static int hist_bucket(double t)
+{
+    int e, b;
+    double m;
+
+    if (!(t > 0)) return 0;
+    m = frexp(t, &e); /* t = m * 2^e, 0.5 <= m < 1 */
+    if (e - 1 < HIST_MIN_EXP) return 0;
+    if (e - 1 >= HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    b = (int) ((m - 0.5) * 2 * HIST_SUB_BUCKETS);
+    return (e - 1 - HIST_MIN_EXP) * HIST_SUB_BUCKETS + b;
+}
+
+static double hist_bucket_value(int b)
+{
+    int e = b / HIST_SUB_BUCKETS + HIST_MIN_EXP + 1;
+    return ldexp(0.5 + (b % HIST_SUB_BUCKETS + 0.5) / (2 * HIST_SUB_BUCKETS), e);
+}
+
+static void hist_add(timerHist_t **hist, double t)
+{
+    if (!*hist)
+        *hist = (timerHist_t *) calloc(1, sizeof(timerHist_t));
+    (**hist)[hist_bucket(t)]++;
+}
+
+/* Value below which fraction q of the counts lie, clamped to [lo,hi] */
+static double hist_percentile(timerHist_t const *hist, double q, double lo, double hi)
+{
+    unsigned long long n = 0, rank, cum = 0;
+    double val = 0;
+    int b;
+
+    if (!hist) return 0;
+    for (b = 0; b < HIST_BUCKETS; b++)
+        n += (*hist)[b];
+    if (!n) return 0;
+    rank = (unsigned long long) ceil(q * n);
+    if (rank < 1) rank = 1;
+    for (b = 0; b < HIST_BUCKETS; b++)
+    {
+        cum += (*hist)[b];
+        if (cum >= rank) break;
+    }
+    val = hist_bucket_value(b);
+    if (val < lo) val = lo;
+    if (val > hi) val = hi;
+    return val;
+}
+
 #ifdef HAVE_CALIPER
 typedef struct _caliperAttributeInfo_t {
     cali_id_t attr;                  /**< Caliper attribute id for the timer */
@@ -209,7 +315,100 @@ typedef struct _caliperAttributeInfo_t {
 static caliperAttributeInfo_t caliperAttributeInfo[MACSIO_TIMING_HASH_TABLE_SIZE];
 #endif
 
-MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
+/* Event trace. Each stop of a timer while tracing appends a begin/end event
+   to a ring buffer, overwriting the oldest once full. Slots are claimed with
+   an atomic increment so threads need not take a lock to record. */
+typedef struct _traceEvent_t
+{
+    double start;                /**< time the timer was started */
+    double stop;                 /**< time the timer was stopped */
+    MACSIO_TIMING_TimerId_t tid; /**< the timer */
+    int iter;                    /**< timer's iteration number */
+    int dump;                    /**< recording thread's MACSIO_TIMING_TraceDumpNum */
+    short depth;                 /**< nesting depth of timers on the thread */
+    short thread;                /**< small id of recording thread */
+} traceEvent_t;
+
+__thread int MACSIO_TIMING_TraceDumpNum = -1;
+static traceEvent_t *traceRing = 0;
+static unsigned long long traceCapacity = 0;
+static unsigned long long traceNext = 0;
+static double traceClockOffset = 0; /* this task's clock less task 0's */
+static int traceThreadCount = 0;
+static __thread int traceThread = -1;
+
+/* Per thread stack of running timers. A timer's parent is the timer on top
+   when it is first started. */
+#define MAX_TIMER_DEPTH 64
+static __thread MACSIO_TIMING_TimerId_t timerStack[MAX_TIMER_DEPTH];
+static __thread int timerStackDepth = 0;
+
+static int stack_top(void)
+{
+    if (timerStackDepth < 1 || timerStackDepth > MAX_TIMER_DEPTH)
+        return -1;
+    return (int) timerStack[timerStackDepth-1];
+}
+
+static void push_timer(MACSIO_TIMING_TimerId_t tid)
+{
+    if (tid == MACSIO_TIMING_INVALID_TIMER) return;
+    if (timerStackDepth < MAX_TIMER_DEPTH)
+        timerStack[timerStackDepth] = tid;
+    timerStackDepth++;
+}
+
+/* Usually tid is on top. A timer stopped out of order unwinds those above it. */
+static void pop_timer(MACSIO_TIMING_TimerId_t tid)
+{
+    int i = (timerStackDepth < MAX_TIMER_DEPTH ? timerStackDepth : MAX_TIMER_DEPTH) - 1;
+
+    while (i >= 0 && timerStack[i] != tid)
+        i--;
+    if (i >= 0)
+        timerStackDepth = i;
+    else if (timerStackDepth > MAX_TIMER_DEPTH)
+        timerStackDepth--;
+}
+
+static void trace_timer_stop(MACSIO_TIMING_TimerId_t tid, double start, double stop)
+{
+    unsigned long long i = __atomic_fetch_add(&traceNext, 1ULL, __ATOMIC_RELAXED);
+    traceEvent_t *e = &traceRing[i % traceCapacity];
+
+    if (traceThread < 0)
+        traceThread = __atomic_fetch_add(&traceThreadCount, 1, __ATOMIC_RELAXED);
+    e->start = start;
+    e->stop = stop;
+    e->tid = tid;
+    e->iter = timerHashTable[tid].iter_num;
+    e->dump = MACSIO_TIMING_TraceDumpNum;
+    e->depth = (short) timerStackDepth;
+    e->thread = (short) traceThread;
+}
+
+/* Incremented whenever timers are cleared, invalidating cached timer ids */
+static unsigned int timerGeneration = 1;
+
+/* Another iteration of or re-starting an existing timer */
+static void restart_timer(MACSIO_TIMING_TimerId_t tid, int iter_num)
+{
+    timerHashTable[tid].is_restart = 0;
+    if (iter_num == timerHashTable[tid].iter_num)
+        timerHashTable[tid].is_restart = 1;
+    else if (iter_num == MACSIO_TIMING_ITER_AUTO)
+        timerHashTable[tid].iter_num++;
+    else
+        timerHashTable[tid].iter_num = iter_num;
+    timerHashTable[tid].start_time = get_current_time();
+
+#ifdef HAVE_CALIPER
+    cali_begin_int(caliperAttributeInfo[tid].iter_attr, timerHashTable[tid].iter_num);
+    cali_begin_string(caliperAttributeInfo[tid].attr, timerHashTable[tid].label);
+#endif
+}
+
+static MACSIO_TIMING_TimerId_t start_timer(
     char const *label,
     MACSIO_TIMING_GroupMask_t gmask,
     int iter_num,
@@ -218,17 +417,22 @@ MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
 )
 {
     int n = 0;
-    int len = strlen(__file__) + strlen(label) + 64;
-    char* _label = (char *) malloc(len);
-    int len2 = snprintf(_label, len, "%s:%05d:%016llX:%s", __file__, __line__, gmask, label);
-    MACSIO_TIMING_TimerId_t tid = MACSIO_UTILS_BJHash((unsigned char*)_label, len2, 0) % MACSIO_TIMING_HASH_TABLE_SIZE;
-    int inc = (tid > MACSIO_TIMING_HASH_TABLE_SIZE / 2) ? -1 : 1;
+    unsigned int hash;
+    MACSIO_TIMING_TimerId_t tid;
+    int inc;
 
 #ifdef HAVE_CALIPER
     char* _cali_iter_label = NULL;
 #endif
-    
-    free(_label);
+
+    /* Hash file, line, mask and label in turn, each seeding the next, rather
+       than formatting them into one string. Ids must agree across tasks. */
+    hash = MACSIO_UTILS_BJHash((unsigned char const *) __file__, strlen(__file__), 0);
+    hash = MACSIO_UTILS_BJHash((unsigned char const *) &__line__, sizeof(__line__), hash);
+    hash = MACSIO_UTILS_BJHash((unsigned char const *) &gmask, sizeof(gmask), hash);
+    hash = MACSIO_UTILS_BJHash((unsigned char const *) label, strlen(label), hash);
+    tid = hash % MACSIO_TIMING_HASH_TABLE_SIZE;
+    inc = (tid > MACSIO_TIMING_HASH_TABLE_SIZE / 2) ? -1 : 1;
 
     /* Find the timer's slot in the hash table */
     while (n < MACSIO_TIMING_HASH_TABLE_SIZE)
@@ -253,7 +457,11 @@ MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
             timerHashTable[tid].total_time_this_iter = 0;
             timerHashTable[tid].is_restart = 0;
 
-            timerHashTable[tid].depth = 0;
+            timerHashTable[tid].depth = timerStackDepth;
+            timerHashTable[tid].parent = stack_top() == (int) tid ? -1 : stack_top();
+            timerHashTable[tid].hash = hash;
+            timerHashTable[tid].parent_hash = timerHashTable[tid].parent < 0 ? 0 :
+                timerHashTable[timerHashTable[tid].parent].hash;
             timerHashTable[tid].start_time = get_current_time();
 
 #ifdef HAVE_CALIPER
@@ -276,21 +484,7 @@ MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
             strncmp(timerHashTable[tid].__file__, __file__, sizeof(timerHashTable[tid].__file__)) == 0 &&
             timerHashTable[tid].__line__ == __line__)
         {
-            /* Another iteration of or re-starting an existing timer */
-            timerHashTable[tid].is_restart = 0;
-            if (iter_num == timerHashTable[tid].iter_num)
-                timerHashTable[tid].is_restart = 1;
-            else if (iter_num == MACSIO_TIMING_ITER_AUTO)
-                timerHashTable[tid].iter_num++;
-            else
-                timerHashTable[tid].iter_num = iter_num;
-            timerHashTable[tid].start_time = get_current_time();
-
-#ifdef HAVE_CALIPER
-            cali_begin_int(caliperAttributeInfo[tid].iter_attr, timerHashTable[tid].iter_num);
-            cali_begin_string(caliperAttributeInfo[tid].attr, timerHashTable[tid].label);
-#endif
-            
+            restart_timer(tid, iter_num);
             return tid;
         }
 
@@ -310,13 +504,64 @@ MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
     return MACSIO_TIMING_INVALID_TIMER;
 }
 
-double MACSIO_TIMING_StopTimer(MACSIO_TIMING_TimerId_t tid)
+MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimer(
+    char const *label,
+    MACSIO_TIMING_GroupMask_t gmask,
+    int iter_num,
+    char const *__file__,
+    int __line__
+)
+{
+    MACSIO_TIMING_TimerId_t tid;
+    TIMER_LOCK();
+    tid = start_timer(label, gmask, iter_num, __file__, __line__);
+    TIMER_UNLOCK();
+    push_timer(tid);
+    return tid;
+}
+
+MACSIO_TIMING_TimerId_t MACSIO_TIMING_StartTimerAtSite(
+    MACSIO_TIMING_TimerSite_t *site,
+    char const *label,
+    MACSIO_TIMING_GroupMask_t gmask,
+    int iter_num,
+    char const *__file__,
+    int __line__
+)
+{
+    MACSIO_TIMING_TimerId_t tid;
+    TIMER_LOCK();
+    if (site->generation == timerGeneration)
+    {
+        tid = site->tid;
+        restart_timer(tid, iter_num);
+    }
+    else
+    {
+        tid = start_timer(label, gmask, iter_num, __file__, __line__);
+        if (tid != MACSIO_TIMING_INVALID_TIMER)
+        {
+            site->tid = tid;
+            site->generation = timerGeneration;
+        }
+    }
+    TIMER_UNLOCK();
+    push_timer(tid);
+    return tid;
+}
+
+static double stop_timer(MACSIO_TIMING_TimerId_t tid)
 {
     double stop_time = get_current_time();
-    double timer_time = stop_time - timerHashTable[tid].start_time;
+    double timer_time;
 
     if (tid >= MACSIO_TIMING_HASH_TABLE_SIZE) return DBL_MAX;
 
+    timer_time = stop_time - timerHashTable[tid].start_time;
+
+    if (traceRing)
+        trace_timer_stop(tid, timerHashTable[tid].start_time, stop_time);
+
 #ifdef HAVE_CALIPER
     cali_end(caliperAttributeInfo[tid].attr);
     cali_end(caliperAttributeInfo[tid].iter_attr);
@@ -353,6 +598,8 @@ double MACSIO_TIMING_StopTimer(MACSIO_TIMING_TimerId_t tid)
         timerHashTable[tid].running_var = var;
         timerHashTable[tid].total_time += timer_time;
 
+        hist_add(&timerHists[tid], timer_time);
+
         if (timer_time < timerHashTable[tid].min_time)
         {
             timerHashTable[tid].min_time = timer_time;
@@ -368,14 +615,34 @@ double MACSIO_TIMING_StopTimer(MACSIO_TIMING_TimerId_t tid)
     return timer_time;
 }
 
+double MACSIO_TIMING_StopTimer(MACSIO_TIMING_TimerId_t tid)
+{
+    double timer_time;
+    pop_timer(tid);
+    TIMER_LOCK();
+    timer_time = stop_timer(tid);
+    TIMER_UNLOCK();
+    return timer_time;
+}
+
 static double
 get_timer_datum(
     timerInfo_t const *table,
+    timerHist_t * const *hists,
     MACSIO_TIMING_TimerId_t tid,
     char const *field)
 {
     if (tid >= MACSIO_TIMING_HASH_TABLE_SIZE) return -1;
 
+    if      (!strcmp(field, "p50"))
+        return hist_percentile(hists[tid], 0.50, table[tid].min_time, table[tid].max_time);
+    else if (!strcmp(field, "p90"))
+        return hist_percentile(hists[tid], 0.90, table[tid].min_time, table[tid].max_time);
+    else if (!strcmp(field, "p99"))
+        return hist_percentile(hists[tid], 0.99, table[tid].min_time, table[tid].max_time);
+    else if (!strcmp(field, "p999"))
+        return hist_percentile(hists[tid], 0.999, table[tid].min_time, table[tid].max_time);
+
     if      (!strncmp(field, "__line__", 8))
         return table[tid].__line__;
     else if (!strncmp(field, "start_time", 10))
@@ -396,6 +663,8 @@ get_timer_datum(
         return table[tid].iter_num;
     else if (!strncmp(field, "depth", 5))
         return table[tid].depth;
+    else if (!strncmp(field, "parent", 6))
+        return table[tid].parent;
     else if (!strncmp(field, "total_time", 10))
         return table[tid].total_time;
     else if (!strncmp(field, "min_time", 8))
@@ -412,16 +681,17 @@ get_timer_datum(
 
 double MACSIO_TIMING_GetTimerDatum(MACSIO_TIMING_TimerId_t tid, char const *field)
 {
-    return get_timer_datum(timerHashTable, tid, field);
+    return get_timer_datum(timerHashTable, timerHists, tid, field);
 }
 
 double MACSIO_TIMING_GetReducedTimerDatum(MACSIO_TIMING_TimerId_t tid, char const *field)
 {
-    return get_timer_datum(reducedTimerTable, tid, field);
+    return get_timer_datum(reducedTimerTable, reducedTimerHists, tid, field);
 }
 
 static void
-clear_timers(timerInfo_t *table, MACSIO_TIMING_GroupMask_t gmask)
+clear_timers(timerInfo_t *table, timerHist_t **hists, timerHist_t **rank_hists,
+    MACSIO_TIMING_GroupMask_t gmask)
 {
     int i;
     for (i = 0; i < MACSIO_TIMING_HASH_TABLE_SIZE; i++)
@@ -448,7 +718,18 @@ clear_timers(timerInfo_t *table, MACSIO_TIMING_GroupMask_t gmask)
 
         table[i].is_restart = 0;
         table[i].depth = 0;
+        table[i].parent = -1;
+        table[i].hash = 0;
+        table[i].parent_hash = 0;
         table[i].start_time = 0;
+
+        free(hists[i]);
+        hists[i] = 0;
+        if (rank_hists)
+        {
+            free(rank_hists[i]);
+            rank_hists[i] = 0;
+        }
     }
 }
 
@@ -470,6 +751,17 @@ reduce_a_timerinfo(
         if (strlen(a_info[i].label) == 0 && strlen(b_info[i].label) == 0)
             continue;
 
+        /* A timer not run on one side's tasks is just the other side's */
+        if (strlen(b_info[i].label) == 0)
+        {
+            b_info[i] = a_info[i];
+            continue;
+        }
+        else if (strlen(a_info[i].label) == 0)
+        {
+            continue;
+        }
+
         /* If filenames don't match, record that fact by setting b (out) to all '~' chars */
         if (strcmp(a_info[i].__file__, b_info[i].__file__))
         {
@@ -490,6 +782,16 @@ reduce_a_timerinfo(
                 b_info[i].label[j++] = '~';
         }
     
+        /* Parent slots differ among tasks, so parents are reduced by their
+           hashes and resolved to slots afterwards. If parents don't match,
+           keep a known one, the same one whatever the order of reduction. */
+        if (a_info[i].parent >= 0 &&
+            (b_info[i].parent < 0 || a_info[i].parent_hash < b_info[i].parent_hash))
+        {
+            b_info[i].parent = a_info[i].parent;
+            b_info[i].parent_hash = a_info[i].parent_hash;
+        }
+
         /* If groups don't match, record that fact as ALL_GROUPS */
         if (a_info[i].gmask != b_info[i].gmask)
             b_info[i].gmask = MACSIO_TIMING_ALL_GROUPS;
@@ -540,6 +842,117 @@ reduce_a_timerinfo(
         }
     }
 }
+
+static int
+cmp_slot_hash(void const *a, void const *b)
+{
+    unsigned int ha = timerHashTable[*(int const *) a].hash;
+    unsigned int hb = timerHashTable[*(int const *) b].hash;
+    return ha < hb ? -1 : ha > hb ? 1 : 0;
+}
+
+/* Sets of timer hashes are reduced as single elements of a contiguous type,
+   so MPI never splits one, each a count, an overflow flag and then the
+   hashes in increasing order. */
+static void
+union_hash_sets(
+    void *a,		/**< [in] first input for MPI_User_function */
+    void *b,		/**< [in,out] second input arg for MPI_User_function and reduced output */
+    int *len,		/**< [in] number of sets in A and B buffers */
+    MPI_Datatype *type	/**< [in] type of sets in A and B buffers */
+)
+{
+    int i, size;
+    unsigned int cap, *u;
+
+    MPI_Type_size(*type, &size);
+    cap = size / sizeof(unsigned int) - 2;
+    u = (unsigned int *) malloc((cap + 1) * sizeof(unsigned int));
+    for (i = 0; i < *len; i++)
+    {
+        unsigned int *ha = (unsigned int *) a + i * (cap + 2);
+        unsigned int *hb = (unsigned int *) b + i * (cap + 2);
+        unsigned int ia = 0, ib = 0, n = 0;
+
+        while (ia < ha[0] || ib < hb[0])
+        {
+            unsigned int h;
+
+            if (ib == hb[0] || (ia < ha[0] && ha[2+ia] < hb[2+ib]))
+                h = ha[2+ia++];
+            else if (ia == ha[0] || hb[2+ib] < ha[2+ia])
+                h = hb[2+ib++];
+            else
+            {
+                h = ha[2+ia++];
+                ib++;
+            }
+            if (n == cap)
+            {
+                hb[1] = 1;
+                break;
+            }
+            u[n++] = h;
+        }
+        hb[0] = n;
+        hb[1] |= ha[1];
+        memcpy(hb + 2, u, n * sizeof(unsigned int));
+    }
+    free(u);
+}
+
+/* Returns the slots of timers live on this task, sorted by hash, and the
+   sorted union over all tasks of their hashes. The union is reduced with
+   room for twice as many hashes as any one task has and is retried with
+   more in the rare case that is too few. Should two different timers on a
+   task have the same hash, only the first is reduced. */
+static unsigned int *
+live_hashes(MPI_Comm comm, int **slots, int *nlocal, int *nlive)
+{
+    int i, n = 0, nmax, cap;
+    unsigned int *set, *uset, *hashes;
+
+    *slots = (int *) malloc(MACSIO_TIMING_HASH_TABLE_SIZE * sizeof(int));
+    for (i = 0; i < MACSIO_TIMING_HASH_TABLE_SIZE; i++)
+        if (timerHashTable[i].label[0])
+            (*slots)[n++] = i;
+    qsort(*slots, n, sizeof(int), cmp_slot_hash);
+    MPI_Allreduce(&n, &nmax, 1, MPI_INT, MPI_MAX, comm);
+
+    for (cap = 2 * nmax + 1;; cap *= 2)
+    {
+        MPI_Datatype set_type;
+        MPI_Op union_op;
+
+        set = (unsigned int *) calloc(cap + 2, sizeof(unsigned int));
+        uset = (unsigned int *) malloc((cap + 2) * sizeof(unsigned int));
+        for (i = 0; i < n; i++)
+        {
+            unsigned int h = timerHashTable[(*slots)[i]].hash;
+            if (!set[0] || set[1 + set[0]] != h)
+                set[2 + set[0]++] = h;
+        }
+
+        MPI_Type_contiguous(cap + 2, MPI_UNSIGNED, &set_type);
+        MPI_Type_commit(&set_type);
+        MPI_Op_create(union_hash_sets, 1, &union_op);
+        MPI_Allreduce(set, uset, 1, set_type, union_op, comm);
+        MPI_Op_free(&union_op);
+        MPI_Type_free(&set_type);
+
+        if (!uset[1]) break;
+        free(set);
+        free(uset);
+    }
+
+    *nlocal = n;
+    *nlive = (int) uset[0];
+    hashes = (unsigned int *) malloc((uset[0] + 1) * sizeof(unsigned int));
+    memcpy(hashes, uset + 2, uset[0] * sizeof(unsigned int));
+    free(set);
+    free(uset);
+    return hashes;
+}
 #endif
 
 void
@@ -558,7 +971,7 @@ MACSIO_TIMING_ReduceTimers(
     static MPI_Datatype str_32_mpi_type;
     static MPI_Datatype str_64_mpi_type;
     static MPI_Datatype timerinfo_mpi_type;
-    int i, rank = 0;
+    int i, j, rank = 0;
 
     MPI_Comm_rank(comm, &rank);
 
@@ -585,7 +998,7 @@ MACSIO_TIMING_ReduceTimers(
         MPI_Type_contiguous(64, MPI_CHAR, &str_64_mpi_type);
         MPI_Type_commit(&str_64_mpi_type);
 
-        lengths[0] = 9;
+        lengths[0] = 12;
         types[0] = MPI_INT;
         MPI_Get_address(&timerHashTable[0], offsets);
         lengths[1] = 7;
@@ -607,18 +1020,111 @@ MACSIO_TIMING_ReduceTimers(
         first = 0;
     }
 
-    clear_timers(reducedTimerTable, MACSIO_TIMING_ALL_GROUPS);
-    for (i = 0; i < MACSIO_TIMING_HASH_TABLE_SIZE; i++)
-        timerHashTable[i].min_rank = timerHashTable[i].max_rank = rank;
+    clear_timers(reducedTimerTable, reducedTimerHists, reducedRankHists, MACSIO_TIMING_ALL_GROUPS);
+
+    /* Agree on the timers live on any task by their identity hashes, then
+       reduce only those, in hash order. A timer's slot is not the same on
+       every task because collisions are resolved by probing in the order
+       timers were first started, so slots cannot be used to match timers. */
+    {
+        unsigned int *hashes;
+        timerInfo_t *sbuf, *rbuf = 0;
+        timerHist_t *shist, *rhist = 0;
+        int *slots, nlocal, nlive;
+
+        hashes = live_hashes(comm, &slots, &nlocal, &nlive);
+
+        /* Histograms, two per live timer, of its iteration times and of this
+           task's total time in it, are merged by summing their counts */
+        sbuf = (timerInfo_t *) calloc(nlive + 1, sizeof(timerInfo_t));
+        shist = (timerHist_t *) calloc(2 * nlive + 1, sizeof(timerHist_t));
+        for (i = 0, j = 0; i < nlive; i++)
+        {
+            int s;
+
+            while (j < nlocal && timerHashTable[slots[j]].hash < hashes[i]) j++;
+            if (j == nlocal || timerHashTable[slots[j]].hash != hashes[i])
+                continue;
+            s = slots[j];
+            sbuf[i] = timerHashTable[s];
+            sbuf[i].min_rank = sbuf[i].max_rank = rank;
+            if (timerHists[s])
+                memcpy(shist[2*i], *timerHists[s], sizeof(timerHist_t));
+            shist[2*i+1][hist_bucket(timerHashTable[s].total_time)] = 1;
+        }
+        if (rank == root)
+        {
+            rbuf = (timerInfo_t *) malloc((nlive + 1) * sizeof(timerInfo_t));
+            rhist = (timerHist_t *) malloc((2 * nlive + 1) * sizeof(timerHist_t));
+        }
+
+        MPI_Reduce(sbuf, rbuf, nlive, timerinfo_mpi_type, timerinfo_reduce_op, root, comm);
+        MPI_Reduce(shist, rhist, 2 * nlive * HIST_BUCKETS, MPI_UNSIGNED, MPI_SUM, root, comm);
+
+        if (rank == root)
+        {
+            int *rslots = (int *) malloc((nlive + 1) * sizeof(int));
 
-    MPI_Reduce(timerHashTable, reducedTimerTable, MACSIO_TIMING_HASH_TABLE_SIZE,
-        timerinfo_mpi_type, timerinfo_reduce_op, root, comm);
+            /* Timers run here keep their slots, the rest probe for free ones */
+            for (i = 0, j = 0; i < nlive; i++)
+            {
+                while (j < nlocal && timerHashTable[slots[j]].hash < hashes[i]) j++;
+                rslots[i] = -1;
+                if (j < nlocal && timerHashTable[slots[j]].hash == hashes[i])
+                    rslots[i] = slots[j];
+                if (rslots[i] >= 0)
+                    reducedTimerTable[rslots[i]] = rbuf[i];
+            }
+            for (i = 0; i < nlive; i++)
+            {
+                int s = hashes[i] % MACSIO_TIMING_HASH_TABLE_SIZE, n = 0;
+
+                if (rslots[i] >= 0) continue;
+                while (reducedTimerTable[s].label[0] && n++ < MACSIO_TIMING_HASH_TABLE_SIZE)
+                    s = (s + 1) % MACSIO_TIMING_HASH_TABLE_SIZE;
+                if (reducedTimerTable[s].label[0])
+                    break; /* table full */
+                rslots[i] = s;
+                reducedTimerTable[s] = rbuf[i];
+            }
+
+            for (i = 0; i < nlive; i++)
+            {
+                int s = rslots[i];
+
+                if (s < 0) continue;
+
+                /* Find the parent's slot here from its hash */
+                for (j = 0; rbuf[i].parent >= 0 && j < nlive; j++)
+                {
+                    if (hashes[j] == rbuf[i].parent_hash)
+                        break;
+                }
+                if (rbuf[i].parent >= 0)
+                    reducedTimerTable[s].parent = j < nlive ? rslots[j] : -1;
+
+                reducedTimerHists[s] = (timerHist_t *) malloc(sizeof(timerHist_t));
+                reducedRankHists[s] = (timerHist_t *) malloc(sizeof(timerHist_t));
+                memcpy(reducedTimerHists[s], rhist[2*i], sizeof(timerHist_t));
+                memcpy(reducedRankHists[s], rhist[2*i+1], sizeof(timerHist_t));
+            }
+            free(rslots);
+            free(rbuf);
+            free(rhist);
+        }
+        free(sbuf);
+        free(shist);
+        free(slots);
+        free(hashes);
+    }
 #endif
 }
 
 static void
 dump_timers_to_strings(
     timerInfo_t const *table,
+    timerHist_t * const *hists,
+    timerHist_t * const *rank_hists,
     MACSIO_TIMING_GroupMask_t gmask,
     char ***strs,
     int *nstrs,
@@ -638,7 +1144,8 @@ dump_timers_to_strings(
         {
             int len;
             double min_in_stddev_steps_from_mean = 0, max_in_stddev_steps_from_mean = 0;
-            double dev;
+            double dev, lo, hi;
+            char rank_pcts[128] = "";
 
             if (!strlen(table[i].label)) continue;
 
@@ -658,14 +1165,27 @@ dump_timers_to_strings(
 
 //#warning USE COLUMN HEADINGS INSTEAD
 //#warning HANDLE INDENTATION HERE
+            /* Percentiles of iteration times and, for reduced timers, of
+               the total time each task spent in the timer */
+            lo = table[i].min_time;
+            hi = table[i].max_time;
+            if (rank_hists)
+                snprintf(rank_pcts, sizeof(rank_pcts), ",TASK_P50=%10.5f,TASK_P99=%10.5f",
+                    hist_percentile(rank_hists[i], 0.50, 0, table[i].total_time),
+                    hist_percentile(rank_hists[i], 0.99, 0, table[i].total_time));
+
             len = snprintf(_strs[_nstrs-1], max_str_size,
-                "TOT=%10.5f,CNT=%04d,MIN=%8.5f(%4.2f):%06d,AVG=%8.5f,MAX=%8.5f(%4.2f):%06d,DEV=%8.8f:FILE=%s:LINE=%d:LAB=%s",
+                "TOT=%10.5f,CNT=%04d,MIN=%8.5f(%4.2f):%06d,AVG=%8.5f,MAX=%8.5f(%4.2f):%06d,DEV=%8.8f,"
+                "P50=%8.5f,P90=%8.5f,P99=%8.5f,P999=%8.5f%s:FILE=%s:LINE=%d:LAB=%s",
                 table[i].total_time,
                 table[i].iter_count,
                 table[i].min_time, min_in_stddev_steps_from_mean, table[i].min_rank,
                 table[i].running_mean,
                 table[i].max_time, max_in_stddev_steps_from_mean, table[i].max_rank,
                 dev,
+                hist_percentile(hists[i], 0.50, lo, hi), hist_percentile(hists[i], 0.90, lo, hi),
+                hist_percentile(hists[i], 0.99, lo, hi), hist_percentile(hists[i], 0.999, lo, hi),
+                rank_pcts,
                 table[i].__file__,
                 table[i].__line__,
                 table[i].label);
@@ -682,6 +1202,126 @@ dump_timers_to_strings(
     *maxlen = _maxlen;
 }
 
+static timerInfo_t const *sort_table;
+static int compare_total_time(void const *a, void const *b)
+{
+    double ta = sort_table[*(int const *) a].total_time;
+    double tb = sort_table[*(int const *) b].total_time;
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/* Call tree of timers, children beneath parents and most costly first */
+static void
+dump_tree_to_strings(
+    timerInfo_t const *table,
+    MACSIO_TIMING_GroupMask_t gmask,
+    char ***strs,
+    int *nstrs,
+    int *maxlen
+)
+{
+    int const max_str_size = 1024;
+    int i, n = 0, nroots = 0, top = 0, _maxlen = 0;
+    int *first, *kids, *stack, *level, *parent;
+    char **_strs;
+
+    /* Group timers by parent; those whose parent is not shown are roots */
+    first = (int *) calloc(MACSIO_TIMING_HASH_TABLE_SIZE + 2, sizeof(int));
+    parent = (int *) malloc(MACSIO_TIMING_HASH_TABLE_SIZE * sizeof(int));
+    for (i = 0; i < MACSIO_TIMING_HASH_TABLE_SIZE; i++)
+    {
+        int p = table[i].parent;
+        parent[i] = -2;
+        if (!table[i].label[0] || !(table[i].gmask & gmask)) continue;
+        if (p < 0 || p >= MACSIO_TIMING_HASH_TABLE_SIZE || p == i ||
+            !table[p].label[0] || !(table[p].gmask & gmask))
+            p = MACSIO_TIMING_HASH_TABLE_SIZE; /* stands for the root */
+        parent[i] = p;
+        first[p+1]++;
+        n++;
+    }
+    for (i = 0; i <= MACSIO_TIMING_HASH_TABLE_SIZE; i++)
+        first[i+1] += first[i];
+    kids = (int *) malloc((n + 1) * sizeof(int));
+    for (i = 0; i < MACSIO_TIMING_HASH_TABLE_SIZE; i++)
+        if (parent[i] >= 0)
+            kids[first[parent[i]]++] = i;
+    for (i = MACSIO_TIMING_HASH_TABLE_SIZE; i > 0; i--)
+        first[i] = first[i-1];
+    first[0] = 0;
+    sort_table = table;
+    for (i = 0; i <= MACSIO_TIMING_HASH_TABLE_SIZE; i++)
+        if (first[i+1] - first[i] > 1)
+            qsort(kids + first[i], first[i+1] - first[i], sizeof(int), compare_total_time);
+
+    /* Depth first walk */
+    _strs = (char **) malloc((n + 1) * sizeof(char *));
+    stack = (int *) malloc((n + 1) * sizeof(int));
+    level = (int *) malloc((n + 1) * sizeof(int));
+    nroots = first[MACSIO_TIMING_HASH_TABLE_SIZE+1] - first[MACSIO_TIMING_HASH_TABLE_SIZE];
+    for (i = nroots - 1; i >= 0; i--)
+    {
+        stack[top] = kids[first[MACSIO_TIMING_HASH_TABLE_SIZE] + i];
+        level[top++] = 0;
+    }
+    n = 0;
+    while (top > 0)
+    {
+        int t = stack[--top], lev = level[top], len, k;
+        double child_time = 0, pct = 100;
+
+        for (k = first[t]; k < first[t+1]; k++)
+            child_time += table[kids[k]].total_time;
+        if (parent[t] < MACSIO_TIMING_HASH_TABLE_SIZE && table[parent[t]].total_time > 0)
+            pct = 100 * table[t].total_time / table[parent[t]].total_time;
+
+        _strs[n] = (char *) malloc(max_str_size);
+        len = snprintf(_strs[n++], max_str_size,
+            "INCL=%10.5f,EXCL=%10.5f,PCT=%5.1f,CNT=%04d:%*s%s",
+            table[t].total_time, table[t].total_time - child_time, pct, table[t].iter_count,
+            2 * lev, "", table[t].label);
+        if (len > _maxlen) _maxlen = len;
+
+        for (k = first[t+1] - 1; k >= first[t]; k--)
+        {
+            stack[top] = kids[k];
+            level[top++] = lev + 1;
+        }
+    }
+
+    free(level);
+    free(stack);
+    free(kids);
+    free(parent);
+    free(first);
+
+    *strs = _strs;
+    *nstrs = n;
+    *maxlen = _maxlen;
+}
+
+void
+MACSIO_TIMING_DumpTimerTreeToStrings(
+    MACSIO_TIMING_GroupMask_t gmask,
+    char ***strs,
+    int *nstrs,
+    int *maxlen
+)
+{
+    dump_tree_to_strings(timerHashTable, gmask, strs, nstrs, maxlen);
+}
+
+void
+MACSIO_TIMING_DumpReducedTimerTreeToStrings(
+    MACSIO_TIMING_GroupMask_t gmask,
+    char ***strs,
+    int *nstrs,
+    int *maxlen
+)
+{
+    dump_tree_to_strings(reducedTimerTable, gmask, strs, nstrs, maxlen);
+}
+
 void
 MACSIO_TIMING_DumpTimersToStrings(
     MACSIO_TIMING_GroupMask_t gmask,
@@ -690,7 +1330,7 @@ MACSIO_TIMING_DumpTimersToStrings(
     int *maxlen
 )
 {
-    dump_timers_to_strings(timerHashTable, gmask, strs, nstrs, maxlen);
+    dump_timers_to_strings(timerHashTable, timerHists, 0, gmask, strs, nstrs, maxlen);
 }
 
 void MACSIO_TIMING_DumpReducedTimersToStrings(
@@ -700,16 +1340,174 @@ void MACSIO_TIMING_DumpReducedTimersToStrings(
     int *maxlen
 )
 {
-    dump_timers_to_strings(reducedTimerTable, gmask, strs, nstrs, maxlen);
+    dump_timers_to_strings(reducedTimerTable, reducedTimerHists, reducedRankHists, gmask, strs, nstrs, maxlen);
 }
 
 void MACSIO_TIMING_ClearTimers(MACSIO_TIMING_GroupMask_t gmask)
 {
-    clear_timers(timerHashTable, gmask);
-    clear_timers(reducedTimerTable, MACSIO_TIMING_ALL_GROUPS);
+    TIMER_LOCK();
+    timerGeneration++;
+    clear_timers(timerHashTable, timerHists, 0, gmask);
+    clear_timers(reducedTimerTable, reducedTimerHists, reducedRankHists, MACSIO_TIMING_ALL_GROUPS);
+    TIMER_UNLOCK();
 }
 
 double MACSIO_TIMING_GetCurrentTime(void)
 {
     return get_current_time();
 }
+
+void
+MACSIO_TIMING_TraceStart(
+#ifdef HAVE_MPI
+    MPI_Comm comm,
+#else
+    int comm,
+#endif
+    int max_events
+)
+{
+    traceCapacity = max_events > 0 ? (unsigned long long) max_events : 1;
+    traceRing = (traceEvent_t *) calloc(traceCapacity, sizeof(traceEvent_t));
+    traceNext = 0;
+    traceClockOffset = 0;
+
+#ifdef HAVE_MPI
+    /* Estimate each task's clock offset from task 0's by ping-pong, keeping
+       the round trip with least delay */
+    {
+        int const rounds = 8;
+        int rank, size, r, k;
+        double t0, t1, tr, offset, best_rtt;
+
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        if (rank == 0)
+        {
+            for (r = 1; r < size; r++)
+            {
+                best_rtt = DBL_MAX;
+                offset = 0;
+                for (k = 0; k < rounds; k++)
+                {
+                    t0 = get_current_time();
+                    MPI_Send(&t0, 1, MPI_DOUBLE, r, 0, comm);
+                    MPI_Recv(&tr, 1, MPI_DOUBLE, r, 0, comm, MPI_STATUS_IGNORE);
+                    t1 = get_current_time();
+                    if (t1 - t0 < best_rtt)
+                    {
+                        best_rtt = t1 - t0;
+                        offset = tr - (t0 + t1) / 2;
+                    }
+                }
+                MPI_Send(&offset, 1, MPI_DOUBLE, r, 0, comm);
+            }
+        }
+        else
+        {
+            for (k = 0; k < rounds; k++)
+            {
+                MPI_Recv(&t0, 1, MPI_DOUBLE, 0, 0, comm, MPI_STATUS_IGNORE);
+                tr = get_current_time();
+                MPI_Send(&tr, 1, MPI_DOUBLE, 0, 0, comm);
+            }
+            MPI_Recv(&traceClockOffset, 1, MPI_DOUBLE, 0, 0, comm, MPI_STATUS_IGNORE);
+        }
+    }
+#endif
+}
+
+/* Appends string to a JSON string escaping as needed */
+static int json_escaped(char *dst, int n, char const *src)
+{
+    int i = 0;
+
+    for (; *src && i < n - 2; src++)
+    {
+        if (*src == '"' || *src == '\\')
+            dst[i++] = '\\';
+        dst[i++] = (*src >= ' ') ? *src : ' ';
+    }
+    dst[i] = '\0';
+    return i;
+}
+
+void
+MACSIO_TIMING_TraceWrite(
+#ifdef HAVE_MPI
+    MPI_Comm comm,
+#else
+    int comm,
+#endif
+    char const *filename
+)
+{
+    int rank = 0, size = 1, fd;
+    unsigned long long i, first, nevents, len = 0, max, offset = 0;
+    char *buf;
+    char label[2*sizeof(timerHashTable[0].label)], file[2*sizeof(timerHashTable[0].__file__)];
+
+    if (!traceRing) return;
+
+#ifdef HAVE_MPI
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+#endif
+
+    nevents = traceNext < traceCapacity ? traceNext : traceCapacity;
+    first = traceNext - nevents;
+    max = 512 * (nevents + 2);
+    buf = (char *) malloc(max);
+
+    /* Task 0 leads with the file header and every other record with a comma */
+    if (rank == 0)
+        len += snprintf(buf + len, max - len, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"rank 0\"}}");
+    else
+        len += snprintf(buf + len, max - len, ",\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", rank, rank);
+    len += snprintf(buf + len, max - len, ",\n"
+        "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}}", rank, rank);
+
+    for (i = first; i < traceNext; i++)
+    {
+        traceEvent_t const *e = &traceRing[i % traceCapacity];
+        timerInfo_t const *t = &timerHashTable[e->tid];
+
+        json_escaped(label, sizeof(label), t->label);
+        json_escaped(file, sizeof(file), t->__file__);
+        len += snprintf(buf + len, max - len, ",\n"
+            "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"iter\":%d,\"dump\":%d,\"depth\":%d,\"line\":%d}}",
+            label, file, (e->start - traceClockOffset) * 1e6, (e->stop - e->start) * 1e6,
+            rank, e->thread, e->iter, e->dump, e->depth, t->__line__);
+    }
+
+#ifdef HAVE_MPI
+    MPI_Exscan(&len, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) offset = 0;
+#endif
+    if (rank == size - 1)
+        len += snprintf(buf + len, max - len, "\n]}\n");
+
+    /* Each task writes its events at its offset in the shared file */
+    if (rank == 0)
+    {
+        fd = open(filename, O_CREAT|O_WRONLY|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP);
+        if (fd >= 0) close(fd);
+    }
+#ifdef HAVE_MPI
+    MPI_Barrier(comm);
+#endif
+    fd = open(filename, O_WRONLY);
+    if (fd >= 0)
+    {
+        if (pwrite(fd, buf, len, (off_t) offset) != (ssize_t) len)
+            fprintf(stderr, "Unable to write trace file \"%s\"\n", filename);
+        close(fd);
+    }
+
+    free(buf);
+    free(traceRing);
+    traceRing = 0;
+}
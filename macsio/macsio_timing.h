@@ -98,6 +98,27 @@ Used to strip unnecessary path terms from \c __FILE__ in messages
 */
 #define MT_StartTimer(LAB, GMASK, ITER) MACSIO_TIMING_StartTimer(LAB, GMASK, ITER, __BASEFILE__, __LINE__)
 
+/*!
+\def MT_StartTimerCached
+\brief Like \c MT_StartTimer() but caches the timer's id at the call site
+For timers in tight loops. The first call from a site finds the timer's id as
+\c MT_StartTimer() does and keeps it in a static slot. Later calls restart the
+timer by id, skipping hashing and table search, until timers are cleared.
+\c LAB and \c GMASK must be the same on every call from the site.
+\param [in] LAB User defined timer label string
+\param [in] GMASK User defined group mask. Use MACSIO_TIMING_NO_GROUP if timer grouping is not needed.
+\param [in] ITER The iteration number. Use MACSIO_TIMING_ITER_IGNORE if timer iteration is not needed.
+*/
+#if defined(__GNUC__)
+#define MT_StartTimerCached(LAB, GMASK, ITER)                                         \
+({                                                                                     \
+    static MACSIO_TIMING_TimerSite_t _mt_site;                                         \
+    MACSIO_TIMING_StartTimerAtSite(&_mt_site, LAB, GMASK, ITER, __BASEFILE__, __LINE__); \
+})
+#else
+#define MT_StartTimerCached(LAB, GMASK, ITER) MT_StartTimer(LAB, GMASK, ITER)
+#endif
+
 /*!
 \def MT_StopTimer
 \brief Shorthand for \c MACSIO_TIMING_StopTimer()
@@ -108,14 +129,32 @@ Used to strip unnecessary path terms from \c __FILE__ in messages
 typedef unsigned int MACSIO_TIMING_TimerId_t;
 typedef unsigned long long MACSIO_TIMING_GroupMask_t;
 
+/*!
+\brief Call site slot caching a timer's id (see \c MT_StartTimerCached())
+*/
+typedef struct _MACSIO_TIMING_TimerSite_t
+{
+    MACSIO_TIMING_TimerId_t tid; /**< The timer's id */
+    unsigned int generation;     /**< Timer table generation tid is valid for; 0 if none */
+} MACSIO_TIMING_TimerSite_t;
+
 /*!
 \brief Integer variable to control function used to get timer values
 
 A non-zero value indicates that MACSIO_TIMING should use \c MPI_Wtime(). Otherwise, it will
-use \c gettimeofday().
+use \c clock_gettime(CLOCK_MONOTONIC) (or \c gettimeofday() where that is unavailable).
 */
 extern int MACSIO_TIMING_UseMPI_Wtime;
 
+/*!
+\brief Integer variable to control whether timer operations are serialized with a lock
+
+A non-zero value indicates timers may be started and stopped concurrently from more
+than one thread and so access to the timer tables must be serialized. The default is
+zero, no locking.
+*/
+extern int MACSIO_TIMING_UseThreadLock;
+
 /*!
 \brief Create a group name and mask
 
@@ -141,6 +180,21 @@ MACSIO_TIMING_StartTimer(
     char const *file,                /**< The source file name */
     int line                         /**< The source file line number*/);
 
+/*!
+\brief Create/Start a timer whose id is cached at its call site
+
+Use via \c MT_StartTimerCached().
+\return The timer's id, as from \c MACSIO_TIMING_StartTimer()
+*/
+extern MACSIO_TIMING_TimerId_t
+MACSIO_TIMING_StartTimerAtSite(
+    MACSIO_TIMING_TimerSite_t *site, /**< The call site's slot */
+    char const *label,               /**< User defined label to be assigned to the timer */
+    MACSIO_TIMING_GroupMask_t gmask, /**< Mask to indicate the timer's group membership */
+    int iter_num,                    /**< Iteration number */
+    char const *file,                /**< The source file name */
+    int line                         /**< The source file line number*/);
+
 /*!
 \brief Stop a timer
 
@@ -165,11 +219,13 @@ Possible field names are...
   - "min_rank" task rank where minimum time occurred (only valid on reduced timers)
   - "max_rank" task rank where maximum time occurred (only valid on reduced timers)
   - "depth" how deeply this timer is nested within other timers
+  - "parent" id of the timer that was running when this one was first started, or -1
   - "total_time" total time spent in this timer
   - "min_time"  minimum time observed for this timer
   - "max_time"  maximum time observed for this timer
   - "running_mean" current average time for this timer
   - "running_var"  current variance for this timer
+  - "p50", "p90", "p99", "p999" percentiles of iteration times (to within about 4%)
 
 Where applicable, returned values are over either
   - all iterations (when using non-reduced timers)
@@ -216,6 +272,10 @@ separated by colons...
     - (%4.2f) the number of standard deviations of the max from the mean time
     - :%06d task rank where the maximum was observed. (only valid when reduced)
   - DEV=%8.8f standard deviation observed for all iterations of this timer
+  - P50=%8.5f,P90=%8.5f,P99=%8.5f,P999=%8.5f percentiles of the times of all iterations
+    (and ranks when reduced) from a histogram with buckets about 8% wide
+  - TASK_P50=%10.5f,TASK_P99=%10.5f percentiles over ranks of the total time each rank
+    spent in this timer, showing stragglers (only when reduced)
   - FILE=\%s the source file where this timer is triggered
   - LINE=\%d the source line number where this timer is triggered
   - LAB=\%s the user-defined label for this timer
@@ -228,10 +288,50 @@ MACSIO_TIMING_DumpTimersToStrings(
     int *maxlen                      /**< The maximum length of all strings */
 ); 
 
+/*!
+\brief Dump timer call tree to ascii strings
+
+Each timer's parent is the timer that was running, on the same thread, when it was
+first started. This dumps timers matching \c gmask as a tree with each timer's
+children, most costly first, beneath it and indented one more level. Each string
+holds, separated by commas and followed by the indented label...
+
+  - INCL=%10.5f total time spent in this timer (inclusive of its children)
+  - EXCL=%10.5f total time spent in this timer but not its children
+  - PCT=%5.1f inclusive time as a percentage of the parent's
+  - CNT=%04d number of iterations of this timer
+*/
+extern void
+MACSIO_TIMING_DumpTimerTreeToStrings(
+    MACSIO_TIMING_GroupMask_t gmask, /**< Group mask to filter only timers belonging to specific groups */
+    char ***strs,                    /**< Array of strings, one for each timer, returned to caller. Caller must free. */
+    int *nstrs,                      /**< Number of strings returned to caller */
+    int *maxlen                      /**< The maximum length of all strings */
+);
+
+/*!
+\brief Dump reduced timer call tree to ascii strings
+
+Like \c MACSIO_TIMING_DumpTimerTreeToStrings() for reduced timers, where times are
+summed over all tasks.
+*/
+extern void
+MACSIO_TIMING_DumpReducedTimerTreeToStrings(
+    MACSIO_TIMING_GroupMask_t gmask, /**< Group mask to filter only timers belonging to specific groups */
+    char ***strs,                    /**< Array of strings, one for each timer, returned to caller. Caller must free. */
+    int *nstrs,                      /**< Number of strings returned to caller */
+    int *maxlen                      /**< The maximum length of all strings */
+);
+
 /*!
 \brief Reduce timers across MPI tasks
 
-Computes a parallel reduction across MPI tasks of all timers.
+Computes a parallel reduction across MPI tasks of all timers. Tasks first agree,
+with a reduction of the sets of their timers' identity hashes, on which timers
+are live on any task and only those are reduced, matched by hash, so the cost
+depends on the number of timers actually used rather than the size of the timer
+table. A timer need not occupy the same slot of the timer table on every task.
+The reduction is blocking.
 */
 extern void
 MACSIO_TIMING_ReduceTimers(
@@ -268,11 +368,57 @@ MACSIO_TIMING_ClearTimers(
     MACSIO_TIMING_GroupMask_t gmask /**< Group mask to filter only timers belonging to specific groups */
 );
 
+/*!
+\brief Dump number recorded with trace events
+
+Set by main as it begins each dump so trace events can be attributed to dumps.
+It is thread-local. A thread doing a dump for main, such as the thread draining
+an async dump, sets its own to that dump's number.
+*/
+extern __thread int MACSIO_TIMING_TraceDumpNum;
+
+/*!
+\brief Start recording an event trace
+
+From now on, each time a timer stops, its start and stop times, iteration, nesting
+depth and \c MACSIO_TIMING_TraceDumpNum are recorded in a ring buffer of \c max_events
+events. When the buffer is full, the oldest events are overwritten. Recording takes no
+lock. Collective. The offset of each task's clock from task 0's is estimated by
+ping-pong so that events from all tasks can be placed on one timeline.
+*/
+extern void
+MACSIO_TIMING_TraceStart(
+#ifdef HAVE_MPI
+    MPI_Comm comm, /**< The MPI communicator of all tasks to be traced */
+#else
+    int comm,      /**< Dummy value for non-parallel builds */
+#endif
+    int max_events /**< Number of events the ring buffer holds */
+);
+
+/*!
+\brief Write the event trace and stop recording
+
+Writes all tasks' events to a single Chrome trace format (JSON) file that can be
+viewed with Perfetto (ui.perfetto.dev) or chrome://tracing. Each task appears as a
+process and each of its threads as a thread. Timer labels name the events. Times are
+corrected to task 0's clock. Collective. Must precede \c MACSIO_TIMING_ClearTimers().
+*/
+extern void
+MACSIO_TIMING_TraceWrite(
+#ifdef HAVE_MPI
+    MPI_Comm comm,        /**< The MPI communicator passed to MACSIO_TIMING_TraceStart() */
+#else
+    int comm,             /**< Dummy value for non-parallel builds */
+#endif
+    char const *filename  /**< Name of the trace file */
+);
+
 /*!
 \brief Get current time
 
 Depending on current value of \c MACSIO_TIMING_UseMPI_Wtime, uses either
-\c MPI_WTime() or \c gettimeofday().
+\c MPI_WTime() or \c clock_gettime(CLOCK_MONOTONIC).
 */
 extern double
 MACSIO_TIMING_GetCurrentTime(void);
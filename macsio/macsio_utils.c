@@ -26,11 +26,14 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <strings.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include <macsio_log.h>
 #include <macsio_utils.h>
 
 char MACSIO_UTILS_UnitsPrefixSystem[32];
@@ -275,6 +278,104 @@ MACSIO_UTILS_MakeBoundsJsonArray(double const * bounds)
     return bounds_array;
 }
 
+static int extarr_type_size(json_extarr_type etype)
+{
+    switch (etype)
+    {
+        case json_extarr_type_byt08: return 1;
+        case json_extarr_type_int32: return 4;
+        case json_extarr_type_int64: return 8;
+        case json_extarr_type_flt32: return 4;
+        case json_extarr_type_flt64: return 8;
+        default: break;
+    }
+    return 0;
+}
+
+size_t
+MACSIO_UTILS_ExtarrNbytes(json_object *extarr)
+{
+    return (size_t) json_object_extarr_nvals(extarr) *
+        extarr_type_size(json_object_extarr_type(extarr));
+}
+
+/* Bytes of all extarr members anywhere within a json object */
+unsigned long long
+MACSIO_UTILS_ObjectExtarrNbytes(json_object *obj)
+{
+    unsigned long long nbytes = 0;
+    int i;
+
+    if (!obj) return 0;
+
+    switch (json_object_get_type(obj))
+    {
+        case json_type_array:
+            for (i = 0; i < json_object_array_length(obj); i++)
+                nbytes += MACSIO_UTILS_ObjectExtarrNbytes(json_object_array_get_idx(obj, i));
+            break;
+        case json_type_object:
+        {
+            json_object_object_foreach(obj, key, val)
+                nbytes += MACSIO_UTILS_ObjectExtarrNbytes(val);
+            break;
+        }
+        case json_type_extarr:
+            nbytes = MACSIO_UTILS_ExtarrNbytes(obj);
+            break;
+        default: break;
+    }
+
+    return nbytes;
+}
+
+/* Deep copy of a json object including the buffers of any extarr members.
+   The copy shares nothing with the source and so may be handed off to
+   another thread while the source continues to be modified. */
+json_object *
+MACSIO_UTILS_CopyJsonObject(json_object *src)
+{
+    int i;
+
+    if (!src) return 0;
+
+    switch (json_object_get_type(src))
+    {
+        case json_type_boolean: return json_object_new_boolean(json_object_get_boolean(src));
+        case json_type_double:  return json_object_new_double(json_object_get_double(src));
+        case json_type_int:     return json_object_new_int64(json_object_get_int64(src));
+        case json_type_string:  return json_object_new_string(json_object_get_string(src));
+        case json_type_array:
+        {
+            json_object *dst = json_object_new_array();
+            for (i = 0; i < json_object_array_length(src); i++)
+                json_object_array_add(dst, MACSIO_UTILS_CopyJsonObject(json_object_array_get_idx(src, i)));
+            return dst;
+        }
+        case json_type_object:
+        {
+            json_object *dst = json_object_new_object();
+            json_object_object_foreach(src, key, val)
+                json_object_object_add(dst, key, MACSIO_UTILS_CopyJsonObject(val));
+            return dst;
+        }
+        case json_type_extarr:
+        {
+            int dims[32], ndims = json_object_extarr_ndims(src);
+            json_extarr_type etype = json_object_extarr_type(src);
+            size_t nbytes = MACSIO_UTILS_ExtarrNbytes(src);
+            void *buf = malloc(nbytes);
+            memcpy(buf, json_object_extarr_data(src), nbytes);
+            for (i = 0; i < ndims && i < (int) (sizeof(dims)/sizeof(dims[0])); i++)
+                dims[i] = json_object_extarr_dim(src, i);
+            return json_object_new_extarr(buf, etype, ndims, dims, 0);
+        }
+        default: break;
+    }
+
+    return 0;
+}
+
 static char const *print_bytes(double val, char const *_fmt, char *str, int n, char const *_persec)
 {
     char const *persec = _persec ? _persec : "";
@@ -434,38 +535,138 @@ typedef struct s_filegroup {
     int size;
     int total;
     char **names;
+    unsigned long long *stored; /* bytes plugins reported writing to each file */
+    int accounted[MACSIO_UTILS_NUM_PHASES];
+    MACSIO_UTILS_ByteCounts_t counts[MACSIO_UTILS_NUM_PHASES];
 } filegroup;
 
 filegroup* files;
 int filegroup_count = 0;
 
+/* Plugins may account bytes from an async dump thread while main accounts
+   trickle dumps */
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void MACSIO_UTILS_CreateFileStore(int num_dumps, int files_per_dump)
 {
     filegroup_count = num_dumps;
-    files = (filegroup*)malloc(num_dumps * sizeof(filegroup));
+    files = (filegroup*)calloc(num_dumps, sizeof(filegroup));
     for (int i=0; i<num_dumps; i++){
         files[i].size = 0;
         files[i].total = files_per_dump;
         files[i].names = (char**)malloc(files_per_dump*sizeof(char*));
+        files[i].stored = (unsigned long long*)malloc(files_per_dump*sizeof(unsigned long long));
     }
 }
 
-void MACSIO_UTILS_RecordOutputFiles(int dump_num, char *filename)
+static int record_output_file(int dump_num, char const *filename)
 {
-    if (dump_num > filegroup_count) return;
-
     int count = files[dump_num].size;
 
     char *name = (char*) malloc(sizeof(char)*strlen(filename)+1);
     strcpy(name, filename);
 
     if (files[dump_num].size == files[dump_num].total){
-        files[dump_num].names = (char**)realloc(files[dump_num].names, 1.5*files[dump_num].total*sizeof(char*));
-        files[dump_num].total *= 1.5;
+        files[dump_num].total = files[dump_num].total < 2 ? 2 : files[dump_num].total * 1.5;
+        files[dump_num].names = (char**)realloc(files[dump_num].names, files[dump_num].total*sizeof(char*));
+        files[dump_num].stored = (unsigned long long*)realloc(files[dump_num].stored,
+            files[dump_num].total*sizeof(unsigned long long));
     }
 
     files[dump_num].names[count] = name;
+    files[dump_num].stored[count] = 0;
     files[dump_num].size++;
+
+    return count;
+}
+
+void MACSIO_UTILS_RecordOutputFiles(int dump_num, char *filename)
+{
+    if (dump_num < 0 || dump_num >= filegroup_count) return;
+
+    pthread_mutex_lock(&files_lock);
+    record_output_file(dump_num, filename);
+    pthread_mutex_unlock(&files_lock);
+}
+
+/*!
+\brief Account for bytes a plugin wrote
+
+Plugins call this as they write so main can report exactly what was written,
+even when data is compressed or transformed on its way to the file, without
+a stat() of every output file. \c raw and \c meta are the in-memory sizes of
+the bulk data and metadata written and \c stored is what actually landed in
+\c filename. Pass \c stored of 0 if it is simply \c raw + \c meta.
+Calls may be made per dataset, per file or once per dump; counts accumulate.
+Safe to call from an async dump thread.
+
+The miftmpl and HDF5 plugins account their bytes. The Silo, TyphonIO, Exodus
+and PDB plugins do not yet; the libraries they use do not report what they
+stored, so for them main falls back to the sizes of the files it stat()s.
+*/
+void MACSIO_UTILS_AccountBytes(
+    int dump_num,                     /**< [in] dump the bytes belong to (trickle dumps: latest burst dump) */
+    MACSIO_UTILS_BytesPhase_t phase,  /**< [in] burst or trickle */
+    char const *filename,             /**< [in] file written or 0 */
+    char const *dataset,              /**< [in] dataset written or 0, for debug logging only */
+    unsigned long long raw,           /**< [in] bulk data bytes */
+    unsigned long long meta,          /**< [in] metadata bytes */
+    unsigned long long stored         /**< [in] bytes written to the file */
+)
+{
+    filegroup *fg;
+
+    if (dump_num < 0 || dump_num >= filegroup_count) return;
+    if (phase < 0 || phase >= MACSIO_UTILS_NUM_PHASES) return;
+    if (stored == 0)
+        stored = raw + meta;
+
+    pthread_mutex_lock(&files_lock);
+    fg = &files[dump_num];
+    fg->accounted[phase] = 1;
+    fg->counts[phase].raw += raw;
+    fg->counts[phase].meta += meta;
+    fg->counts[phase].stored += stored;
+    if (filename)
+    {
+        int i;
+        /* the file being written is almost always the most recently recorded */
+        for (i = fg->size - 1; i >= 0 && strcmp(fg->names[i], filename); i--);
+        if (i < 0 && phase == MACSIO_UTILS_BURST_PHASE)
+            i = record_output_file(dump_num, filename);
+        if (i >= 0)
+            fg->stored[i] += stored;
+    }
+    pthread_mutex_unlock(&files_lock);
+
+    MACSIO_LOG_MSG(Dbg2, ("Dump %d %s %s: raw %llu, meta %llu, stored %llu bytes", dump_num,
+        filename ? filename : "", dataset ? dataset : "", raw, meta, stored));
+}
+
+/*!
+\brief Bytes accounted for a dump so far on this processor
+
+\return Non-zero if the plugin accounted for any bytes of the dump, in which
+case \c counts holds them. Otherwise \c counts is zeroed.
+*/
+int MACSIO_UTILS_GetAccountedBytes(
+    int dump_num,                     /**< [in] dump to query */
+    MACSIO_UTILS_BytesPhase_t phase,  /**< [in] burst or trickle */
+    MACSIO_UTILS_ByteCounts_t *counts /**< [out] accumulated counts */
+)
+{
+    int accounted = 0;
+
+    memset(counts, 0, sizeof(*counts));
+    if (dump_num < 0 || dump_num >= filegroup_count) return 0;
+    if (phase < 0 || phase >= MACSIO_UTILS_NUM_PHASES) return 0;
+
+    pthread_mutex_lock(&files_lock);
+    accounted = files[dump_num].accounted[phase];
+    *counts = files[dump_num].counts[phase];
+    pthread_mutex_unlock(&files_lock);
+
+    return accounted;
 }
 
 void MACSIO_UTILS_CleanupFileStore()
@@ -475,26 +676,129 @@ void MACSIO_UTILS_CleanupFileStore()
             free(files[i].names[j]);
         }
         free(files[i].names);
+        free(files[i].stored);
     }
     free(files);
+    files = 0;
+    filegroup_count = 0;
+}
+
+static int compare_names(void const *a, void const *b)
+{
+    return strcmp(*(char const * const *) a, *(char const * const *) b);
 }
 
-unsigned long long MACSIO_UTILS_StatFiles(int dump_num)
+/* Sum sizes of the distinct names among n, some possibly repeated */
+static unsigned long long stat_unique_files(char const **names, int n)
 {
-    if (dump_num > filegroup_count) return 0;
+    unsigned long long nbytes = 0;
+    struct stat buf;
 
+    qsort(names, n, sizeof(char const *), compare_names);
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0 && !strcmp(names[i], names[i-1])) continue;
+        if (stat(names[i], &buf)) continue;
+        nbytes += (unsigned long long) buf.st_size;
+    }
+    return nbytes;
+}
+
+/*!
+\brief Total size of the files recorded for a dump, over all tasks
+
+Collective. In MIF modes many tasks record the same file so rather than every
+task stat()ing every file it recorded, names are sent to an owning task
+chosen by hashing the name. Each owner stat()s each distinct file it receives
+just once and the sizes are summed over tasks. Costly on parallel file
+systems nonetheless so main uses this only when plugins do not account for
+bytes themselves.
+
+\return The same total on all tasks
+*/
+unsigned long long MACSIO_UTILS_StatFiles(
+#ifdef HAVE_MPI
+    MPI_Comm comm, /**< [in] Communicator of all tasks that recorded files */
+#else
+    int comm,      /**< [in] Dummy arg (ignored) for MPI communicator */
+#endif
+    int dump_num   /**< [in] Dump whose files to stat */
+)
+{
     unsigned long long dump_bytes = 0;
+    int n = 0;
+    char **names = 0;
 
-    struct stat *buf;
-    buf = (struct stat*)malloc(sizeof(struct stat));
+    if (dump_num >= 0 && dump_num < filegroup_count)
+    {
+        n = files[dump_num].size;
+        names = files[dump_num].names;
+    }
 
-    for (int i=0; i<files[dump_num].size; i++){
-        stat(files[dump_num].names[i], buf);
-        int size = buf->st_size;
-        dump_bytes += size;
-        //printf("%s: %d\n", files[dump_num].names[i], size);
+#ifdef HAVE_MPI
+    {
+        int size, i, nrecv = 0, nnames = 0;
+        int *scounts, *sdispls, *rcounts, *rdispls, *dest;
+        char *sbuf, *rbuf;
+        char const **rnames;
+        unsigned long long local_bytes;
+
+        MPI_Comm_size(comm, &size);
+        scounts = (int *) calloc(4 * size, sizeof(int));
+        sdispls = scounts + size;
+        rcounts = sdispls + size;
+        rdispls = rcounts + size;
+        dest = (int *) malloc((n ? n : 1) * sizeof(int));
+
+        /* pack names, with their terminating nulls, by owning task */
+        for (i = 0; i < n; i++)
+        {
+            dest[i] = (int) (MACSIO_UTILS_BJHash((unsigned char const *) names[i],
+                (unsigned) strlen(names[i]), 0) % (unsigned) size);
+            scounts[dest[i]] += (int) strlen(names[i]) + 1;
+        }
+        for (i = 1; i < size; i++)
+            sdispls[i] = sdispls[i-1] + scounts[i-1];
+        sbuf = (char *) malloc(sdispls[size-1] + scounts[size-1] + 1);
+        for (i = 0; i < n; i++)
+        {
+            size_t len = strlen(names[i]) + 1;
+            memcpy(sbuf + sdispls[dest[i]], names[i], len);
+            sdispls[dest[i]] += (int) len;
+        }
+        for (i = 0; i < size; i++)
+            sdispls[i] -= scounts[i];
 
+        MPI_Alltoall(scounts, 1, MPI_INT, rcounts, 1, MPI_INT, comm);
+        for (i = 0; i < size; i++)
+        {
+            rdispls[i] = nrecv;
+            nrecv += rcounts[i];
+        }
+        rbuf = (char *) malloc(nrecv + 1);
+        MPI_Alltoallv(sbuf, scounts, sdispls, MPI_CHAR, rbuf, rcounts, rdispls, MPI_CHAR, comm);
+
+        rnames = (char const **) malloc((nrecv + 1) * sizeof(char const *));
+        for (i = 0; i < nrecv; i += (int) strlen(rbuf + i) + 1)
+            rnames[nnames++] = rbuf + i;
+        local_bytes = stat_unique_files(rnames, nnames);
+        MPI_Allreduce(&local_bytes, &dump_bytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+        free(rnames);
+        free(rbuf);
+        free(sbuf);
+        free(dest);
+        free(scounts);
     }
-    free(buf);
+#else
+    if (n)
+    {
+        char const **snames = (char const **) malloc(n * sizeof(char const *));
+        memcpy(snames, names, n * sizeof(char const *));
+        dump_bytes = stat_unique_files(snames, n);
+        free(snames);
+    }
+#endif
+
     return dump_bytes;
 }
@@ -26,6 +26,10 @@ this program; if not, write to the Free Software Foundation, Inc., 59 Temple
 Place, Suite 330, Boston, MA 02111-1307 USA
 */
 
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
 #include <json-cwx/json.h>
 
 #ifdef __cplusplus
@@ -91,6 +95,8 @@ extern double MACSIO_UTILS_YDelta(int const *dims, double const *bounds);
 extern double MACSIO_UTILS_ZDelta(int const *dims, double const *bounds);
 extern json_object * MACSIO_UTILS_MakeDimsJsonArray(int ndims, const int *dims);
 extern json_object * MACSIO_UTILS_MakeBoundsJsonArray(double const * bounds);
+extern json_object * MACSIO_UTILS_CopyJsonObject(json_object *src);
+extern size_t MACSIO_UTILS_ExtarrNbytes(json_object *extarr);
 
 extern char const *MACSIO_UTILS_PrintBytes(unsigned long long bytes, char const *fmt, char *str, int n);
 extern char const *MACSIO_UTILS_PrintSeconds(double seconds, char const *fmt, char *str, int n);
@@ -100,7 +106,33 @@ extern char const *MACSIO_UTILS_PrintBandwidth(unsigned long long bytes, double
 extern void MACSIO_UTILS_CreateFileStore(int num_dumps, int files_per_dump);
 extern void MACSIO_UTILS_RecordOutputFiles(int dump_num, char *filename);
 extern void MACSIO_UTILS_CleanupFileStore();
-extern unsigned long long MACSIO_UTILS_StatFiles(int dump_num);
+#ifdef HAVE_MPI
+extern unsigned long long MACSIO_UTILS_StatFiles(MPI_Comm comm, int dump_num);
+#else
+extern unsigned long long MACSIO_UTILS_StatFiles(int comm, int dump_num);
+#endif
+
+/* Bytes plugins account for as they write, per dump and phase */
+typedef enum _MACSIO_UTILS_BytesPhase_t
+{
+    MACSIO_UTILS_BURST_PHASE = 0,
+    MACSIO_UTILS_TRICKLE_PHASE,
+    MACSIO_UTILS_NUM_PHASES
+} MACSIO_UTILS_BytesPhase_t;
+
+typedef struct _MACSIO_UTILS_ByteCounts_t
+{
+    unsigned long long raw;    /* bulk (array) data, as held in memory */
+    unsigned long long meta;   /* metadata, as held in memory */
+    unsigned long long stored; /* bytes actually written to files, after any compression */
+} MACSIO_UTILS_ByteCounts_t;
+
+extern void MACSIO_UTILS_AccountBytes(int dump_num, MACSIO_UTILS_BytesPhase_t phase,
+    char const *filename, char const *dataset,
+    unsigned long long raw, unsigned long long meta, unsigned long long stored);
+extern int MACSIO_UTILS_GetAccountedBytes(int dump_num, MACSIO_UTILS_BytesPhase_t phase,
+    MACSIO_UTILS_ByteCounts_t *counts);
+extern unsigned long long MACSIO_UTILS_ObjectExtarrNbytes(json_object *obj);
 
 #ifdef __cplusplus
 }
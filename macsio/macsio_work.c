@@ -392,8 +392,8 @@ void MACSIO_WORK_LevelThree(double currentDt)
 	    }
 	}
 #ifdef HAVE_MPI
-	MPI_Allreduce ( &my_change, &change, 1, MPI_DOUBLE, MPI_SUM, MACSIO_MAIN_Comm );
-	MPI_Allreduce ( &my_n, &n, 1, MPI_INT, MPI_SUM, MACSIO_MAIN_Comm );
+	MPI_Allreduce ( &my_change, &change, 1, MPI_DOUBLE, MPI_SUM, MACSIO_MAIN_WorkComm );
+	MPI_Allreduce ( &my_n, &n, 1, MPI_INT, MPI_SUM, MACSIO_MAIN_WorkComm );
 #endif
 
 	if ( n != 0 ){
@@ -409,7 +409,7 @@ void MACSIO_WORK_LevelThree(double currentDt)
 #ifdef HAVE_MPI
 	end = MPI_Wtime();
 	wall_time = end-start;
-	MPI_Bcast(&wall_time, 1, MPI_DOUBLE, 0, MACSIO_MAIN_Comm);
+	MPI_Bcast(&wall_time, 1, MPI_DOUBLE, 0, MACSIO_MAIN_WorkComm);
 #endif
     } while (wall_time < currentDt);
 
@@ -435,21 +435,21 @@ void jacobi (int N, double *f, double *u, double *u_new, int *i_min, int *i_max,
 #ifdef HAVE_MPI
     if ( left_proc[MACSIO_MAIN_Rank] >= 0 && left_proc[MACSIO_MAIN_Rank] < MACSIO_MAIN_Size ) {
 	MPI_Irecv ( u + INDEX(i_min[MACSIO_MAIN_Rank] - 1, 1), N, MPI_DOUBLE,
-		left_proc[MACSIO_MAIN_Rank], 0, MACSIO_MAIN_Comm,
+		left_proc[MACSIO_MAIN_Rank], 0, MACSIO_MAIN_WorkComm,
 		request + requests++ );
 
 	MPI_Isend ( u + INDEX(i_min[MACSIO_MAIN_Rank], 1), N, MPI_DOUBLE,
-		left_proc[MACSIO_MAIN_Rank], 1, MACSIO_MAIN_Comm,
+		left_proc[MACSIO_MAIN_Rank], 1, MACSIO_MAIN_WorkComm,
 		request + requests++ );
     }
 
     if ( right_proc[MACSIO_MAIN_Rank] >= 0 && right_proc[MACSIO_MAIN_Rank] < MACSIO_MAIN_Size ) {
 	MPI_Irecv ( u + INDEX(i_max[MACSIO_MAIN_Rank] + 1, 1), N, MPI_DOUBLE,
-		right_proc[MACSIO_MAIN_Rank], 1, MACSIO_MAIN_Comm,
+		right_proc[MACSIO_MAIN_Rank], 1, MACSIO_MAIN_WorkComm,
 		request + requests++ );
 
 	MPI_Isend ( u + INDEX(i_max[MACSIO_MAIN_Rank], 1), N, MPI_DOUBLE,
-		right_proc[MACSIO_MAIN_Rank], 0, MACSIO_MAIN_Comm,
+		right_proc[MACSIO_MAIN_Rank], 0, MACSIO_MAIN_WorkComm,
 		request + requests++ );
     }
 #endif
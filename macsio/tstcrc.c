@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+
+end-of-copyright-header */
+
+/* Test and benchmark of checksums. Checks known answers, that hardware and
+   table driven CRC-32C agree for all lengths and alignments and that
+   checksums computed in pieces match those computed whole. Then reports
+   checksum rates.
+
+   Usage: tstcrc [--size N]
+   where N is the number of MiB checksummed for rates (default 64). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <macsio_crc.h>
+
+static double
+now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1.0e6;
+}
+
+int main(int argc, char **argv)
+{
+    char const *check = "123456789";
+    size_t i, n, size = 64, len;
+    unsigned char *buf;
+    int fails = 0, hw, pass;
+
+    for (i = 1; i < (size_t) argc; i++)
+    {
+        if (!strcmp(argv[i], "--size") && i+1 < (size_t) argc)
+            size = (size_t) atoi(argv[++i]);
+    }
+    len = size << 20;
+    buf = (unsigned char *) malloc(len + 64);
+    for (i = 0; i < len + 64; i++)
+        buf[i] = (unsigned char) ((i * 2654435761u) >> 13);
+
+    /* Known answers */
+    if (MACSIO_CRC_Crc32(check, 9, 0) != 0xCBF43926u)
+    {
+        fprintf(stderr, "crc32 check value wrong\n");
+        fails++;
+    }
+    for (pass = 0; pass < 2; pass++)
+    {
+        hw = MACSIO_CRC_UseHW(pass);
+        if (pass && !hw) break;
+        if (MACSIO_CRC_Crc32c(check, 9, 0) != 0xE3069283u)
+        {
+            fprintf(stderr, "crc32c (%s) check value wrong\n", hw ? "hw" : "sw");
+            fails++;
+        }
+    }
+
+    /* Hardware agrees with tables for all short lengths and alignments and
+       around the interleaved block sizes */
+    for (n = 0; n < 4 * 8192 * 3 + 100; n = n < 1100 ? n + 1 : n * 5 / 4)
+    {
+        for (i = 0; i < 8; i++)
+        {
+            unsigned sw, hwc;
+            MACSIO_CRC_UseHW(0);
+            sw = MACSIO_CRC_Crc32c(buf + i, n, 0);
+            if (!MACSIO_CRC_UseHW(1)) break;
+            hwc = MACSIO_CRC_Crc32c(buf + i, n, 0);
+            if (sw != hwc)
+            {
+                fprintf(stderr, "crc32c hw and sw differ at length %d offset %d\n", (int) n, (int) i);
+                fails++;
+                break;
+            }
+        }
+    }
+
+    /* Pieces */
+    for (pass = 0; pass < 2; pass++)
+    {
+        unsigned whole, pieces = 0, whole32, pieces32 = 0;
+        size_t m = 1 << 20, off;
+
+        hw = MACSIO_CRC_UseHW(pass);
+        whole = MACSIO_CRC_Crc32c(buf, m, 0);
+        whole32 = MACSIO_CRC_Crc32(buf, m, 0);
+        for (off = 0; off < m; off += 1001)
+        {
+            size_t k = m - off < 1001 ? m - off : 1001;
+            pieces = MACSIO_CRC_Crc32c(buf + off, k, pieces);
+            pieces32 = MACSIO_CRC_Crc32(buf + off, k, pieces32);
+        }
+        if (whole != pieces || whole32 != pieces32)
+        {
+            fprintf(stderr, "checksums in pieces differ from whole (%s)\n", hw ? "hw" : "sw");
+            fails++;
+        }
+    }
+
+    /* Rates */
+    printf("%-12s %12s\n", "checksum", "rate (GB/s)");
+    {
+        double t0 = now();
+        MACSIO_CRC_Crc32(buf, len, 0);
+        printf("%-12s %12.2f\n", "crc32 sw", len / (now() - t0) / 1.0e9);
+    }
+    for (pass = 0; pass < 2; pass++)
+    {
+        double t0;
+        hw = MACSIO_CRC_UseHW(pass);
+        if (pass && !hw) break;
+        t0 = now();
+        MACSIO_CRC_Crc32c(buf, len, 0);
+        printf("%-12s %12.2f\n", hw ? "crc32c hw" : "crc32c sw", len / (now() - t0) / 1.0e9);
+    }
+    {
+        double t0 = now();
+        memcpy(buf + len / 2 + 32, buf, len / 2);
+        printf("%-12s %12.2f\n", "memcpy", len / 2 / (now() - t0) / 1.0e9);
+    }
+
+    free(buf);
+
+    return fails ? 1 : 0;
+}
@@ -26,7 +26,10 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 end-of-copyright-header */
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 
 #include <macsio_log.h>
@@ -39,10 +42,31 @@ int MACSIO_MAIN_Rank;
 int MACSIO_MAIN_Size;
 int MACSIO_MAIN_Comm;
 
+#define NTHREADS 4
+#define NTHREAD_MSGS 8
+
+static MACSIO_LOG_LogHandle_t *thread_log;
+static int thread_log_buffered;
+
+/* Each message is built with MACSIO_LOG_MakeMsg on this thread while the others do the same.
+   When buffered, flushes race messages other threads are still formatting. */
+static void *
+log_from_thread(void *arg)
+{
+    int i, t = (int) (long) arg;
+    for (i = 0; i < NTHREAD_MSGS; i++)
+    {
+        MACSIO_LOG_MSGL(thread_log, Info, ("thread %d message %d %0*d", t, i, 40 + t, t));
+        if (thread_log_buffered)
+            MACSIO_LOG_LogFlush(thread_log);
+    }
+    return 0;
+}
+
 int main (int argc, char **argv)
 {
     int i;
-    int rank=0, size=1;
+    int rank=0, size=1, fails=0;
     int num_cols = 128, num_rows = 20, extra_lines = 20;
 #ifdef HAVE_MPI
     MPI_Comm comm = MPI_COMM_WORLD;
@@ -104,10 +128,96 @@ int main (int argc, char **argv)
     MACSIO_LOG_LogFinalize(MACSIO_LOG_StdErr);
     MACSIO_LOG_LogFinalize(MACSIO_LOG_MainLog);
 
+    /* A buffered log, flushed part way through and in the background, must
+       produce exactly the same file as an unbuffered one. Enough messages are
+       issued to wrap around each processor's lines. */
+    {
+        MACSIO_LOG_LogHandle_t *unbuf = MACSIO_LOG_LogInit(comm, "tstlog_unbuf.log", num_cols, num_rows, extra_lines);
+        MACSIO_LOG_LogHandle_t *buf = MACSIO_LOG_LogInit(comm, "tstlog_buf.log", num_cols, num_rows, extra_lines);
+        MACSIO_LOG_LogBuffer(buf, 2);
+        for (i = 0; i < 3 * (num_rows + extra_lines); i++)
+        {
+            MACSIO_LOG_LogMsg(unbuf, "Message %d from rank %d\nwith newline", i, rank);
+            MACSIO_LOG_LogMsg(buf, "Message %d from rank %d\nwith newline", i, rank);
+            if (i == num_rows / 2)
+                MACSIO_LOG_LogFlush(buf);
+        }
+        MACSIO_LOG_LogFinalize(unbuf);
+        MACSIO_LOG_LogFinalize(buf);
+    }
+
+    /* Messages from several threads at once must each land, intact, on their own
+       line, whether written directly or buffered and flushed as they are issued */
+    for (thread_log_buffered = 0; thread_log_buffered < 2; thread_log_buffered++)
+    {
+        int const nlines = NTHREADS * NTHREAD_MSGS + 1, len = 128;
+        int seen[NTHREADS][NTHREAD_MSGS];
+        pthread_t threads[NTHREADS];
+        char line[128];
+        FILE *f;
+
+        memset(seen, 0, sizeof(seen));
+        thread_log = MACSIO_LOG_LogInit(comm, "tstlog_threads.log", len, nlines, 1);
+        if (thread_log_buffered)
+            MACSIO_LOG_LogBuffer(thread_log, 1);
+        for (i = 0; i < NTHREADS; i++)
+            pthread_create(&threads[i], 0, log_from_thread, (void *) (long) i);
+        for (i = 0; i < NTHREADS; i++)
+            pthread_join(threads[i], 0);
+        MACSIO_LOG_LogFinalize(thread_log);
+
+        f = fopen("tstlog_threads.log", "r");
+        fseek(f, (long) (rank * nlines + (rank ? 1 : 0) + 1) * len, SEEK_SET);
+        for (i = 1; i < nlines && fread(line, 1, len, f) == (size_t) len; i++)
+        {
+            char const *p = strstr(line, "thread ");
+            char digits[64];
+            int t, m;
+            if (p && sscanf(p, "thread %d message %d %63[0-9]", &t, &m, digits) == 3 &&
+                t >= 0 && t < NTHREADS && m >= 0 && m < NTHREAD_MSGS && (int) strlen(digits) == 40 + t)
+                seen[t][m]++;
+        }
+        fclose(f);
+#ifdef HAVE_MPI
+        MPI_Barrier(comm); /* all have read the file before it is created again */
+#endif
+        for (i = 0; i < NTHREADS * NTHREAD_MSGS; i++)
+        {
+            if (seen[i / NTHREAD_MSGS][i % NTHREAD_MSGS] != 1)
+            {
+                fprintf(stderr, "%s thread %d message %d logged %d times\n",
+                    thread_log_buffered ? "buffered" : "unbuffered", i / NTHREAD_MSGS,
+                    i % NTHREAD_MSGS, seen[i / NTHREAD_MSGS][i % NTHREAD_MSGS]);
+                fails++;
+            }
+        }
+    }
+
+#ifdef HAVE_MPI
+    MPI_Barrier(comm);
+#endif
+    if (rank == 0)
+    {
+        FILE *fa = fopen("tstlog_unbuf.log", "r"), *fb = fopen("tstlog_buf.log", "r");
+        int ca = 0, cb = 0;
+        while (fa && fb && ca == cb && ca != EOF)
+        {
+            ca = fgetc(fa);
+            cb = fgetc(fb);
+        }
+        if (!fa || !fb || ca != cb)
+        {
+            fprintf(stderr, "buffered log differs from unbuffered log\n");
+            fails++;
+        }
+        if (fa) fclose(fa);
+        if (fb) fclose(fb);
+    }
+
 #ifdef HAVE_MPI
     MPI_Finalize();
 #endif
 
-    return 0;
+    return fails ? 1 : 0;
 
 }
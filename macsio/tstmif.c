@@ -0,0 +1,423 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+
+end-of-copyright-header */
+
+/* Test and benchmark of MIF file writing. For each file count, every task
+   writes its data to its group's file by passing the baton, by aggregating
+   at the group's first task and by passing the baton with the pipeline flag.
+   Checks that all produce the same files and reports the time each takes. Also checks grouping by a map and
+   by node, that baton passing is timed and that calibration writes clean
+   up after themselves.
+
+   Usage: tstmif [--size N] [--reps R]
+   where N is the number of KiB each task writes (default 1024) and R the
+   number of times each is repeated (default 3). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <macsio_mif.h>
+#include <macsio_timing.h>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+static void *CreateFile(const char *fname, const char *nsname, void *udata)
+{
+    (void) nsname;
+    (void) udata;
+    return (void *) fopen(fname, "w");
+}
+
+static void *OpenFile(const char *fname, const char *nsname, MACSIO_MIF_ioFlags_t ioFlags, void *udata)
+{
+    (void) nsname;
+    (void) ioFlags;
+    (void) udata;
+    return (void *) fopen(fname, "a");
+}
+
+static int CloseFile(void *file, void *udata)
+{
+    (void) udata;
+    return fclose((FILE *) file);
+}
+
+static int WriteFile(void *file, void const *buf, size_t len, void *udata)
+{
+    (void) udata;
+    return fwrite(buf, 1, len, (FILE *) file) != len;
+}
+
+static double
+now(void)
+{
+#ifdef HAVE_MPI
+    return MPI_Wtime();
+#else
+    return 0;
+#endif
+}
+
+/* Ways of writing a group's file */
+#define BATON 0
+#define AGGREGATE 1
+#define PIPELINE 2
+static char const *modeNames[] = {"baton", "aggregate", "pipeline"};
+
+/* Checks that this task's data is at offset in the file */
+static int
+data_is_at(char const *fname, unsigned long long offset, char const *buf, size_t len)
+{
+    FILE *f = fopen(fname, "r");
+    char *fbuf = (char *) malloc(len ? len : 1);
+    int ok = f && !fseek(f, (long) offset, SEEK_SET) &&
+        fread(fbuf, 1, len, f) == len && !memcmp(fbuf, buf, len);
+
+    if (f) fclose(f);
+    free(fbuf);
+    return ok;
+}
+
+/* Writes every task's data to its group's file, named by mode and group,
+   by passing the baton, by aggregating or by passing the baton with the
+   pipeline flag and returns the time taken. Counts pipelined offsets that
+   are not where the task's data starts, and pipelined or aggregated offsets
+   that do not point at the task's data in the file, in fails. */
+static double
+write_files(int numFiles, int mode, char const *buf, size_t len,
+#ifdef HAVE_MPI
+    MPI_Comm comm,
+#else
+    int comm,
+#endif
+    int rank, int *fails)
+{
+    MACSIO_MIF_ioFlags_t ioFlags = {MACSIO_MIF_WRITE, 0, mode == PIPELINE};
+    MACSIO_MIF_baton_t *bat = MACSIO_MIF_Init(numFiles, ioFlags, comm, 7,
+        CreateFile, OpenFile, CloseFile, 0);
+    char fname[64];
+    unsigned long long offset;
+    double t0, t;
+
+    snprintf(fname, sizeof(fname), "tstmif_%s_%03d.txt", modeNames[mode],
+        MACSIO_MIF_RankOfGroup(bat, rank));
+
+#ifdef HAVE_MPI
+    MPI_Barrier(comm);
+#endif
+    t0 = now();
+    if (mode == AGGREGATE)
+    {
+        MACSIO_MIF_AggregateWrite(bat, fname, 0, buf, len, WriteFile);
+    }
+    else
+    {
+        FILE *f = (FILE *) MACSIO_MIF_WaitForBaton(bat, fname, 0);
+        fwrite(buf, 1, len, f);
+        if (mode == PIPELINE)
+        {
+            if (MACSIO_MIF_BatonOffset(bat) != len * MACSIO_MIF_RankInGroup(bat, rank))
+            {
+                fprintf(stderr, "baton offset %llu at rank %d in group\n",
+                    MACSIO_MIF_BatonOffset(bat), MACSIO_MIF_RankInGroup(bat, rank));
+                (*fails)++;
+            }
+            MACSIO_MIF_SetBatonOffset(bat, MACSIO_MIF_BatonOffset(bat) + len);
+        }
+        MACSIO_MIF_HandOffBaton(bat, f);
+    }
+#ifdef HAVE_MPI
+    MPI_Barrier(comm);
+#endif
+    t = now() - t0;
+    offset = MACSIO_MIF_BatonOffset(bat);
+    MACSIO_MIF_Finish(bat);
+
+    if (mode != BATON && !data_is_at(fname, offset, buf, len))
+    {
+        fprintf(stderr, "%s data of rank %d not at offset %llu\n",
+            modeNames[mode], rank, offset);
+        (*fails)++;
+    }
+
+    return t;
+}
+
+/* Checks the files of group fileNum written in each mode are the same as
+   that written passing the baton and removes them */
+static int
+compare_files(int fileNum, char const *what)
+{
+    char bname[64];
+    int mode, fails = 0;
+
+    snprintf(bname, sizeof(bname), "tstmif_%s_%03d.txt", modeNames[BATON], fileNum);
+    for (mode = AGGREGATE; mode <= PIPELINE; mode++)
+    {
+        char aname[64];
+        FILE *fa, *fb;
+        int ca = 0, cb = 0;
+
+        snprintf(aname, sizeof(aname), "tstmif_%s_%03d.txt", modeNames[mode], fileNum);
+        fa = fopen(aname, "r");
+        fb = fopen(bname, "r");
+        while (fa && fb && ca == cb && ca != EOF)
+        {
+            ca = fgetc(fa);
+            cb = fgetc(fb);
+        }
+        if (!fa || !fb || ca != cb)
+        {
+            fprintf(stderr, "%s file %d differs from baton file for %s\n", modeNames[mode], fileNum, what);
+            fails++;
+        }
+        if (fa) fclose(fa);
+        if (fb) fclose(fb);
+        remove(aname);
+    }
+    remove(bname);
+
+    return fails;
+}
+
+/* Writes with every mode */
+static void
+write_all_modes(int numFiles, char const *buf, size_t len,
+#ifdef HAVE_MPI
+    MPI_Comm comm,
+#else
+    int comm,
+#endif
+    int rank, int *fails)
+{
+    int mode;
+
+    for (mode = BATON; mode <= PIPELINE; mode++)
+        write_files(numFiles, mode, buf, len, comm, rank, fails);
+}
+
+int main(int argc, char **argv)
+{
+    size_t i, size = 1024, len;
+    int rank = 0, nranks = 1, reps = 3, fails = 0;
+    int numFiles, mode, rep;
+    char *buf;
+#ifdef HAVE_MPI
+    MPI_Comm comm = MPI_COMM_WORLD;
+#else
+    int comm = 0;
+#endif
+
+#ifdef HAVE_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(comm, &nranks);
+    MPI_Comm_rank(comm, &rank);
+#endif
+
+    for (i = 1; i < (size_t) argc; i++)
+    {
+        if (!strcmp(argv[i], "--size") && i+1 < (size_t) argc)
+            size = (size_t) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--reps") && i+1 < (size_t) argc)
+            reps = atoi(argv[++i]);
+    }
+
+    /* Each task's data differs so misordering is caught */
+    len = size << 10;
+    buf = (char *) malloc(len);
+    for (i = 0; i < len; i++)
+        buf[i] = 'a' + (char) ((i / 64 + rank) % 26);
+    for (i = 63; i < len; i += 64)
+        buf[i] = '\n';
+
+    if (rank == 0)
+        printf("%-8s %-10s %12s %12s\n", "files", "mode", "time (s)", "rate (GB/s)");
+
+    for (numFiles = 1; numFiles <= nranks; numFiles = numFiles < nranks && 2 * numFiles > nranks ? nranks : 2 * numFiles)
+    {
+        char what[32];
+
+        for (mode = BATON; mode <= PIPELINE; mode++)
+        {
+            double best = 1e30;
+
+            for (rep = 0; rep < reps; rep++)
+            {
+                double t = write_files(numFiles, mode, buf, len, comm, rank, &fails);
+                if (t < best) best = t;
+            }
+
+            if (rank == 0)
+                printf("%-8d %-10s %12.5f %12.3f\n", numFiles, modeNames[mode],
+                    best, best > 0 ? (double) len * nranks / best / 1.0e9 : 0);
+        }
+
+        /* All modes give the same files */
+        snprintf(what, sizeof(what), "%d files", numFiles);
+        if (rank < numFiles)
+            fails += compare_files(rank, what);
+    }
+
+    /* Baton passing was timed; groups of more than one task wait */
+    {
+        double eff = MACSIO_MIF_SerializationEfficiency(comm);
+        char **strs;
+        int nstrs, maxlen, hold = 0;
+
+        if (eff <= 0 || eff > 1 || (nranks > 1 && eff == 1))
+        {
+            fprintf(stderr, "serialization efficiency %f out of range\n", eff);
+            fails++;
+        }
+        MACSIO_TIMING_DumpTimersToStrings(MACSIO_TIMING_GroupMask("MACSIO_MIF"), &strs, &nstrs, &maxlen);
+        for (i = 0; i < (size_t) nstrs; i++)
+        {
+            if (strstr(strs[i], "LAB=MIF file hold"))
+                hold = 1;
+            free(strs[i]);
+        }
+        free(strs);
+        if (!hold)
+        {
+            fprintf(stderr, "no file hold timer\n");
+            fails++;
+        }
+        if (rank == 0)
+            printf("serialization efficiency %.3f\n", eff);
+    }
+
+    /* The last batons of more than one group had a file per task */
+    {
+        double min_eff, max_eff;
+        int min_group, max_group;
+
+        MACSIO_MIF_GroupSerializationEfficiency(comm, &min_eff, &min_group, &max_eff, &max_group);
+        if (min_eff <= 0 || min_eff > max_eff || max_eff > 1 ||
+            (nranks > 1 && (min_group < 0 || min_group >= nranks || max_group < 0 || max_group >= nranks)))
+        {
+            fprintf(stderr, "group serialization efficiency %f (group %d) to %f (group %d) out of range\n",
+                min_eff, min_group, max_eff, max_group);
+            fails++;
+        }
+        if (rank == 0)
+            printf("group serialization efficiency %.3f (group %d) to %.3f (group %d)\n",
+                min_eff, min_group, max_eff, max_group);
+    }
+
+    /* Interleaved groups from a map; baton passing and aggregation still
+       visit a group's tasks in rank order */
+    {
+        MACSIO_MIF_ioFlags_t ioFlags = {MACSIO_MIF_WRITE, 0, 0};
+        MACSIO_MIF_baton_t *bat;
+        int *targets = (int *) malloc(nranks * sizeof(int));
+        int r, ngroups = nranks < 2 ? nranks : 2;
+
+        for (r = 0; r < nranks; r++)
+            targets[r] = 10 * (r % 2);
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_MAP, 0, targets, comm);
+        free(targets);
+
+        if (MACSIO_MIF_GroupCount(1) != ngroups)
+        {
+            fprintf(stderr, "map gives %d groups rather than %d\n", MACSIO_MIF_GroupCount(1), ngroups);
+            fails++;
+        }
+        bat = MACSIO_MIF_Init(1, ioFlags, comm, 7, CreateFile, OpenFile, CloseFile, 0);
+        for (r = 0; r < nranks; r++)
+        {
+            if (MACSIO_MIF_RankOfGroup(bat, r) != r % 2 || MACSIO_MIF_RankInGroup(bat, r) != r / 2)
+            {
+                fprintf(stderr, "rank %d mapped to group %d rank %d\n", r,
+                    MACSIO_MIF_RankOfGroup(bat, r), MACSIO_MIF_RankInGroup(bat, r));
+                fails++;
+                break;
+            }
+        }
+        MACSIO_MIF_Finish(bat);
+
+        write_all_modes(1, buf, len, comm, rank, &fails);
+        if (rank < ngroups)
+            fails += compare_files(rank, "map grouping");
+    }
+
+    /* Node grouping; one writer per node or as many groups as requested */
+    {
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_NODE, 1, 0, comm);
+        write_all_modes(1, buf, len, comm, rank, &fails);
+        if (rank < MACSIO_MIF_GroupCount(1))
+            fails += compare_files(rank, "node grouping");
+
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_NODE, 0, 0, comm);
+        if (MACSIO_MIF_GroupCount(nranks) > nranks)
+        {
+            fprintf(stderr, "node grouping gives %d groups for %d tasks\n", MACSIO_MIF_GroupCount(nranks), nranks);
+            fails++;
+        }
+        write_all_modes(nranks, buf, len, comm, rank, &fails);
+        if (rank < MACSIO_MIF_GroupCount(nranks))
+            fails += compare_files(rank, "node grouping");
+
+        MACSIO_MIF_SetGrouping(MACSIO_MIF_GROUP_CONTIG, 0, 0, comm);
+    }
+
+    /* Calibration times something and leaves no files behind */
+    {
+        double dt = MACSIO_MIF_TimeFileCount(nranks, comm, 9, "tstmif_calib", buf, len);
+        char fname[64];
+        FILE *f;
+
+        snprintf(fname, sizeof(fname), "tstmif_calib_%05d.mifopt", rank);
+#ifdef HAVE_MPI
+        if (dt <= 0)
+        {
+            fprintf(stderr, "calibration took no time\n");
+            fails++;
+        }
+#endif
+        if ((f = fopen(fname, "r")))
+        {
+            fprintf(stderr, "calibration file %s not removed\n", fname);
+            fclose(f);
+            fails++;
+        }
+    }
+
+    free(buf);
+
+#ifdef HAVE_MPI
+    {
+        int any_fails;
+        MPI_Allreduce(&fails, &any_fails, 1, MPI_INT, MPI_MAX, comm);
+        fails = any_fails;
+    }
+    MPI_Finalize();
+#endif
+
+    return fails ? 1 : 0;
+}
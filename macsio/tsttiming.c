@@ -25,8 +25,19 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 
 end-of-copyright-header */
 
+/* Test of timers, their event trace and their reduction across tasks. Also
+   a benchmark of the reduction, which tasks run with many timers started in a different order
+   on each task so that the timers' slots differ among tasks.
+
+   Usage: tsttiming [--timers N]
+   where N is the number of extra timers on each task (default 1000). */
+
+#include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -70,10 +81,12 @@ void func3()
     MT_StopTimer(tid);
 }
 
+static MACSIO_TIMING_TimerId_t func2_tid;
+
 void func2()
 {
     static int iter = 0;
-    MACSIO_TIMING_TimerId_t tid = MT_StartTimer("func2", MACSIO_TIMING_ALL_GROUPS, iter++);
+    MACSIO_TIMING_TimerId_t tid = func2_tid = MT_StartTimer("func2", MACSIO_TIMING_ALL_GROUPS, iter++);
     dsleep(0.02);
     MT_StopTimer(tid);
 }
@@ -94,12 +107,139 @@ void func1()
     MT_StopTimer(tid);
 }
 
+/* Times an empty loop body with a timer cached at its call site */
+static int cached_timer_loop(int n)
+{
+    int i;
+    MACSIO_TIMING_TimerId_t tid = MACSIO_TIMING_INVALID_TIMER;
+
+    for (i = 0; i < n; i++)
+    {
+        tid = MT_StartTimerCached("cached", MACSIO_TIMING_ALL_GROUPS, i);
+        MT_StopTimer(tid);
+    }
+    return (int) MACSIO_TIMING_GetTimerDatum(tid, "iter_count");
+}
+
+/* Runs n timers, timer k for k%4+1 iterations, starting them in reverse
+   order on odd ranks */
+static void many_timers(int n, int rank, MACSIO_TIMING_TimerId_t *tids)
+{
+    int i, q;
+
+    for (i = 0; i < n; i++)
+    {
+        char label[32];
+        int k = rank % 2 ? n - 1 - i : i;
+        snprintf(label, sizeof(label), "timer %d", k);
+        for (q = 0; q <= k % 4; q++)
+        {
+            tids[k] = MT_StartTimer(label, MACSIO_TIMING_ALL_GROUPS, q);
+            MT_StopTimer(tids[k]);
+        }
+    }
+}
+
+/* Times something on another thread doing dump 7 */
+static void *dump_7_thread(void *arg)
+{
+    MACSIO_TIMING_TraceDumpNum = 7;
+    MT_StopTimer(MT_StartTimer("on dump 7 thread", MACSIO_TIMING_ALL_GROUPS, 0));
+    return 0;
+}
+
+/* Skips a JSON value, returning where it ends or 0 if it is malformed */
+static char const *json_value_end(char const *p)
+{
+    while (isspace(*p)) p++;
+    if (*p == '{' || *p == '[')
+    {
+        char close = *p == '{' ? '}' : ']';
+        int key = *p == '{';
+
+        for (p++; isspace(*p); p++);
+        if (*p == close) return p + 1;
+        for (;;)
+        {
+            if (key)
+            {
+                for (; isspace(*p); p++);
+                if (*p != '"' || !(p = json_value_end(p))) return 0;
+                for (; isspace(*p); p++);
+                if (*p++ != ':') return 0;
+            }
+            if (!(p = json_value_end(p))) return 0;
+            for (; isspace(*p); p++);
+            if (*p == close) return p + 1;
+            if (*p++ != ',') return 0;
+        }
+    }
+    if (*p == '"')
+    {
+        for (p++; *p && *p != '"'; p++)
+            if (*p == '\\' && !*++p) return 0;
+        return *p ? p + 1 : 0;
+    }
+    if (!strncmp(p, "true", 4) || !strncmp(p, "null", 4)) return p + 4;
+    if (!strncmp(p, "false", 5)) return p + 5;
+    {
+        char *end;
+        strtod(p, &end);
+        return end != p ? end : 0;
+    }
+}
+
+/* Checks the trace file is JSON with the events of each thread's dump */
+static int check_trace(char const *filename)
+{
+    FILE *f = fopen(filename, "r");
+    char *buf;
+    char const *end;
+    long n;
+    int fails = 0;
+
+    if (!f)
+    {
+        fprintf(stderr, "trace file \"%s\" not written\n", filename);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (char *) calloc(n + 1, 1);
+    n = (long) fread(buf, 1, n, f);
+    fclose(f);
+
+    end = json_value_end(buf);
+    while (end && isspace(*end)) end++;
+    if (!end || *end)
+    {
+        fprintf(stderr, "trace file \"%s\" is not valid JSON\n", filename);
+        fails++;
+    }
+    if (!strstr(buf, "\"name\":\"main\"") || !strstr(buf, "\"dump\":5,"))
+    {
+        fprintf(stderr, "trace is missing the main thread's events\n");
+        fails++;
+    }
+    if (!strstr(buf, "\"name\":\"on dump 7 thread\"") || !strstr(buf, "\"dump\":7,") ||
+        strstr(buf, "\"dump\":-1,"))
+    {
+        fprintf(stderr, "trace event of another thread has the wrong dump\n");
+        fails++;
+    }
+    free(buf);
+    return fails;
+}
+
 int main(int argc, char **argv)
 {
-    int i, rank = 0, size = 1;
+    int i, rank = 0, size = 1, ntimers = 1000;
+    MACSIO_TIMING_TimerId_t *tids;
     MACSIO_TIMING_TimerId_t a, b;
     char **timer_strs;
     int ntimer_strs, maxstrlen;
+    int fails = 0;
 
 #ifdef HAVE_MPI
     MPI_Init(&argc, &argv);
@@ -107,9 +247,27 @@ int main(int argc, char **argv)
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 #endif
 
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--timers") && i+1 < argc)
+            ntimers = atoi(argv[++i]);
+    }
+
     MACSIO_LOG_DebugLevel = 1; /* should only see debug messages level 1 and 2 */
     srandom(0xDeadBeef); /* used to vary length of some timers */
 
+#ifdef HAVE_MPI
+    MACSIO_TIMING_TraceStart(MPI_COMM_WORLD, 4 * ntimers + 10000);
+#else
+    MACSIO_TIMING_TraceStart(0, 4 * ntimers + 10000);
+#endif
+    MACSIO_TIMING_TraceDumpNum = 5;
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, dump_7_thread, 0) == 0)
+            pthread_join(thread, 0);
+    }
+
     if (size > 8)
     {
         if (!rank)
@@ -136,13 +294,61 @@ int main(int argc, char **argv)
 
     MT_StopTimer(a);
 
+    if (rank == 1)
+        MT_StopTimer(MT_StartTimer("only on rank 1", MACSIO_TIMING_ALL_GROUPS, 0));
+
+    if (cached_timer_loop(1000) != 1000)
+    {
+        fprintf(stderr, "cached timer miscounted iterations\n");
+        fails++;
+    }
+
+    /* percentiles are ordered and lie within the range of times seen */
+    {
+        double p50 = MACSIO_TIMING_GetTimerDatum(func2_tid, "p50");
+        double p99 = MACSIO_TIMING_GetTimerDatum(func2_tid, "p99");
+        if (p50 < MACSIO_TIMING_GetTimerDatum(func2_tid, "min_time") || p50 > p99 ||
+            p99 > MACSIO_TIMING_GetTimerDatum(func2_tid, "max_time") ||
+            MACSIO_TIMING_GetTimerDatum(a, "p50") != MACSIO_TIMING_GetTimerDatum(a, "max_time"))
+        {
+            fprintf(stderr, "timer percentiles out of range\n");
+            fails++;
+        }
+    }
+
+    /* func2 is only ever called from within func1, itself within main */
+    if (MACSIO_TIMING_GetTimerDatum(func2_tid, "parent") < 0 ||
+        MACSIO_TIMING_GetTimerDatum(func2_tid, "depth") != 2)
+    {
+        fprintf(stderr, "func2 timer not nested in func1\n");
+        fails++;
+    }
+
+    /* the call tree holds every timer once */
+    {
+        int ntree;
+        MACSIO_TIMING_DumpTimersToStrings(MACSIO_TIMING_ALL_GROUPS, &timer_strs, &ntimer_strs, &maxstrlen);
+        for (i = 0; i < ntimer_strs; i++)
+            free(timer_strs[i]);
+        free(timer_strs);
+        MACSIO_TIMING_DumpTimerTreeToStrings(MACSIO_TIMING_ALL_GROUPS, &timer_strs, &ntree, &maxstrlen);
+        for (i = 0; i < ntree; i++)
+            free(timer_strs[i]);
+        free(timer_strs);
+        if (ntree != ntimer_strs)
+        {
+            fprintf(stderr, "timer tree has %d timers, expected %d\n", ntree, ntimer_strs);
+            fails++;
+        }
+    }
+
     MACSIO_TIMING_DumpTimersToStrings(MACSIO_TIMING_ALL_GROUPS, &timer_strs, &ntimer_strs, &maxstrlen);
 
 #ifdef HAVE_MPI
     {
         int rbuf[2], sbuf[2] = {ntimer_strs, maxstrlen};
         MPI_Allreduce(sbuf, rbuf, 2, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-        MACSIO_LOG_MainLog = MACSIO_LOG_LogInit(MPI_COMM_WORLD, "tsttiming.log", rbuf[1]+32, 2*rbuf[0]+4,0);
+        MACSIO_LOG_MainLog = MACSIO_LOG_LogInit(MPI_COMM_WORLD, "tsttiming.log", rbuf[1]+32, 2*(rbuf[0]+ntimers)+8, 0);
     }
 #else
     MACSIO_LOG_MainLog = MACSIO_LOG_LogInit(0, "tsttiming.log", maxstrlen+4, ntimer_strs+4, 0);
@@ -156,27 +362,83 @@ int main(int argc, char **argv)
     free(timer_strs);
 
 #ifdef HAVE_MPI
-    MACSIO_TIMING_ReduceTimers(MPI_COMM_WORLD, 0);
+    tids = (MACSIO_TIMING_TimerId_t *) malloc((ntimers + 1) * sizeof(MACSIO_TIMING_TimerId_t));
+    many_timers(ntimers, rank, tids);
+    {
+        double t0 = MPI_Wtime(), dt;
+        MACSIO_TIMING_ReduceTimers(MPI_COMM_WORLD, 0);
+        dt = MPI_Wtime() - t0;
+        MPI_Allreduce(MPI_IN_PLACE, &dt, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        if (!rank)
+            printf("reduced %d timers over %d tasks in %g seconds\n", ntimers, size, dt);
+    }
     if (!rank)
     {
+        int only_on_1 = 0;
+
+        /* timers are matched among tasks whatever their slots */
+        for (i = 0; i < ntimers; i++)
+        {
+            if (MACSIO_TIMING_GetReducedTimerDatum(tids[i], "iter_count") != size * (i % 4 + 1))
+            {
+                fprintf(stderr, "reduced \"timer %d\" has wrong iteration count\n", i);
+                fails++;
+                break;
+            }
+        }
+
+        /* parents are reduced by identity, not by a task's slot numbers */
+        if (MACSIO_TIMING_GetReducedTimerDatum(func2_tid, "parent") !=
+            MACSIO_TIMING_GetTimerDatum(func2_tid, "parent"))
+        {
+            fprintf(stderr, "reduced func2 timer not nested in func1\n");
+            fails++;
+        }
+
         MACSIO_TIMING_DumpReducedTimersToStrings(MACSIO_TIMING_ALL_GROUPS, &timer_strs, &ntimer_strs, &maxstrlen);
         MACSIO_LOG_MSG(Dbg1, ("#####################Reduced Timer Values######################"));
         for (i = 0; i < ntimer_strs; i++)
         {
+            if (strstr(timer_strs[i], "only on rank 1"))
+                only_on_1 = 1;
             MACSIO_LOG_MSG(Dbg1, (timer_strs[i]));
             free(timer_strs[i]);
         }
         free(timer_strs);
+
+        /* a timer not run on the root is reduced too */
+        if (size > 1 && !only_on_1)
+        {
+            fprintf(stderr, "timer run only on rank 1 missing from reduced timers\n");
+            fails++;
+        }
     }
+    free(tids);
+#endif
+
+#ifdef HAVE_MPI
+    MACSIO_TIMING_TraceWrite(MPI_COMM_WORLD, "tsttiming_trace.json");
+    MPI_Barrier(MPI_COMM_WORLD);
+#else
+    MACSIO_TIMING_TraceWrite(0, "tsttiming_trace.json");
 #endif
+    if (!rank)
+        fails += check_trace("tsttiming_trace.json");
 
     MACSIO_LOG_LogFinalize(MACSIO_LOG_MainLog);
 
     MACSIO_TIMING_ClearTimers(MACSIO_TIMING_ALL_GROUPS);
 
+    /* clearing timers must invalidate the cached id */
+    if (cached_timer_loop(10) != 10)
+    {
+        fprintf(stderr, "cached timer not reset by clearing timers\n");
+        fails++;
+    }
+
 #ifdef HAVE_MPI
     MPI_Finalize();
 #endif
 
-    return 0;
+    return fails ? 1 : 0;
 }
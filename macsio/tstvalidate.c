@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+
+end-of-copyright-header */
+
+
+/* Test of checksum validation. Generates a problem, checks that its parts
+   validate unchanged, that one corrupted byte is caught and that lazy
+   variables are skipped.
+
+   Usage: tstvalidate */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#include <json-cwx/json.h>
+
+#include <macsio_data.h>
+#include <macsio_log.h>
+
+/* The data of the first variable of a problem's part */
+static json_object *
+var_data(json_object *problem_obj, int part)
+{
+    json_object *parts = json_object_path_get_array(problem_obj, "parts");
+    json_object *vars = json_object_path_get_array(json_object_array_get_idx(parts, part), "Vars");
+
+    return json_object_path_get_extarr(json_object_array_get_idx(vars, 0), "data");
+}
+
+/* A main object for one task with two small 2D parts */
+static json_object *
+make_main_obj(int lazy_vars)
+{
+    json_object *main_obj = json_object_new_object();
+    json_object *parallel = json_object_new_object();
+    json_object *clargs = json_object_new_object();
+
+    json_object_object_add(parallel, "mpi_size", json_object_new_int(1));
+    json_object_object_add(parallel, "mpi_rank", json_object_new_int(0));
+    json_object_object_add(main_obj, "parallel", parallel);
+
+    json_object_object_add(clargs, "part_size", json_object_new_int(8000));
+    json_object_object_add(clargs, "avg_num_parts", json_object_new_double(2));
+    json_object_object_add(clargs, "part_dim", json_object_new_int(2));
+    json_object_object_add(clargs, "part_type", json_object_new_string("rectilinear"));
+    json_object_object_add(clargs, "part_distribution", json_object_new_string("uniform"));
+    json_object_object_add(clargs, "vars_per_part", json_object_new_int(4));
+    json_object_object_add(clargs, "time_randomize", json_object_new_int(0));
+    json_object_object_add(clargs, "lazy_vars", json_object_new_int(lazy_vars));
+    json_object_object_add(main_obj, "clargs", clargs);
+
+    return main_obj;
+}
+
+int main(int argc, char **argv)
+{
+    json_object *main_obj, *problem_obj, *data_obj;
+    unsigned char *data;
+    int fails = 0, nbad;
+#ifdef HAVE_MPI
+    MPI_Comm comm = MPI_COMM_SELF;
+
+    MPI_Init(&argc, &argv);
+#else
+    int comm = 0;
+#endif
+
+    /* Mismatches are logged */
+    MACSIO_LOG_MainLog = MACSIO_LOG_LogInit(comm, 0, 0, 0, 0);
+    MACSIO_DATA_InitializeDefaultPRNGs(0, 0);
+
+    /* Generated parts validate unchanged */
+    main_obj = make_main_obj(0);
+    problem_obj = MACSIO_DATA_GenerateTimeZeroDumpObject(main_obj, 0);
+    if (json_object_array_length(json_object_path_get_array(problem_obj, "parts")) != 2)
+    {
+        fprintf(stderr, "expected 2 parts\n");
+        fails++;
+    }
+    if ((nbad = MACSIO_DATA_ValidateDataRead(problem_obj)) != 0)
+    {
+        fprintf(stderr, "%d arrays of unchanged parts failed validation\n", nbad);
+        fails++;
+    }
+
+    /* One corrupted byte fails validation and only that array fails */
+    data_obj = var_data(problem_obj, 1);
+    data = data_obj ? (unsigned char *) json_object_extarr_data(data_obj) : 0;
+    if (!data)
+    {
+        fprintf(stderr, "no data in second part's first variable\n");
+        fails++;
+    }
+    else
+    {
+        data[json_object_extarr_nbytes(data_obj) / 2] ^= 0x10;
+        if ((nbad = MACSIO_DATA_ValidateDataRead(problem_obj)) != 1)
+        {
+            fprintf(stderr, "%d arrays failed validation after corrupting one byte\n", nbad);
+            fails++;
+        }
+        data[json_object_extarr_nbytes(data_obj) / 2] ^= 0x10;
+        if ((nbad = MACSIO_DATA_ValidateDataRead(problem_obj)) != 0)
+        {
+            fprintf(stderr, "%d arrays failed validation after restoring the byte\n", nbad);
+            fails++;
+        }
+    }
+    json_object_put(problem_obj);
+    json_object_put(main_obj);
+
+    /* Lazy variables have nothing to validate */
+    main_obj = make_main_obj(1);
+    problem_obj = MACSIO_DATA_GenerateTimeZeroDumpObject(main_obj, 0);
+    if (var_data(problem_obj, 0))
+    {
+        fprintf(stderr, "lazy variable has data\n");
+        fails++;
+    }
+    if ((nbad = MACSIO_DATA_ValidateDataRead(problem_obj)) != 0)
+    {
+        fprintf(stderr, "%d arrays of parts with lazy variables failed validation\n", nbad);
+        fails++;
+    }
+    json_object_put(problem_obj);
+    json_object_put(main_obj);
+
+    MACSIO_DATA_FinalizeDefaultPRNGs();
+    MACSIO_LOG_LogFinalize(MACSIO_LOG_MainLog);
+#ifdef HAVE_MPI
+    MPI_Finalize();
+#endif
+
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+Produced at the Lawrence Livermore National Laboratory.
+Written by Mark C. Miller
+
+LLNL-CODE-676051. All rights reserved.
+
+This file is part of MACSio
+
+Please also read the LICENSE file at the top of the source code directory or
+folder hierarchy.
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License (as published by the Free Software
+Foundation) version 2, dated June 1991.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place, Suite 330, Boston, MA 02111-1307 USA
+
+end-of-copyright-header */
+
+/* Test and benchmark of variable generation. Compares values and element
+   rates of the per-kind generation kernels against a per-element reference
+   that matches kinds by name for every element (the original method) and
+   against generating the same values in chunks. Then compares each
+   instruction set variant of the noise generator with the scalar one.
+
+   Usage: tstvargen [--size N] [--iters M]
+   where N is the number of nodes in each of 3 dimensions (default 32). */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#include <macsio_data.h>
+#include <macsio_noise.h>
+#include <macsio_utils.h>
+
+static double
+now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1.0e6;
+}
+
+/* The original, per-element method (noise kinds omitted) */
+static void
+reference_fill(char const *kind, int const *dims, double const *bounds,
+    int const *dims2, MACSIO_DATA_CBPRNGKey_t const *key, void *vals)
+{
+    double *valdp = (double *) vals;
+    int    *valip = (int *) vals;
+    int i, j, k, n = 0;
+
+    for (k = 0; k < dims2[2]; k++)
+    {
+        for (j = 0; j < dims2[1]; j++)
+        {
+            for (i = 0; i < dims2[0]; i++)
+            {
+                if (strstr(kind, "constant")!=NULL)
+                    valdp[n++] = 1.0;
+                else if (strstr(kind, "random")!=NULL)
+                {
+                    valdp[n] = (double) (MACSIO_DATA_CBPRNGGetVal(key, n) % 1000) / 1000;
+                    n++;
+                }
+                else if (strstr(kind, "xramp")!=NULL)
+                    valdp[n++] = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
+                else if (strstr(kind, "spherical")!=NULL)
+                {
+                    double x = bounds[0] + i * MACSIO_UTILS_XDelta(dims, bounds);
+                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
+                    double z = bounds[2] + k * MACSIO_UTILS_ZDelta(dims, bounds);
+                    valdp[n++] = sqrt(x*x+y*y+z*z);
+                }
+                else if (strstr(kind, "ysin")!=NULL)
+                {
+                    double y = bounds[1] + j * MACSIO_UTILS_YDelta(dims, bounds);
+                    valdp[n++] = sin(y*3.1415266);
+                }
+                else if (strstr(kind, "xlayers")!=NULL)
+                {
+                    valip[n++] = (i / 20) % 3;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char const *kinds[] = {"constant","random","xramp","spherical","ysin","xlayers","noise","noise_sum"};
+    int const has_reference[] = {1,1,1,1,1,1,0,0};
+    int i, q, size = 32, iters = 1, fails = 0;
+    int dims[3], dims2[3];
+    double bounds[6];
+    long long nvals;
+    void *vals, *refvals;
+    MACSIO_DATA_CBPRNGKey_t key;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--size") && i+1 < argc)
+            size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--iters") && i+1 < argc)
+            iters = atoi(argv[++i]);
+    }
+
+    MACSIO_DATA_InitializeDefaultPRNGs(0, 0);
+    key = MACSIO_DATA_CBPRNGKey(0, 17, 1);
+
+    MACSIO_UTILS_SetDims(dims, size, size, size);
+    MACSIO_UTILS_SetBounds(bounds, 0, 0, 0, 1, 1, 1);
+    for (i = 0; i < 3; i++)
+        dims2[i] = dims[i] - 1; /* zone centered */
+    nvals = (long long) dims2[0] * dims2[1] * dims2[2];
+    vals = malloc(nvals * sizeof(double));
+    refvals = malloc(nvals * sizeof(double));
+
+    printf("%-10s %14s %14s %8s\n", "kind", "ref (Mel/s)", "kernel (Mel/s)", "speedup");
+    for (i = 0; i < (int) (sizeof(kinds)/sizeof(kinds[0])); i++)
+    {
+        double t0, dt_ref = 0, dt_ker;
+        long long n;
+        size_t vsize = strcmp(kinds[i], "xlayers") ? sizeof(double) : sizeof(int);
+
+        if (has_reference[i])
+        {
+            t0 = now();
+            for (q = 0; q < iters; q++)
+                reference_fill(kinds[i], dims, bounds, dims2, &key, refvals);
+            dt_ref = now() - t0;
+        }
+
+        t0 = now();
+        for (q = 0; q < iters; q++)
+            MACSIO_DATA_FillScalarVar(kinds[i], 3, dims, bounds, dims2, &key, vals);
+        dt_ker = now() - t0;
+
+        if (has_reference[i] && memcmp(vals, refvals, nvals * vsize))
+        {
+            fprintf(stderr, "%s: kernel values differ from reference\n", kinds[i]);
+            fails++;
+        }
+
+        /* Generating in odd sized chunks must give the same values */
+        for (n = 0; n < nvals; n += 1000)
+            MACSIO_DATA_FillScalarVarRange(kinds[i], 3, dims, bounds, dims2, &key,
+                n, nvals - n < 1000 ? nvals - n : 1000, (char *) refvals + n * vsize);
+        if (memcmp(vals, refvals, nvals * vsize))
+        {
+            fprintf(stderr, "%s: chunked values differ from whole\n", kinds[i]);
+            fails++;
+        }
+
+        if (has_reference[i])
+            printf("%-10s %14.2f %14.2f %8.2f\n", kinds[i],
+                nvals * iters / dt_ref / 1.0e6, nvals * iters / dt_ker / 1.0e6, dt_ref / dt_ker);
+        else
+            printf("%-10s %14s %14.2f %8s\n", kinds[i], "-",
+                nvals * iters / dt_ker / 1.0e6, "-");
+    }
+
+    /* Noise generator variants (rows of the same zone centered grid) */
+    printf("\n%-10s %14s %10s\n", "noise isa", "rate (Mel/s)", "max diff");
+    for (i = MACSIO_NOISE_SCALAR; i <= MACSIO_NOISE_AVX512; i++)
+    {
+        double t0, dt, maxdiff = 0;
+        double *nv = (double *) vals, *rv = (double *) refvals;
+        long long n, rowlen = dims2[0], nrows = nvals / dims2[0];
+        MACSIO_NOISE_ISA_t isa = MACSIO_NOISE_SetISA((MACSIO_NOISE_ISA_t) i);
+
+        if ((int) isa != i) continue; /* not supported on this cpu */
+
+        t0 = now();
+        for (q = 0; q < iters; q++)
+            for (n = 0; n < nrows; n++)
+                MACSIO_NOISE_Simplex3Row(0.1, 1.0/size, 0, n % dims2[1] * 0.7 / size, n / dims2[1] * 1.3 / size,
+                    rowlen, nv + n * rowlen);
+        dt = now() - t0;
+
+        for (n = 0; n < nvals; n++)
+        {
+            if (isa == MACSIO_NOISE_SCALAR)
+                rv[n] = nv[n];
+            else if (fabs(nv[n] - rv[n]) > maxdiff)
+                maxdiff = fabs(nv[n] - rv[n]);
+            if (fabs(nv[n]) > 1.1)
+                maxdiff = fabs(nv[n]);
+        }
+        if (maxdiff > 1.0e-12)
+        {
+            fprintf(stderr, "noise %s: values differ from scalar or out of range\n", MACSIO_NOISE_ISAName(isa));
+            fails++;
+        }
+
+        printf("%-10s %14.2f %10.2g\n", MACSIO_NOISE_ISAName(isa), nvals * iters / dt / 1.0e6, maxdiff);
+    }
+
+    free(vals);
+    free(refvals);
+    MACSIO_DATA_FinalizeDefaultPRNGs();
+
+    return fails ? 1 : 0;
+}
@@ -83,6 +83,8 @@ typedef struct _ex_global_init_params {
     double dumpt;
 } ex_global_init_params_t;
 
+static int args_processed = 0;
+
 static int process_args(int argi, int argc, char *argv[])
 {
     const MACSIO_CLARGS_ArgvFlags_t argFlags = {
@@ -540,7 +542,11 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj, in
     mpi_errno = MPI_Barrier(MACSIO_MAIN_Comm);
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
 
     rank = JsonGetInt(main_obj, "parallel/mpi_rank");
     size = JsonGetInt(main_obj, "parallel/mpi_size");
@@ -556,9 +562,10 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj, in
         {
             MACSIO_LOG_MSG(Die, ("Exodus plugin doesn't support SIF mode"));
         }
-        else if (modestr && strcmp(json_object_get_string(modestr), "MIFMAX"))
+        else if (!modestr || strcmp(json_object_get_string(modestr), "MIF") ||
+                 json_object_get_int(filecnt) != size)
         {
-            MACSIO_LOG_MSG(Warn, ("Exodus plugin supports only MIFMAX mode"));
+            MACSIO_LOG_MSG(Warn, ("Exodus plugin supports only one file per processor, using %d files", size));
         }
         numGroups = size;
     }
@@ -635,6 +642,8 @@ static int register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long",iface_name));
 
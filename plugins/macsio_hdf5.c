@@ -33,6 +33,7 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 #include <json-cwx/json.h>
 
 #include <macsio_clargs.h>
+#include <macsio_data.h>
 #include <macsio_iface.h>
 #include <macsio_log.h>
 #include <macsio_main.h>
@@ -107,6 +108,7 @@ static hid_t dspc = -1;
 static int show_errors = 0;
 static char compression_alg_str[64];
 static char compression_params_str[512];
+static int args_processed = 0; /**< plugin args have been processed */
 
 /*! \brief create HDF5 library file access property list */
 static hid_t make_fapl()
@@ -475,6 +477,32 @@ process_args(
     return 0;
 }
 
+/*!
+\brief Number of parts each rank writes per variable in SIF mode
+
+Each variable is one global dataset so every part must have its nominal size.
+Variable names and types are taken from a rank's first part so every rank must
+own at least one. Ranks owning fewer than the most parts of any rank make empty
+H5Dwrite calls to match the others.
+*/
+static int
+sif_part_count(
+    json_object *main_obj /**< main json data object to dump */
+)
+{
+    int min_parts, max_parts;
+
+    MACSIO_DATA_GetPartCountRange(main_obj, &min_parts, &max_parts);
+    if (!MACSIO_DATA_PartSizesAreUniform(main_obj))
+        MACSIO_LOG_MSG(Die, ("HDF5 plugin cannot currently handle SIF mode where "
+            "parts differ in size. Use a MIF mode or remove the size multipliers "
+            "of --part_map and --part_distribution."));
+    if (min_parts < 1)
+        MACSIO_LOG_MSG(Die, ("HDF5 plugin cannot currently handle SIF mode where "
+            "some MPI ranks own no parts. Use a MIF mode or give every rank a part."));
+    return max_parts;
+}
+
 /*! \brief Single shared file implementation of main dump */
 static void
 main_dump_sif(
@@ -493,6 +521,7 @@ main_dump_sif(
     char const *mesh_type = json_object_path_get_string(main_obj, "clargs/part_type");
     char fileName[256];
     int use_part_count;
+    unsigned long long raw_bytes;
 
     hid_t h5file_id;
     hid_t fapl_id = make_fapl();
@@ -520,6 +549,8 @@ main_dump_sif(
         dumpn,
         json_object_path_get_string(main_obj, "clargs/fileext"));
 
+    use_part_count = sif_part_count(main_obj);
+
     MACSIO_UTILS_RecordOutputFiles(dumpn, fileName);
     main_dump_sif_tid = MT_StartTimer("H5Fcreate", main_dump_sif_grp, dumpn);
     h5file_id = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id);
@@ -579,7 +610,7 @@ main_dump_sif(
         /* Create the file dataset (using old-style H5Dcreate API here) */
 //#warning USING DEFAULT DCPL: LATER ADD COMPRESSION, ETC.
         
-        main_dump_sif_tid = MT_StartTimer("H5Dcreate", main_dump_sif_grp, dumpn);
+        main_dump_sif_tid = MT_StartTimerCached("H5Dcreate", main_dump_sif_grp, dumpn);
         hid_t ds_id = H5Dcreate1(h5file_id, varName, dtype_id, fspace_id, dcpl_id); 
         timer_dt = MT_StopTimer(main_dump_sif_tid);
         H5Sclose(fspace_id);
@@ -587,7 +618,7 @@ main_dump_sif(
 
         /* Loop to make write calls for this var for each part on this rank */
 //#warning USE NEW MULTI-DATASET API WHEN AVAILABLE TO AGLOMERATE ALL PARTS INTO ONE CALL
-        use_part_count = (int) ceil(json_object_path_get_double(main_obj, "clargs/avg_num_parts"));
+        raw_bytes = 0;
         for (p = 0; p < use_part_count; p++)
         {
             json_object *part_obj = json_object_array_get_idx(part_array, p);
@@ -627,16 +658,18 @@ main_dump_sif(
 
                 /* set selection of filespace */
                 fspace_id = H5Dget_space(ds_id);
-                main_dump_sif_tid = MT_StartTimer("H5Sselect_hyperslab", main_dump_sif_grp, dumpn);
+                main_dump_sif_tid = MT_StartTimerCached("H5Sselect_hyperslab", main_dump_sif_grp, dumpn);
                 H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, starts, 0, counts, 0);
                 timer_dt = MT_StopTimer(main_dump_sif_tid);
 
                 /* set dataspace of data in memory */
                 mspace_id = H5Screate_simple(ndims, counts, 0);
                 buf = json_object_extarr_data(extarr_obj);
+                raw_bytes += (unsigned long long) H5Sget_simple_extent_npoints(mspace_id) *
+                    H5Tget_size(dtype_id);
             }
 
-            main_dump_sif_tid = MT_StartTimer("H5Dwrite", main_dump_sif_grp, dumpn);
+            main_dump_sif_tid = MT_StartTimerCached("H5Dwrite", main_dump_sif_grp, dumpn);
             H5Dwrite(ds_id, dtype_id, mspace_id, fspace_id, dxpl_id, buf);
             timer_dt = MT_StopTimer(main_dump_sif_tid);
             H5Sclose(fspace_id);
@@ -644,6 +677,18 @@ main_dump_sif(
 
         }
 
+        /* The dataset is shared so each rank accounts for its share of what
+           was stored, which is less than what was written if compressed */
+        if (raw_bytes)
+        {
+            hid_t ds_space_id = H5Dget_space(ds_id);
+            double ds_bytes = (double) H5Sget_simple_extent_npoints(ds_space_id) * H5Tget_size(dtype_id);
+            double stored_share = (double) H5Dget_storage_size(ds_id) * raw_bytes / ds_bytes;
+            MACSIO_UTILS_AccountBytes(dumpn, MACSIO_UTILS_BURST_PHASE, fileName, varName,
+                raw_bytes, 0, (unsigned long long) (stored_share + 0.5));
+            H5Sclose(ds_space_id);
+        }
+
         H5Dclose(ds_id);
         free(centering);
     }
@@ -753,6 +798,8 @@ CloseHDF5File(
 static void
 write_mesh_part(
     hid_t h5loc, /**< HDF5 group id into which to write */
+    char const *fileName, /**< name of the file being written */
+    int dumpn, /**< dump number (like a cycle number) */
     json_object *part_obj /**< JSON object for the mesh part to write */
 )
 {
@@ -780,6 +827,8 @@ write_mesh_part(
         dcpl_id = make_dcpl(compression_alg_str, compression_params_str, fspace_id, dtype_id);
         ds_id = H5Dcreate1(h5loc, varname, dtype_id, fspace_id, dcpl_id); 
         H5Dwrite(ds_id, dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf);
+        MACSIO_UTILS_AccountBytes(dumpn, MACSIO_UTILS_BURST_PHASE, fileName, varname,
+            MACSIO_UTILS_ExtarrNbytes(data_obj), 0, (unsigned long long) H5Dget_storage_size(ds_id));
         H5Dclose(ds_id);
         H5Pclose(dcpl_id);
         H5Sclose(fspace_id);
@@ -847,8 +896,8 @@ main_dump_mif(
  
         domain_group_id = H5Gcreate1(h5File, domain_dir, 0);
 
-        main_dump_mif_tid = MT_StartTimer("write_mesh_part", main_dump_mif_grp, dumpn);
-        write_mesh_part(domain_group_id, this_part);
+        main_dump_mif_tid = MT_StartTimerCached("write_mesh_part", main_dump_mif_grp, dumpn);
+        write_mesh_part(domain_group_id, fileName, dumpn, this_part);
         timer_dt = MT_StopTimer(main_dump_mif_tid);
 
         H5Gclose(domain_group_id);
@@ -903,7 +952,11 @@ main_dump(
 #endif
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
 
     rank = json_object_path_get_int(main_obj, "parallel/mpi_rank");
     size = json_object_path_get_int(main_obj, "parallel/mpi_size");
@@ -935,28 +988,12 @@ main_dump(
         char const * modestr = json_object_path_get_string(main_obj, "clargs/parallel_file_mode");
         if (!strcmp(modestr, "SIF"))
         {
-            float avg_num_parts = json_object_path_get_double(main_obj, "clargs/avg_num_parts");
-            if (avg_num_parts == (float ((int) avg_num_parts)))
-            {
-                main_dump_tid = MT_StartTimer("main_dump_sif", main_dump_grp, dumpn);
-                main_dump_sif(main_obj, dumpn, dumpt);
-                timer_dt = MT_StopTimer(main_dump_tid);
-            }
-            else
-            {
-//#warning CURRENTLY, SIF CAN WORK ONLY ON WHOLE PART COUNTS
-                MACSIO_LOG_MSG(Die, ("HDF5 plugin cannot currently handle SIF mode where "
-                    "there are different numbers of parts on each MPI rank. "
-                    "Set --avg_num_parts to an integral value." ));
-            }
+            main_dump_tid = MT_StartTimer("main_dump_sif", main_dump_grp, dumpn);
+            main_dump_sif(main_obj, dumpn, dumpt);
+            timer_dt = MT_StopTimer(main_dump_tid);
         }
         else if (!strcmp(modestr, "MIFMAX"))
             numFiles = json_object_path_get_int(main_obj, "parallel/mpi_size");
-        else if (!strcmp(modestr, "MIFAUTO"))
-        {
-            /* Call utility to determine optimal file count */
-//#warning ADD UTILIT TO DETERMINE OPTIMAL FILE COUNT
-        }
         main_dump_tid = MT_StartTimer("main_dump_mif", main_dump_grp, dumpn);
         main_dump_mif(main_obj, numFiles, dumpn, dumpt);
         timer_dt = MT_StopTimer(main_dump_tid);
@@ -969,6 +1006,8 @@ register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long", iface_name));
 
@@ -28,6 +28,7 @@ end-of-copyright-header */
 #include <json-cwx/json.h>
 
 #include <macsio_clargs.h>
+#include <macsio_data.h>
 #include <macsio_iface.h>
 #include <macsio_log.h>
 #include <macsio_main.h>
@@ -35,6 +36,7 @@ end-of-copyright-header */
 #include <macsio_utils.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #ifdef HAVE_MPI
 #include <mpi.h>
@@ -58,7 +60,11 @@ static int my_opt_one;                     /**< Example of a static scope, plugi
                                                 process_args to control plugin behavior */
 static int my_opt_two;                     /**< Another example variable to control plugin behavior */
 static char *my_opt_three_string;          /**< Another example variable to control plugin behavior */
+static int lazy_chunk_size = 1<<20;        /**< Bytes of lazy variable data generated at a time */
 static float my_opt_three_float;           /**< Another example variable to control plugin behavior */
+static int aggregate = 0;                  /**< Aggregate each group's data at its first task */
+static int pipeline = 0;                   /**< Open early and prepare parts before waiting for the baton */
+static int args_processed = 0;             /**< Set once process_args has been called */
 
 /*!
 \brief Process command-line arguments specific to this plugin
@@ -85,6 +91,17 @@ static int process_args(
         "--json_as_html", "",
             "Write files as HTML instead of raw ascii [false]",
             &json_as_html,
+        "--aggregate", "",
+            "Rather than passing the baton so each processor in a group appends its\n"
+            "parts to the group's file in turn, have each processor write its parts\n"
+            "to memory and send them to the group's first processor which writes\n"
+            "the whole file.",
+            &aggregate,
+        "--pipeline", "",
+            "Write parts to memory before waiting for the baton, and open the\n"
+            "group's file while waiting, so that a processor only appends its\n"
+            "parts while it holds the baton. Ignored with --aggregate.",
+            &pipeline,
         "--my_opt_one", "",
             "Help message for my_opt_one which has no arguments. If present, local\n"
             "var my_opt_one will be assigned a value of 1 and a value of zero otherwise.",
@@ -148,6 +165,75 @@ static int CloseMyFile(
     return fclose((FILE*) file);
 }
 
+/*!
+\brief WriteFile MIF Callback
+
+This implements the MACSIO_MIF_WriteCB callback used when aggregating a group's data.
+*/
+static int WriteMyFile(
+    void *file,      /**< [in] A void pointer to the plugin specific file handle */
+    void const *buf, /**< [in] The bytes to append to the file */
+    size_t len,      /**< [in] The number of bytes */
+    void *userData   /**< [in] Optional plugin specific user-defined data */
+)
+{
+    return fwrite(buf, 1, len, (FILE*) file) != len;
+}
+
+/*! \brief Bytes written by a printf-like call, which returns a negative value on error */
+static unsigned long long printed_bytes(
+    int n  /**< [in] Return value of fprintf */
+)
+{
+    return n < 0 ? 0 : (unsigned long long) n;
+}
+
+/*!
+\brief Generate and write a lazy variable's data a chunk at a time
+
+The data is written as a JSON object of the form {"LazyVar": name, "data": [...]}
+following the part it belongs to. At most \c lazy_chunk_size bytes of values
+are held in memory at any one time.
+
+\return The number of bytes written to the file
+*/
+static unsigned long long write_lazy_var(
+    FILE *myFile,         /**< [in] The file handle being used in a MIF dump */
+    json_object *var_obj  /**< [in] The lazy variable to write */
+)
+{
+    int is_int = !strcmp(MACSIO_DATA_LazyVarDType(var_obj), "int");
+    size_t vsize = is_int ? sizeof(int) : sizeof(double);
+    long long nvals = MACSIO_DATA_LazyVarNumVals(var_obj);
+    long long chunk = lazy_chunk_size / (long long) vsize;
+    long long offset, i;
+    unsigned long long stored = 0;
+    void *buf;
+
+    if (chunk < 1) chunk = 1;
+    if (chunk > nvals) chunk = nvals ? nvals : 1;
+    buf = malloc((size_t) chunk * vsize);
+
+    stored += printed_bytes(fprintf(myFile, "{\"LazyVar\": \"%s\", \"data\": [",
+        json_object_path_get_string(var_obj, "name")));
+    for (offset = 0; offset < nvals; offset += chunk)
+    {
+        long long n = nvals - offset < chunk ? nvals - offset : chunk;
+        MACSIO_DATA_GetLazyVarChunk(var_obj, offset, n, buf);
+        for (i = 0; i < n; i++)
+        {
+            if (is_int)
+                stored += printed_bytes(fprintf(myFile, "%s%d", offset + i ? ", " : "", ((int *) buf)[i]));
+            else
+                stored += printed_bytes(fprintf(myFile, "%s%.17g", offset + i ? ", " : "", ((double *) buf)[i]));
+        }
+    }
+    stored += printed_bytes(fprintf(myFile, "]}\n"));
+
+    free(buf);
+    return stored;
+}
+
 /*!
 \brief Write a single mesh part to a MIF file
 
@@ -158,22 +244,49 @@ end of the current file.
 After serializing the object to an ASCII string and writing it to the
 file, the memory for the ASCII string is released by json_object_free_printbuf().
 
+The part's bytes are accounted for with MACSIO_UTILS_AccountBytes(). As the
+data is written as text, the bytes stored differ from the raw bytes of its arrays.
+
 \return A tiny JSON object holding the name of the file, the offset at
 which the JSON object for this part was written in the file and the part's ID.
+The offset is relative to the start of \c myFile so parts written to memory
+first need it moved with add_to_offsets().
 */
 static json_object *write_mesh_part(
     FILE *myFile,          /**< [in] The file handle being used in a MIF dump */
     char const *fileName,  /**< [in] Name of the MIF file */
+    int dumpn,             /**< [in] The number of the dump being written */
     json_object *part_obj  /**< [in] The json object representing this mesh part */
 )
 {
     json_object *part_info = json_object_new_object();
+    unsigned long long raw = MACSIO_UTILS_ObjectExtarrNbytes(part_obj);
+    unsigned long long stored = 0;
+    char dsetName[32];
+    off_t offset;
+
+    fseeko(myFile, 0, SEEK_END);
+    offset = ftello(myFile);
 
 //#warning SOMEHOW SHOULD INCLUDE OFFSETS TO EACH VARIABLE
     /* Write the json mesh part object as an ascii string */
-    fprintf(myFile, "%s\n", json_object_to_json_string_ext(part_obj, JSON_C_TO_STRING_PRETTY));
+    stored += printed_bytes(fprintf(myFile, "%s\n", json_object_to_json_string_ext(part_obj, JSON_C_TO_STRING_PRETTY)));
     json_object_free_printbuf(part_obj);
 
+    /* Lazy variables' data does not live in the part object. Stream it. */
+    json_object *vars = json_object_path_get_array(part_obj, "Vars");
+    for (int i = 0; vars && i < json_object_array_length(vars); i++)
+    {
+        json_object *var_obj = json_object_array_get_idx(vars, i);
+        if (!MACSIO_DATA_VarIsLazy(var_obj)) continue;
+        stored += write_lazy_var(myFile, var_obj);
+        raw += (unsigned long long) MACSIO_DATA_LazyVarNumVals(var_obj) *
+            (strcmp(MACSIO_DATA_LazyVarDType(var_obj), "int") ? sizeof(double) : sizeof(int));
+    }
+
+    snprintf(dsetName, sizeof(dsetName), "part %d", (int) JsonGetInt(part_obj, "Mesh/ChunkID"));
+    MACSIO_UTILS_AccountBytes(dumpn, MACSIO_UTILS_BURST_PHASE, fileName, dsetName, raw, 0, stored);
+
     /* Form the return 'value' holding the information on where to find this part */
     json_object_object_add(part_info, "partid",
 //#warning CHANGE NAME OF KEY IN JSON TO PartID
@@ -181,11 +294,33 @@ static json_object *write_mesh_part(
     json_object_object_add(part_info, "file",
         json_object_new_string(fileName));
     json_object_object_add(part_info, "offset",
-        json_object_new_double((double) ftello(myFile)));
+        json_object_new_double((double) offset));
 
     return part_info;
 }
 
+/*!
+\brief Move the offsets recorded by write_mesh_part()
+
+Parts written to a memory buffer record offsets relative to the buffer. Once
+it is known where in the file the buffer goes, this adds that to each offset.
+*/
+static void add_to_offsets(
+    json_object *part_infos,  /**< [in] Array of objects returned by write_mesh_part() */
+    unsigned long long base   /**< [in] Offset in the file at which the buffer is written */
+)
+{
+    int i;
+
+    for (i = 0; i < json_object_array_length(part_infos); i++)
+    {
+        json_object *part_info = json_object_array_get_idx(part_infos, i);
+        double offset = json_object_path_get_double(part_info, "offset");
+        json_object_object_add(part_info, "offset",
+            json_object_new_double(offset + (double) base));
+    }
+}
+
 /*!
 \brief Main MIF dump implementation for this plugin
 
@@ -208,16 +343,25 @@ static void main_dump(
     double dumpt            /**< [in] The time to be associated with this dump (like a simulation's time) */
 )
 {
-    int i, rank, numFiles;
+    int i, rank, numFiles = 1;
+    unsigned long long nbytes;
     char fileName[256];
     FILE *myFile;
     MACSIO_MIF_ioFlags_t ioFlags = {MACSIO_MIF_WRITE,(unsigned int) JsonGetInt(main_obj,"clargs/exercise_scr")&0x1};
+    MACSIO_MIF_ioFlags_t rootFlags;
     MACSIO_MIF_baton_t *bat;
     json_object *parts;
     json_object *part_infos = json_object_new_array();
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
+    if (JsonGetInt(main_obj, "clargs/lazy_vars"))
+        lazy_chunk_size = JsonGetInt(main_obj, "clargs/lazy_chunk_size");
+    ioFlags.pipeline = (unsigned int) (pipeline && !aggregate);
 
     /* ensure we're in MIF mode and determine the file count */
 //#warning SIMPLIFY THIS LOGIC USING NEW JSON INTERFACE
@@ -244,10 +388,6 @@ static void main_dump(
         }
         else if (!strcmp(modestr, "MIFMAX"))
             numFiles = json_object_path_get_int(main_obj, "parallel/mpi_size");
-        else if (!strcmp(modestr, "MIFAUTO"))
-        {
-            /* Call MACSio utility to determine optimal file count */
-        }
     }
 
     bat = MACSIO_MIF_Init(numFiles, ioFlags, MACSIO_MAIN_Comm, 3,
@@ -264,19 +404,55 @@ static void main_dump(
 
     MACSIO_UTILS_RecordOutputFiles(dumpn, fileName);
 
-    myFile = (FILE *) MACSIO_MIF_WaitForBaton(bat, fileName, 0);
-
-    parts = json_object_path_get_array(main_obj, "problem/parts");
-    for (i = 0; i < json_object_array_length(parts); i++)
+    if (aggregate || pipeline)
     {
-        json_object *this_part = json_object_array_get_idx(parts, i);
-        json_object_array_add(part_infos, write_mesh_part(myFile, fileName, this_part));
+        /* Write parts to memory and then hand them to the group's first processor
+           or append them to the group's file once this processor has the baton */
+        char *membuf = 0;
+        size_t memlen = 0;
+
+        myFile = open_memstream(&membuf, &memlen);
+
+        parts = json_object_path_get_array(main_obj, "problem/parts");
+        for (i = 0; i < json_object_array_length(parts); i++)
+        {
+            json_object *this_part = json_object_array_get_idx(parts, i);
+            json_object_array_add(part_infos, write_mesh_part(myFile, fileName, dumpn, this_part));
+        }
+        fclose(myFile);
+
+        if (aggregate)
+        {
+            MACSIO_MIF_AggregateWrite(bat, fileName, 0, membuf, memlen, WriteMyFile);
+            add_to_offsets(part_infos, MACSIO_MIF_BatonOffset(bat));
+        }
+        else
+        {
+            myFile = (FILE *) MACSIO_MIF_WaitForBaton(bat, fileName, 0);
+            add_to_offsets(part_infos, MACSIO_MIF_BatonOffset(bat));
+            if (myFile)
+                WriteMyFile(myFile, membuf, memlen, 0);
+            MACSIO_MIF_SetBatonOffset(bat, MACSIO_MIF_BatonOffset(bat) + memlen);
+            MACSIO_MIF_HandOffBaton(bat, myFile);
+        }
+        free(membuf);
     }
+    else
+    {
+        myFile = (FILE *) MACSIO_MIF_WaitForBaton(bat, fileName, 0);
 
-    /* Hand off the baton to the next processor. This winds up closing
-     * the file so that the next processor that opens it can be assured
-     * of getting a consistent and up to date view of the file's contents. */
-    MACSIO_MIF_HandOffBaton(bat, myFile);
+        parts = json_object_path_get_array(main_obj, "problem/parts");
+        for (i = 0; i < json_object_array_length(parts); i++)
+        {
+            json_object *this_part = json_object_array_get_idx(parts, i);
+            json_object_array_add(part_infos, write_mesh_part(myFile, fileName, dumpn, this_part));
+        }
+
+        /* Hand off the baton to the next processor. This winds up closing
+         * the file so that the next processor that opens it can be assured
+         * of getting a consistent and up to date view of the file's contents. */
+        MACSIO_MIF_HandOffBaton(bat, myFile);
+    }
 
     /* We're done using MACSIO_MIF for these files, so finish it off */
     MACSIO_MIF_Finish(bat);
@@ -285,7 +461,11 @@ static void main_dump(
        file contents. This winds up being serial I/O but also means we
        never collect all info on all parts to any single processor. */
 //#warning THERE IS A BETTER WAY TO DO USING LOOP OF NON-BLOCKING RECIEVES
-    bat = MACSIO_MIF_Init(1, ioFlags, MACSIO_MAIN_Comm, 5,
+    /* Every task is in the one group, so opening early would have them all open
+       the file while the first truncates it */
+    rootFlags = ioFlags;
+    rootFlags.pipeline = 0;
+    bat = MACSIO_MIF_Init(1, rootFlags, MACSIO_MAIN_Comm, 5,
         CreateMyFile, OpenMyFile, CloseMyFile, 0);
 
     /* Construct name for the silo file */
@@ -302,7 +482,8 @@ static void main_dump(
 
 //#warning FIX THE STRING THAT WE PRODUCE HERE SO ITS A SINGLE JSON ARRAY OBJECT
     /* This processor's work on the file is just to write its part_infos */
-    fprintf(myFile, "%s\n", json_object_to_json_string_ext(part_infos, JSON_C_TO_STRING_PRETTY));
+    nbytes = printed_bytes(fprintf(myFile, "%s\n", json_object_to_json_string_ext(part_infos, JSON_C_TO_STRING_PRETTY)));
+    MACSIO_UTILS_AccountBytes(dumpn, MACSIO_UTILS_BURST_PHASE, fileName, "part infos", 0, nbytes, nbytes);
 
     MACSIO_MIF_HandOffBaton(bat, myFile);
 
@@ -312,6 +493,45 @@ static void main_dump(
     json_object_put(part_infos);
 }
 
+/*!
+\brief Trickle dump implementation for this plugin
+
+Each processor appends the small trickle object to its own time-history
+file. Each trickle dump opens, appends to and closes the file much as an
+application's time-history or diagnostic output would.
+*/
+static void main_trickle_dump(
+    int argi,                 /**< [in] Command-line argument index at which first plugin-specific arg appears */
+    int argc,                 /**< [in] argc from main */
+    char **argv,              /**< [in] argv from main */
+    json_object *main_obj,    /**< [in] The main json object */
+    json_object *trickle_obj, /**< [in] The small json object to append */
+    int dumpn,                /**< [in] The number of the most recent burst dump */
+    int tricklen,             /**< [in] The number/index of this trickle dump */
+    double dumpt              /**< [in] The time to be associated with this trickle dump */
+)
+{
+    char fileName[256];
+    FILE *myFile;
+    unsigned long long nbytes;
+
+    sprintf(fileName, "%s_json_trickle_%05d.%s",
+        json_object_path_get_string(main_obj, "clargs/filebase"),
+        (int) JsonGetInt(main_obj, "parallel/mpi_rank"),
+        json_object_path_get_string(main_obj, "clargs/fileext"));
+
+    if (!(myFile = fopen(fileName, tricklen ? "a" : "w")))
+    {
+        MACSIO_LOG_MSG(Warn, ("Unable to open trickle file \"%s\"", fileName));
+        return;
+    }
+    nbytes = printed_bytes(fprintf(myFile, "%s\n", json_object_to_json_string_ext(trickle_obj, JSON_C_TO_STRING_PRETTY)));
+    json_object_free_printbuf(trickle_obj);
+    MACSIO_UTILS_AccountBytes(dumpn, MACSIO_UTILS_TRICKLE_PHASE, fileName, "trickle",
+        MACSIO_UTILS_ObjectExtarrNbytes(trickle_obj), 0, nbytes);
+    fclose(myFile);
+}
+
 /*!
 \brief Method to register this plugin with MACSio main
 
@@ -325,6 +545,8 @@ static int register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long", iface_name));
 
@@ -332,6 +554,8 @@ static int register_this_interface()
     strcpy(iface.name, iface_name);
     strcpy(iface.ext, iface_ext);
     iface.dumpFunc = main_dump;
+    iface.trickleDumpFunc = main_trickle_dump;
+    iface.lazyVarsOK = 1;
     iface.processArgsFunc = process_args;
 
     /* Register this plugin */
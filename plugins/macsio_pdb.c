@@ -65,6 +65,8 @@ Place, Suite 330, Boston, MA 02111-1307 USA
 static char const *iface_name = "pdb";
 static char const *iface_ext = "pdb";
 
+static int args_processed = 0;
+
 static int process_args(int argi, int argc, char *argv[])
 {
     const MACSIO_CLARGS_ArgvFlags_t argFlags = {MACSIO_CLARGS_WARN, MACSIO_CLARGS_TOMEM};
@@ -190,7 +192,11 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj,
 #endif
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
 
     rank = json_object_path_get_int(main_obj, "parallel/mpi_rank");
     size = json_object_path_get_int(main_obj, "parallel/mpi_size");
@@ -218,11 +224,6 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj,
         char const * modestr = json_object_path_get_string(main_obj, "clargs/parallel_file_mode");
         if (!strcmp(modestr, "MIFMAX"))
             numFiles = json_object_path_get_int(main_obj, "parallel/mpi_size");
-        else if (!strcmp(modestr, "MIFAUTO"))
-        {
-            /* Call utility to determine optimal file count */
-//#warning ADD UTILIT TO DETERMINE OPTIMAL FILE COUNT
-        }
         main_dump_mif(main_obj, numFiles, dumpn, dumpt);
     }
 }
@@ -231,6 +232,8 @@ static int register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long", iface_name));
 
@@ -267,6 +267,7 @@ static const char *filename;
 static int has_mesh = 0;
 static int driver = DB_HDF5;
 static int show_all_errors = FALSE;
+static int args_processed = 0;
 //#warning MOVE LOG HANDLE TO IO CONTEXT
 
 static int process_args(int argi, int argc, char *argv[])
@@ -716,7 +717,11 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj, in
 #endif
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
 
     rank = JsonGetInt(main_obj, "parallel/mpi_rank");
     size = JsonGetInt(main_obj, "parallel/mpi_size");
@@ -750,11 +755,6 @@ static void main_dump(int argi, int argc, char **argv, json_object *main_obj, in
         }
         else if (!strcmp(modestr, "MIFMAX"))
             numGroups = JsonGetInt(main_obj, "parallel/mpi_size");
-        else if (!strcmp(modestr, "MIFAUTO"))
-        {
-            /* Call utility to determine optimal file count */
-//#warning ADD UTILIT TO DETERMINE OPTIMAL FILE COUNT
-        }
     }
 
     /* Initialize MACSIO_MIF, pass a pointer to the driver type as the user data. */
@@ -1031,6 +1031,8 @@ static int register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long",iface_name));
 
@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include <macsio_clargs.h>
+#include <macsio_data.h>
 #include <macsio_iface.h>
 #include <macsio_log.h>
 #include <macsio_main.h>
@@ -48,6 +49,8 @@ TIO_t errnum;
 #define TIO_Call(r,s) if((errnum=r) != TIO_SUCCESS) {TIO_Get_Error(errnum, errstr); printf("%s\n%s\n",s,errstr); exit(EXIT_FAILURE);}
 
 
+static int args_processed = 0;
+
 /*!
 \brief Process command-line arguments specific to this plugin
 
@@ -108,6 +111,29 @@ static char *getDate()
     return ret;
 }
 
+/*!
+\brief Check the decomposition can be written in SIF or MSF mode
+
+The whole mesh is written as one chunk per rank per part so every rank must own
+the same number of parts, all of their nominal size.
+*/
+static void check_sif_parts(
+    json_object *main_obj)  /**< [in] The main JSON object containing mesh data */
+{
+    int min_parts, max_parts;
+
+    MACSIO_DATA_GetPartCountRange(main_obj, &min_parts, &max_parts);
+    if (min_parts != max_parts)
+        MACSIO_LOG_MSG(Die, ("TyphonIO plugin cannot currently handle SIF mode where "
+                             "there are different numbers of parts on each MPI rank. "
+                             "Set --avg_num_parts to an integral value and do not use "
+                             "a --part_map giving ranks different numbers of parts." ));
+    if (!MACSIO_DATA_PartSizesAreUniform(main_obj))
+        MACSIO_LOG_MSG(Die, ("TyphonIO plugin cannot currently handle SIF mode where "
+                             "parts differ in size. Remove the size multipliers of "
+                             "--part_map and --part_distribution." ));
+}
+
 /*!
 \brief CreateFile MIF Callback
 
@@ -652,7 +678,7 @@ static void write_quad_mesh_whole(
         }
 
         /* Loop to make write calls for this var for each part on this rank */
-        use_part_count = (int) ceil(json_object_path_get_double(main_obj, "clargs/avg_num_parts"));
+        MACSIO_DATA_GetPartCountRange(main_obj, 0, &use_part_count);
         for (p = 0; p < use_part_count; p++)
         {
             json_object *part_obj = json_object_array_get_idx(part_array, p);
@@ -873,7 +899,7 @@ static void write_ucd_mesh_whole(
             free(centering);
         }
 
-        use_part_count = (int) ceil(json_object_path_get_double(main_obj, "clargs/avg_num_parts"));
+        MACSIO_DATA_GetPartCountRange(main_obj, 0, &use_part_count);
         for (p = 0; p < use_part_count; p++)
         {
             json_object *part_obj = json_object_array_get_idx(part_array, p);
@@ -1241,7 +1267,7 @@ static void write_quad_mesh_whole(
         }
 
         /* Loop to make write calls for this var for each part on this rank */
-        use_part_count = (int) ceil(json_object_path_get_double(main_obj, "clargs/avg_num_parts"));
+        MACSIO_DATA_GetPartCountRange(main_obj, 0, &use_part_count);
         for (p = 0; p < use_part_count; p++)
         {
             json_object *part_obj = json_object_array_get_idx(part_array, p);
@@ -1473,7 +1499,7 @@ static void write_ucd_mesh_whole(
             free(centering);
         }
 
-        use_part_count = (int) ceil(json_object_path_get_double(main_obj, "clargs/avg_num_parts"));
+        MACSIO_DATA_GetPartCountRange(main_obj, 0, &use_part_count);
         for (p = 0; p < use_part_count; p++)
         {
             json_object *part_obj = json_object_array_get_idx(part_array, p);
@@ -1765,7 +1791,11 @@ static void main_dump(
     //mpi_errno = MPI_Barrier(MACSIO_MAIN_Comm);
 
     /* process cl args */
-    process_args(argi, argc, argv);
+    if (!args_processed)
+    {
+        process_args(argi, argc, argv);
+        args_processed = 1;
+    }
 
     rank = json_object_path_get_int(main_obj, "parallel/mpi_rank");
     size = json_object_path_get_int(main_obj, "parallel/mpi_size");
@@ -1777,18 +1807,11 @@ static void main_dump(
         json_object *filecnt = json_object_array_get_idx(parfmode_obj, 1);
 
         if (!strcmp(json_object_get_string(modestr), "SIF")) {
-            float avg_num_parts = json_object_path_get_double(main_obj, "clargs/avg_num_parts");
-            if (avg_num_parts == (float ((int) avg_num_parts))){
-                if (json_object_get_int(filecnt) > 1){
-                    main_dump_msf(main_obj, json_object_get_int(filecnt), dumpn, dumpt);
-                } else {
-                    main_dump_sif(main_obj, dumpn, dumpt);
-                }
+            check_sif_parts(main_obj);
+            if (json_object_get_int(filecnt) > 1){
+                main_dump_msf(main_obj, json_object_get_int(filecnt), dumpn, dumpt);
             } else {
-                // CURRENTLY, SIF CAN WORK ONLY ON WHOLE PART COUNTS
-                MACSIO_LOG_MSG(Die, ("TyphonIO plugin cannot currently handle SIF mode where "
-                                     "there are different numbers of parts on each MPI rank. "
-                                     "Set --avg_num_parts to an integral value." ));
+                main_dump_sif(main_obj, dumpn, dumpt);
             }
         }
         else {
@@ -1798,22 +1821,11 @@ static void main_dump(
     } else {
         char const * modestr = json_object_path_get_string(main_obj, "clargs/parallel_file_mode");
         if (!strcmp(modestr, "SIF")) {
-            float avg_num_parts = json_object_path_get_double(main_obj, "clargs/avg_num_parts");
-            if (avg_num_parts == (float ((int) avg_num_parts)))
-                main_dump_sif(main_obj, dumpn, dumpt);
-            else {
-                // CURRENTLY, SIF CAN WORK ONLY ON WHOLE PART COUNTS
-                MACSIO_LOG_MSG(Die, ("TyphonIO plugin cannot currently handle SIF mode where "
-                                     "there are different numbers of parts on each MPI rank. "
-                                     "Set --avg_num_parts to an integral value." ));
-            }
+            check_sif_parts(main_obj);
+            main_dump_sif(main_obj, dumpn, dumpt);
         }
         else if (!strcmp(modestr, "MIFMAX"))
             numFiles = json_object_path_get_int(main_obj, "parallel/mpi_size");
-        else if (!strcmp(modestr, "MIFAUTO")) {
-            /* Call utility to determine optimal file count */
-            // ADD UTILIT TO DETERMINE OPTIMAL FILE COUNT
-        }
         main_dump_mif(main_obj, numFiles, dumpn, dumpt);
     }
 }
@@ -1831,6 +1843,8 @@ static int register_this_interface()
 {
     MACSIO_IFACE_Handle_t iface;
 
+    memset(&iface, 0, sizeof(iface));
+
     if (strlen(iface_name) >= MACSIO_IFACE_MAX_NAME)
         MACSIO_LOG_MSG(Die, ("Interface name \"%s\" too long", iface_name));
 